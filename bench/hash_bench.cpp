@@ -0,0 +1,265 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * Description:
+ *
+ * Microbenchmark of ShareHashMap<uint32_t, uint32_t>. It only uses the
+ * EAL calls, so it builds against dpdk or the POSIX backend:
+ *
+ *   $ make -f Makefile.posix
+ *   $ ./build-posix/hash_bench -c f -- [-n keys] [-b bucket entries] [-l lookups]
+ *                                       [-k rw|pf|wp|lf] [-F]
+ *
+ * The single lcore phases report the TSC cycles per operation, then every
+ * enabled lcore looks up random keys at the same time. -k selects the
+ * bucket lock: rte_rwlock, phase-fair or writer-preferring, or lock-free
+ * inserts and erases. -F adds the negative lookup filter.
+ *
+ * The "hot" phases look up the first k_HOT_KEYS keys only, through the
+ * map and then through a ShareHotKeyCache.
+ *
+ * The "flows" and "bulk" phases update each key k_PACKETS_PER_FLOW times
+ * in a row, one at a time and then in bursts of k_BURST with
+ * update_value_bulk.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <vector>
+
+#include <rte_eal.h>
+#include <rte_debug.h>
+#include <rte_errno.h>
+#include <rte_cycles.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+
+#include "share_hashmap.h"
+#include "modifier.h"
+#include "share_hot_cache.h"
+
+typedef ShareHashMap<uint32_t, uint32_t> bench_map;
+
+static const uint32_t k_HOT_KEYS = 128;
+static const uint32_t k_BURST = 32;
+static const uint32_t k_PACKETS_PER_FLOW = 4;
+
+struct lookup_job {
+    bench_map            *map;
+    const uint32_t       *keys;
+    uint32_t              num_keys;
+    uint32_t              lookups;
+    uint32_t              found;
+    uint64_t              cycles;
+} __rte_cache_aligned;
+
+static lookup_job jobs[RTE_MAX_LCORE];
+
+/* A bijection of uint32_t, so the keys are distinct and spread out */
+static inline uint32_t
+bench_key(uint32_t i)
+{
+    return i * 2654435761U + 0x5bd1e995U;
+}
+
+static void
+report(const char *phase, uint32_t ops, uint32_t ok, uint64_t cycles)
+{
+    double per_op = ops ? (double)cycles / ops : 0;
+
+    printf("  %-14s %10u ops %10u ok %8.1f cycles/op %8.2f Mops/s\n", phase, ops, ok,
+           per_op, per_op ? (double)rte_get_tsc_hz() / per_op / 1e6 : 0);
+}
+
+static int
+lookup_loop(void *arg)
+{
+    lookup_job *job = &jobs[rte_lcore_id()];
+    uint32_t seed = rte_lcore_id() * 7919 + 1;
+    uint32_t found = 0;
+    uint64_t start;
+
+    (void)arg;
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < job->lookups; ++i) {
+        seed = seed * 1103515245 + 12345;
+        if (job->map->find(job->keys[(seed >> 8) % job->num_keys]) >= 0)
+            ++found;
+    }
+    job->cycles = rte_rdtsc() - start;
+    job->found = found;
+    return 0;
+}
+
+static void
+usage(const char *prog)
+{
+    printf("usage: %s [EAL options] -- [-n keys] [-b bucket entries] [-l lookups per lcore]"
+           " [-k rw|pf|wp|lf] [-F]\n", prog);
+}
+
+int
+main(int argc, char **argv)
+{
+    uint32_t num_keys = 1 << 20, bucket_entries = 64, lookups = 1 << 22;
+    uint32_t ok, lcore, flags = 0;
+    uint64_t start;
+    int ret, opt;
+
+    ret = rte_eal_init(argc, argv);
+    if (ret < 0)
+        rte_panic("Cannot init EAL\n");
+    argc -= ret;
+    argv += ret;
+
+    while ((opt = getopt(argc, argv, "n:b:l:k:F")) != -1) {
+        switch (opt) {
+            case 'n': num_keys = atoi(optarg); break;
+            case 'b': bucket_entries = atoi(optarg); break;
+            case 'l': lookups = atoi(optarg); break;
+            case 'k':
+                if (strcmp(optarg, "pf") == 0)
+                    flags |= ShareRteHash::k_FLAG_LOCK_PHASE_FAIR;
+                else if (strcmp(optarg, "wp") == 0)
+                    flags |= ShareRteHash::k_FLAG_LOCK_WRITER_PREF;
+                else if (strcmp(optarg, "lf") == 0)
+                    flags |= ShareRteHash::k_FLAG_LOCK_FREE;
+                break;
+            case 'F': flags |= ShareRteHash::k_FLAG_FILTER; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (num_keys == 0 || !rte_is_power_of_2(bucket_entries)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    /* Keep the load at most 50% so that no bucket overflows */
+    uint32_t entries = rte_align32pow2(num_keys * 2);
+    if (entries < bucket_entries)
+        entries = bucket_entries;
+
+    bench_map map("bench", entries, bucket_entries, SOCKET_ID_ANY);
+    if (!map.create(flags)) {
+        printf("can't create the table: %s\n", rte_strerror(rte_errno));
+        return 1;
+    }
+
+    std::vector<uint32_t> keys(num_keys), misses(num_keys);
+    for (uint32_t i = 0; i < num_keys; ++i) {
+        keys[i] = bench_key(i);
+        misses[i] = bench_key(i + num_keys);
+    }
+
+    printf("%u keys, %u entries, %u entries per bucket, TSC at %" PRIu64 " Hz\n",
+           num_keys, entries, bucket_entries, rte_get_tsc_hz());
+
+    ok = 0;
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < num_keys; ++i)
+        ok += (map.insert(keys[i], i) >= 0);
+    report("insert", num_keys, ok, rte_rdtsc() - start);
+
+    ok = 0;
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < num_keys; ++i)
+        ok += (map.find(keys[i]) >= 0);
+    report("find hit", num_keys, ok, rte_rdtsc() - start);
+
+    ok = 0;
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < num_keys; ++i)
+        ok += (map.find(misses[i]) >= 0);
+    report("find miss", num_keys, ok, rte_rdtsc() - start);
+
+    ok = 0;
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < num_keys; ++i)
+        ok += map.update_value(keys[i], 1, add<uint32_t>());
+    report("update", num_keys, ok, rte_rdtsc() - start);
+
+    /* Bursts of k_BURST packets, k_PACKETS_PER_FLOW in a row per flow */
+    std::vector<uint32_t> flows(num_keys), ones(num_keys, 1);
+    for (uint32_t i = 0; i < num_keys; ++i)
+        flows[i] = keys[i / k_PACKETS_PER_FLOW];
+
+    ok = 0;
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < num_keys; ++i)
+        ok += map.update_value(flows[i], 1, add<uint32_t>());
+    report("update flows", num_keys, ok, rte_rdtsc() - start);
+
+    ok = 0;
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < num_keys; i += k_BURST) {
+        bool updated[k_BURST];
+        uint32_t n = num_keys - i < k_BURST ? num_keys - i : k_BURST;
+        ok += map.update_value_bulk(&flows[i], &ones[i], n, add<uint32_t>(), updated);
+    }
+    report("update bulk", num_keys, ok, rte_rdtsc() - start);
+
+    uint32_t hot = num_keys < k_HOT_KEYS ? num_keys : k_HOT_KEYS;
+    ok = 0;
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < num_keys; ++i)
+        ok += (map.find(keys[i % hot]) >= 0);
+    report("find hot", num_keys, ok, rte_rdtsc() - start);
+
+    {
+        ShareHotKeyCache<bench_map> cache(map);
+
+        ok = 0;
+        start = rte_rdtsc();
+        for (uint32_t i = 0; i < num_keys; ++i)
+            ok += (cache.find(keys[i % hot]) >= 0);
+        report("cached hot", num_keys, ok, rte_rdtsc() - start);
+    }
+
+    /* Lookups on every lcore at the same time */
+    RTE_LCORE_FOREACH(lcore) {
+        jobs[lcore].map = &map;
+        jobs[lcore].keys = &keys[0];
+        jobs[lcore].num_keys = num_keys;
+        jobs[lcore].lookups = lookups;
+    }
+    rte_eal_mp_remote_launch(lookup_loop, NULL, CALL_MASTER);
+    rte_eal_mp_wait_lcore();
+
+    uint64_t max_cycles = 0, total = 0, found = 0;
+    RTE_LCORE_FOREACH(lcore) {
+        total += jobs[lcore].lookups;
+        found += jobs[lcore].found;
+        if (jobs[lcore].cycles > max_cycles)
+            max_cycles = jobs[lcore].cycles;
+    }
+    printf("  %-14s %10" PRIu64 " ops on %u lcores, %" PRIu64 " found, %8.2f Mops/s\n",
+           "parallel find", total, rte_lcore_count(), found,
+           max_cycles ? total * (double)rte_get_tsc_hz() / max_cycles / 1e6 : 0);
+
+    ok = 0;
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < num_keys; ++i)
+        ok += (map.erase(keys[i]) >= 0);
+    report("erase", num_keys, ok, rte_rdtsc() - start);
+
+    return 0;
+}
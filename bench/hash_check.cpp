@@ -0,0 +1,1021 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * Description:
+ *
+ * Self-checking tests of ShareHashMap. Like hash_bench, it only uses the
+ * EAL calls, so it builds against dpdk or the POSIX backend:
+ *
+ *   $ make -f Makefile.posix check
+ *   $ ./build-posix/hash_check -c f
+ *
+ * Every check prints its name, then ok or the conditions which failed.
+ * The exit status is 1 if any failed. The concurrent checks run on the
+ * slave lcores too, give at least 2 lcores.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <rte_eal.h>
+#include <rte_debug.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+
+#include "share_hashmap.h"
+#include "share_changelog.h"
+#include "share_string_hashmap.h"
+#include "share_frozen_hashmap.h"
+#include "share_hot_cache.h"
+#include "share_sharded_hashmap.h"
+#include "modifier.h"
+
+typedef ShareHashMap<uint32_t, uint32_t> check_map;
+
+static uint32_t failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("    %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        ++failures; \
+    } \
+} while (0)
+
+/* A bijection of uint32_t, so the keys are distinct and spread out */
+static inline uint32_t
+check_key(uint32_t i)
+{
+    return i * 2654435761U + 0x5bd1e995U;
+}
+
+/* Every entry of the map is in the other one, with the same value */
+struct contained_in {
+    check_map & other;
+    uint32_t    missing;
+
+    contained_in(check_map & __other) : other(__other), missing(0) {}
+    void operator()(const check_map::key_value_pair_type * __kv, uint32_t) {
+        check_map::key_value_pair_type *entry;
+        int32_t position = other.find(__kv->k);
+
+        if (position < 0) {
+            ++missing;
+            return;
+        }
+        other.get_entry_with_index(entry, position);
+        if (entry->v != __kv->v)
+            ++missing;
+    }
+};
+
+static bool
+same_entries(check_map & a, check_map & b)
+{
+    contained_in in_b(b), in_a(a);
+
+    a.for_each(in_b);
+    b.for_each(in_a);
+    return in_b.missing == 0 && in_a.missing == 0 && a.used_entry_count() == b.used_entry_count();
+}
+
+/*
+ * Run f on the first slave lcore, or here if there is none. Returns the
+ * lcore to wait for, RTE_MAX_LCORE if f already ran.
+ */
+static unsigned
+launch(lcore_function_t *f, void *arg)
+{
+    unsigned lcore = rte_get_next_lcore(-1, 1, 0);
+
+    if (lcore < RTE_MAX_LCORE && rte_eal_remote_launch(f, arg, lcore) == 0)
+        return lcore;
+    f(arg);
+    return RTE_MAX_LCORE;
+}
+
+static void
+wait_for(unsigned lcore)
+{
+    if (lcore < RTE_MAX_LCORE)
+        rte_eal_wait_lcore(lcore);
+}
+
+/* Drain the change log into the standby, false if records were lost */
+static bool
+catch_up(ShareChangeLogReader<check_map> & reader, ShareStandby<check_map> & standby)
+{
+    int32_t n;
+
+    while ((n = reader.poll(standby)) > 0)
+        ;
+    return n == 0;
+}
+
+/* A standby fed by the change log ends up equal to the table */
+static void
+check_changelog_replay(void)
+{
+    check_map map("chk_cl", 1 << 12, 8), copy("chk_cl_standby", 1 << 12, 8);
+    uint32_t i;
+
+    CHECK(map.create());
+    CHECK(copy.create());
+    CHECK(map.create_changelog(1 << 10));
+
+    ShareChangeLogReader<check_map> reader(map);
+    ShareStandby<check_map> standby(copy);
+
+    /* Entries before the snapshot come from the walk, the rest from the log */
+    for (i = 0; i < 200; ++i)
+        map.insert(check_key(i), i);
+    reader.snapshot(standby);
+
+    for (i = 200; i < 400; ++i)
+        map.insert(check_key(i), i);
+    for (i = 0; i < 400; i += 2)
+        map.update_value(check_key(i), 1000, add<uint32_t>());
+    for (i = 0; i < 400; i += 3)
+        map.erase(check_key(i));
+
+    CHECK(catch_up(reader, standby));
+    CHECK(same_entries(map, copy));
+    CHECK(standby.failed() == 0);
+
+    /* More changes than the log holds: the reader must start over */
+    for (i = 0; i < 2000; ++i)
+        map.update_value(check_key(1), 1, add<uint32_t>());
+    CHECK(reader.poll(standby) == -ERANGE);
+
+    copy.clear();
+    reader.snapshot(standby);
+    CHECK(catch_up(reader, standby));
+    CHECK(same_entries(map, copy));
+}
+
+struct writer_job {
+    check_map   *map;
+    uint32_t     keys;
+    uint32_t     rounds;
+    volatile int done;
+};
+
+/* Insert, update and erase keys of job->map for job->rounds rounds */
+static int
+mutate(void *arg)
+{
+    writer_job *job = (writer_job *)arg;
+
+    for (uint32_t r = 0; r < job->rounds; ++r) {
+        for (uint32_t i = 0; i < job->keys; ++i) {
+            if ((i + r) % 3 == 0) {
+                job->map->erase(check_key(i));
+            } else {
+                job->map->insert(check_key(i), r);
+                job->map->update_value(check_key(i), 1, add<uint32_t>());
+            }
+        }
+    }
+    job->done = 1;
+    return 0;
+}
+
+/*
+ * Incremental checkpoints taken while a writer runs, then restored into
+ * a new table, give the table as it is at the end.
+ */
+static void
+check_checkpoint_restore(void)
+{
+    static const uint32_t modes[] = {
+        ShareRteHash::k_FLAG_DIRTY_TRACKING,
+        ShareRteHash::k_FLAG_DIRTY_TRACKING | ShareRteHash::k_FLAG_SINGLE_WRITER,
+        ShareRteHash::k_FLAG_DIRTY_TRACKING | ShareRteHash::k_FLAG_LOCK_FREE,
+    };
+    char path[64];
+
+    snprintf(path, sizeof(path), "/tmp/hash_check_%d.ckpt", (int)getpid());
+
+    for (uint32_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+        check_map map("chk_ckpt", 1 << 12, 8), restored("chk_ckpt_restored", 1 << 12, 8);
+        writer_job job = {&map, 1024, 200, 0};
+        uint32_t segments = 1;
+        unsigned lcore;
+
+        unlink(path);
+        CHECK(map.create(modes[m]));
+        CHECK(restored.create(modes[m]));
+
+        CHECK(map.checkpoint(path, true) >= 0);
+        lcore = launch(mutate, &job);
+        while (!job.done) {
+            CHECK(map.checkpoint(path) >= 0);
+            ++segments;
+        }
+        wait_for(lcore);
+        CHECK(map.checkpoint(path) >= 0);
+        ++segments;
+
+        CHECK(restored.restore(path) == (int)segments);
+        CHECK(same_entries(map, restored));
+    }
+    unlink(path);
+}
+
+struct cas_job {
+    check_map *map;
+    uint32_t   keys;
+    uint32_t   rounds;
+};
+
+/* Every lcore inserts and erases the same few keys, in its own order */
+static int
+insert_erase(void *arg)
+{
+    cas_job *job = (cas_job *)arg;
+    uint32_t offset = rte_lcore_id();
+
+    for (uint32_t r = 0; r < job->rounds; ++r) {
+        for (uint32_t i = 0; i < job->keys; ++i) {
+            uint32_t key = check_key((i + offset) % job->keys);
+
+            if ((i + r + offset) % 2 == 0)
+                job->map->insert(key, r);
+            else
+                job->map->erase(key);
+        }
+    }
+    return 0;
+}
+
+/* Counts the copies of each of the first n keys, and the entries walked */
+struct copies_of {
+    uint32_t copies[64];
+    uint32_t n;
+    uint32_t walked;
+
+    copies_of(uint32_t __n) : n(__n), walked(0) {
+        for (uint32_t i = 0; i < n; ++i)
+            copies[i] = 0;
+    }
+    void operator()(const check_map::key_value_pair_type * __kv, uint32_t) {
+        ++walked;
+        for (uint32_t i = 0; i < n; ++i) {
+            if (check_key(i) == __kv->k)
+                ++copies[i];
+        }
+    }
+};
+
+/*
+ * Racing inserts and erases of a lock-free table leave no key twice, an
+ * exact entry count, and a change log which replays to the same table.
+ */
+static void
+check_cas_concurrency(void)
+{
+    check_map map("chk_cas", 1 << 10, 8), copy("chk_cas_standby", 1 << 10, 8);
+    cas_job job = {&map, 64, 500};
+    unsigned lcore;
+
+    CHECK(map.create(ShareRteHash::k_FLAG_LOCK_FREE));
+    CHECK(copy.create());
+    CHECK(map.create_changelog(1 << 17));
+
+    ShareChangeLogReader<check_map> reader(map);
+    ShareStandby<check_map> standby(copy);
+    reader.snapshot(standby);
+
+    RTE_LCORE_FOREACH_SLAVE(lcore) {
+        rte_eal_remote_launch(insert_erase, &job, lcore);
+    }
+    insert_erase(&job);
+    rte_eal_mp_wait_lcore();
+
+    copies_of walk(job.keys);
+    map.for_each(walk);
+    for (uint32_t i = 0; i < job.keys; ++i)
+        CHECK(walk.copies[i] <= 1);
+    CHECK((int32_t)walk.walked == map.used_entry_count());
+
+    CHECK(catch_up(reader, standby));
+    CHECK(same_entries(map, copy));
+    CHECK(standby.failed() == 0);
+}
+
+struct sum_values {
+    void operator()(uint64_t & __sum, const check_map::key_value_pair_type & __kv) const { __sum += __kv.v; }
+};
+
+struct sum {
+    void operator()(uint64_t & __sum, const uint64_t & __other) const { __sum += __other; }
+};
+
+struct is_odd {
+    bool operator()(const check_map::key_value_pair_type & __kv) const { return __kv.v & 1; }
+};
+
+struct reduce_job {
+    check_map   *map;
+    int32_t      ret;
+    volatile int stop;
+};
+
+/* reduce off the master lcore, it must refuse */
+static int
+reduce_on_slave(void *arg)
+{
+    reduce_job *job = (reduce_job *)arg;
+    uint64_t n = 0;
+
+    job->ret = job->map->count_if(n, is_odd());
+    return 0;
+}
+
+static int
+spin(void *arg)
+{
+    reduce_job *job = (reduce_job *)arg;
+
+    while (!job->stop)
+        rte_pause();
+    return 0;
+}
+
+/*
+ * reduce and count_if give the same result whichever slave lcores are
+ * idle, and refuse to run off the master lcore.
+ */
+static void
+check_reduce(void)
+{
+    check_map map("chk_reduce", 1 << 12, 8);
+    reduce_job job = {&map, 0, 0};
+    uint64_t total = 0, odd = 0;
+    int32_t parts;
+    unsigned lcore;
+    uint32_t i;
+
+    CHECK(map.create());
+    for (i = 0; i < 1000; ++i)
+        map.insert(check_key(i), i);
+
+    parts = map.reduce(total, uint64_t(0), sum_values(), sum());
+    CHECK(parts == (int32_t)rte_lcore_count());
+    CHECK(total == 999 * 1000 / 2);
+    CHECK(map.count_if(odd, is_odd()) == parts && odd == 500);
+
+    lcore = launch(reduce_on_slave, &job);
+    wait_for(lcore);
+    if (lcore < RTE_MAX_LCORE)
+        CHECK(job.ret == -EPERM);
+
+    /* A busy slave gets no part */
+    lcore = rte_get_next_lcore(-1, 1, 0);
+    if (lcore >= RTE_MAX_LCORE)
+        return;
+    rte_eal_remote_launch(spin, &job, lcore);
+    total = odd = 0;
+    CHECK(map.reduce(total, uint64_t(0), sum_values(), sum()) == parts - 1);
+    CHECK(map.count_if(odd, is_odd()) == parts - 1 && odd == 500);
+    CHECK(total == 999 * 1000 / 2);
+    job.stop = 1;
+    rte_eal_wait_lcore(lcore);
+}
+
+struct pair_value {
+    uint32_t a;
+    uint32_t b;
+};
+
+typedef ShareHashMap<uint32_t, pair_value> pair_map;
+
+/* Rewrites the value in place, one half after the other */
+struct bump_pair {
+    void operator()(pair_value & __v, const pair_value &) const {
+        ++__v.a;
+        rte_compiler_barrier();
+        ++__v.b;
+    }
+};
+
+/* Counts the entries seen with the two halves of their value apart */
+struct torn_fold {
+    void operator()(uint64_t & __n, const pair_map::key_value_pair_type & __kv) const {
+        if (__kv.v.a != __kv.v.b)
+            ++__n;
+    }
+};
+
+struct update_job {
+    pair_map     *map;
+    uint32_t      keys;
+    uint32_t      rounds;
+    volatile int  done;
+};
+
+/* Updates in place, racing lock-free inserts and erases in the same buckets */
+static int
+update_pairs(void *arg)
+{
+    update_job *job = (update_job *)arg;
+    pair_value zero = {0, 0};
+
+    for (uint32_t r = 0; r < job->rounds; ++r) {
+        for (uint32_t i = 0; i < job->keys; ++i) {
+            job->map->update_value(check_key(i), zero, bump_pair());
+            if (r % 2)
+                job->map->insert(check_key(job->keys + i), zero);
+            else
+                job->map->erase(check_key(job->keys + i));
+        }
+    }
+    job->done = 1;
+    return 0;
+}
+
+/*
+ * Every write moves the bucket version by one write done, and readers of
+ * a lock-free table never see an update half way, whatever the writers
+ * overlapping it.
+ */
+static void
+check_lockfree_versions(void)
+{
+    pair_map map("chk_versions", 1 << 6, 8);
+    update_job job = {&map, 16, 2000, 0};
+    pair_value zero = {0, 0};
+    pair_map::key_value_pair_type kv;
+    pair_map::handle_type handles[16];
+    hash_sig_t sig = map.hash(check_key(0));
+    uint64_t torn = 0, n;
+    uint32_t v, i;
+    unsigned lcore;
+
+    CHECK(map.create(ShareRteHash::k_FLAG_LOCK_FREE | ShareRteHash::k_FLAG_GENERATIONS));
+
+    v = map.bucket_version(sig);
+    CHECK((v & ShareRteHash::k_VERSION_WRITERS) == 0);
+    CHECK(map.insert(check_key(0), zero) >= 0);
+    CHECK(map.bucket_version(sig) == v + ShareRteHash::k_VERSION_WRITE_DONE);
+    CHECK(map.update_value(check_key(0), zero, bump_pair()));
+    CHECK(map.bucket_version(sig) == v + 2 * ShareRteHash::k_VERSION_WRITE_DONE);
+
+    for (i = 0; i < job.keys; ++i) {
+        map.insert(check_key(i), zero);
+        CHECK(map.find(check_key(i), handles[i]) >= 0);
+    }
+
+    lcore = launch(update_pairs, &job);
+    do {
+        for (i = 0; i < job.keys; ++i) {
+            CHECK(map.read_entry(handles[i], kv));
+            if (kv.v.a != kv.v.b)
+                ++torn;
+        }
+        n = 0;
+        map.reduce(n, uint64_t(0), torn_fold(), sum());
+        torn += n;
+    } while (!job.done);
+    wait_for(lcore);
+    CHECK(torn == 0);
+}
+
+/*
+ * Tables are found through the catalog by name. The fingerprint tells
+ * key/value layouts apart, not geometry policies: a runtime geometry
+ * map may use a table created by a fixed geometry one.
+ */
+static void
+check_catalog_attach(void)
+{
+    typedef ShareFixedHashMap<uint32_t, uint32_t, 8> fixed_map;
+    typedef ShareHashMap<uint64_t, uint32_t> wide_map;
+    typedef share_fixed_geometry<8, sizeof(check_map::key_value_pair_type)> geometry_8;
+    typedef share_fixed_geometry<16, sizeof(check_map::key_value_pair_type)> geometry_16;
+    static const char long_name[] = "chk_catalog_with_a_name_longer_than_rte_hash_names";
+    fixed_map map("chk_catalog", 1 << 10), long_map(long_name, 1 << 10);
+    ShareRteHash & engine = ShareRteHash::instance();
+    const char *names[] = {"chk_catalog", "chk_catalog_missing", long_name};
+    rte_hash *tables[3];
+    rte_hash *h;
+
+    CHECK(map.create());
+    CHECK(long_map.create());
+    CHECK(map.insert(check_key(1), 1) >= 0);
+
+    CHECK(check_map::type_fingerprint() == fixed_map::type_fingerprint());
+    CHECK(check_map::type_fingerprint() != wide_map::type_fingerprint());
+
+    h = engine.attach_hash_table("chk_catalog", check_map::type_fingerprint());
+    CHECK(h != NULL);
+    if (h) {
+        check_map::key_value_pair_type kv;
+
+        CHECK(share_runtime_geometry::matches(h));
+        CHECK(geometry_8::matches(h));
+        CHECK(!geometry_16::matches(h));
+
+        kv.k = check_key(1);
+        CHECK(engine.lookup_with_hash<share_runtime_geometry>(h, &kv, map.hash(kv.k)) >= 0);
+    }
+
+    CHECK(engine.attach_hash_table("chk_catalog", wide_map::type_fingerprint()) == NULL);
+    CHECK(engine.attach_hash_table("chk_catalog_missing", check_map::type_fingerprint()) == NULL);
+    CHECK(engine.attach_hash_table(long_name, check_map::type_fingerprint()) != NULL);
+
+    CHECK(engine.attach_hash_tables(names, NULL, 3, tables) == 2);
+    CHECK(tables[0] == h && tables[1] == NULL && tables[2] != NULL);
+}
+
+/*
+ * A handle gives its entry until the entry is erased, even if the slot
+ * is reused; default, failed and out of range handles give nothing.
+ */
+static void
+check_handles(void)
+{
+    check_map map("chk_handles", 1 << 10, 8), plain("chk_handles_plain", 1 << 10, 8);
+    check_map::handle_type handle, stale, missing, none, outside;
+    check_map::key_value_pair_type kv, *entry;
+
+    CHECK(map.create(ShareRteHash::k_FLAG_GENERATIONS));
+    CHECK(plain.create());
+
+    CHECK(map.insert(check_key(1), 1) >= 0);
+    CHECK(map.find(check_key(1), handle) >= 0);
+    CHECK(map.valid(handle));
+    CHECK(map.read_entry(handle, kv) && kv.k == check_key(1) && kv.v == 1);
+    CHECK(map.get_entry_with_handle(entry, handle) && entry->v == 1);
+
+    /* Erased, then the key comes back in the same slot */
+    stale = handle;
+    CHECK(map.erase(check_key(1)) >= 0);
+    CHECK(!map.valid(stale));
+    CHECK(!map.read_entry(stale, kv));
+    CHECK(map.insert(check_key(1), 2) >= 0);
+    CHECK(map.find(check_key(1), handle) == stale.index);
+    CHECK(!map.valid(stale) && !map.read_entry(stale, kv));
+    CHECK(map.valid(handle));
+
+    CHECK(map.find(check_key(2), missing) == -ENOENT);
+    CHECK(!map.valid(missing) && !map.read_entry(missing, kv));
+    CHECK(!map.get_entry_with_handle(entry, missing));
+
+    none.index = 0;
+    none.generation = 0;
+    CHECK(!map.valid(none) && !map.read_entry(none, kv));
+
+    outside.index = (1 << 10) + 8;
+    outside.generation = 1;
+    CHECK(!map.valid(outside) && !map.read_entry(outside, kv));
+    outside.index = -1;
+    CHECK(!map.valid(outside) && !map.read_entry(outside, kv));
+
+    /* Without generations no handle is valid */
+    CHECK(plain.insert(check_key(1), 1) >= 0);
+    CHECK(plain.find(check_key(1), missing) == -ENOTSUP);
+    CHECK(!plain.valid(handle) && !plain.read_entry(handle, kv));
+}
+
+/* A key/value pair of k_RTE_HASH_KEY_VALUE_LENGTH_MAX bytes */
+struct wide_value {
+    uint32_t word[31];
+};
+
+/* Counts the entries walked on each side of a position */
+struct split_at {
+    uint32_t boundary;
+    uint32_t below;
+    uint32_t above;
+
+    split_at(uint32_t __boundary) : boundary(__boundary), below(0), above(0) {}
+    void operator()(const ShareHashMap<uint32_t, wide_value>::key_value_pair_type * __kv, uint32_t __index) {
+        if (__kv->v.word[0] != __kv->k || __kv->v.word[30] != ~__kv->k)
+            return;
+        if (__index < boundary)
+            ++below;
+        else
+            ++above;
+    }
+};
+
+/*
+ * A segmented table of two segments finds, walks and erases the entries
+ * of both, those of the buckets next to the boundary among them. The
+ * largest buckets make the segments small enough for the default
+ * SHARE_HASH_SEGMENT_SIZE.
+ */
+static void
+check_segment_boundary(void)
+{
+    typedef ShareHashMap<uint32_t, wide_value> segmented_map;
+    static const uint32_t bucket_entries = ShareRteHash::k_RTE_HASH_BUCKET_ENTRIES_MAX;
+    static const uint32_t keys = 100000;
+    segmented_map map("chk_segments", 1 << 19, bucket_entries);
+    segmented_map::key_value_pair_type *entry;
+    share_rte_hash_footprint fp;
+    uint32_t boundary, near[2] = {0, 0};
+    wide_value value;
+    int32_t position;
+    uint32_t i;
+
+    bool created = map.create(ShareRteHash::k_FLAG_SEGMENTED);
+
+    CHECK(created);
+    if (!created)
+        return;
+    map.footprint(fp);
+    CHECK(fp.segments == 2);
+    boundary = (1 << 19) / 2;
+
+    for (i = 0; i < keys; ++i) {
+        value.word[0] = check_key(i);
+        value.word[30] = ~check_key(i);
+        CHECK(map.insert(check_key(i), value) >= 0);
+    }
+    CHECK(map.used_entry_count() == (int32_t)keys);
+
+    for (i = 0; i < keys; ++i) {
+        position = map.find(check_key(i));
+        CHECK(position >= 0);
+        if (position < 0)
+            continue;
+        map.get_entry_with_index(entry, position);
+        CHECK(entry->k == check_key(i) && entry->v.word[30] == ~check_key(i));
+        if ((uint32_t)position / bucket_entries == boundary / bucket_entries - 1)
+            ++near[0];
+        if ((uint32_t)position / bucket_entries == boundary / bucket_entries)
+            ++near[1];
+    }
+    CHECK(near[0] > 0 && near[1] > 0);
+
+    split_at walk(boundary);
+    map.for_each(walk);
+    CHECK(walk.below > 0 && walk.above > 0 && walk.below + walk.above == keys);
+
+    for (i = 0; i < keys; i += 2)
+        CHECK(map.erase(check_key(i)) >= 0);
+    for (i = 0; i < keys; ++i)
+        CHECK((map.find(check_key(i)) >= 0) == (i % 2 == 1));
+    CHECK(map.used_entry_count() == (int32_t)keys / 2);
+}
+
+struct attach_job {
+    const char   *name;
+    rte_hash     *table;
+    volatile int  stop;
+};
+
+/* Attach a table as soon as it is there, give up once told to stop */
+static int
+attach_early(void *arg)
+{
+    attach_job *job = (attach_job *)arg;
+    ShareRteHash & engine = ShareRteHash::instance();
+    int stop;
+
+    for (;;) {
+        stop = job->stop;
+        job->table = engine.attach_hash_table(job->name, check_map::type_fingerprint());
+        if (job->table || stop)
+            break;
+        rte_pause();
+    }
+    return 0;
+}
+
+/*
+ * A table set up in parallel starts empty, works like any other, and is
+ * only attached once set up, even by an lcore trying all along.
+ */
+static void
+check_parallel_init(void)
+{
+    check_map map("chk_parallel", 1 << 16, 8);
+    attach_job job = {"chk_parallel", NULL, 0};
+    check_map::key_value_pair_type kv;
+    ShareRteHash & engine = ShareRteHash::instance();
+    unsigned lcore = rte_get_next_lcore(-1, 1, 0);
+    uint32_t i;
+
+    if (lcore < RTE_MAX_LCORE)
+        rte_eal_remote_launch(attach_early, &job, lcore);
+
+    CHECK(map.create(ShareRteHash::k_FLAG_PARALLEL_INIT | ShareRteHash::k_FLAG_GENERATIONS |
+                     ShareRteHash::k_FLAG_DIRTY_TRACKING));
+    CHECK(map.used_entry_count() == 0);
+    for (i = 0; i < 1000; ++i)
+        CHECK(map.find(check_key(i)) == -ENOENT);
+    for (i = 0; i < 1000; ++i)
+        CHECK(map.insert(check_key(i), i) >= 0);
+    CHECK(map.used_entry_count() == 1000);
+
+    job.stop = 1;
+    if (lcore < RTE_MAX_LCORE) {
+        rte_eal_wait_lcore(lcore);
+        CHECK(job.table != NULL);
+    } else {
+        attach_early(&job);
+    }
+    if (job.table) {
+        kv.k = check_key(7);
+        CHECK(engine.lookup_with_hash<share_runtime_geometry>(job.table, &kv, map.hash(kv.k)) >= 0);
+    }
+}
+
+/*
+ * create() of an existing name with another geometry fails, and leaves
+ * the table to those using it.
+ */
+static void
+check_create_existing(void)
+{
+    typedef ShareFixedHashMap<uint32_t, uint32_t, 8> map_8;
+    typedef ShareFixedHashMap<uint32_t, uint32_t, 16> map_16;
+    map_8 map("chk_existing", 1 << 10);
+    map_16 other("chk_existing", 1 << 10);
+    ShareRteHash & engine = ShareRteHash::instance();
+    rte_hash *h;
+
+    CHECK(map.create());
+    CHECK(map.insert(check_key(1), 1) >= 0);
+    h = engine.attach_hash_table("chk_existing", map_8::type_fingerprint());
+    CHECK(h != NULL);
+
+    CHECK(!other.create());
+    CHECK(engine.attach_hash_table("chk_existing", map_8::type_fingerprint()) == h);
+    CHECK(map.find(check_key(1)) >= 0);
+    CHECK(map.insert(check_key(2), 2) >= 0 && map.used_entry_count() == 2);
+}
+
+/*
+ * A string key is stored once, however often it is erased and inserted
+ * again. A full arena refuses new strings without overwriting any.
+ */
+static void
+check_string_arena(void)
+{
+    ShareStringHashMap<uint32_t> map("chk_strings", 1 << 10, 8, 4096);
+    char name[32];
+    uint32_t used, i, stored;
+    int32_t ret;
+
+    CHECK(map.create());
+
+    CHECK(map.insert("www.example.com", 1) >= 0);
+    used = map.arena_used();
+    for (i = 0; i < 100; ++i) {
+        CHECK(map.erase("www.example.com") >= 0);
+        CHECK(map.insert("www.example.com", i) >= 0);
+    }
+    CHECK(map.arena_used() == used);
+
+    /* Fill the arena, then keep trying */
+    for (stored = 0; ; ++stored) {
+        snprintf(name, sizeof(name), "host-%u.example.com", stored);
+        if ((ret = map.insert(name, stored)) < 0)
+            break;
+    }
+    CHECK(ret == -ENOSPC);
+    used = map.arena_used();
+    CHECK(used <= map.arena_capacity());
+    for (i = 0; i < 10000; ++i) {
+        snprintf(name, sizeof(name), "host-%u.example.com", stored + i);
+        CHECK(map.insert(name, i) == -ENOSPC);
+    }
+    CHECK(map.arena_used() == used);
+
+    CHECK(map.find("www.example.com") >= 0);
+    for (i = 0; i < stored; ++i) {
+        ShareStringHashMap<uint32_t>::key_value_pair_type *entry;
+        int32_t position;
+
+        snprintf(name, sizeof(name), "host-%u.example.com", i);
+        position = map.find(name);
+        CHECK(position >= 0);
+        if (position < 0)
+            continue;
+        map.get_entry_with_index(entry, position);
+        CHECK(entry->v == i);
+    }
+}
+
+/* A hasher with only 256 values, most keys share their hash with others */
+struct low_bits_hash {
+    size_t operator() (uint32_t key) const { return key & 0xff; }
+};
+
+/*
+ * Keys of one hasher value collide under every seed, the frozen table
+ * still builds and finds each of them, and nothing else.
+ */
+static void
+check_frozen_collisions(void)
+{
+    typedef ShareFrozenHashMap<uint32_t, uint32_t, low_bits_hash> frozen_map;
+    std::vector<frozen_map::key_value_pair_type> pairs;
+    frozen_map map("chk_frozen");
+    const frozen_map::key_value_pair_type *entry;
+    uint32_t i;
+    int32_t index;
+
+    for (i = 0; i < 4096; ++i) {
+        frozen_map::key_value_pair_type pair = { i * 7, i };
+        pairs.push_back(pair);
+    }
+    /* duplicated keys keep their first value */
+    frozen_map::key_value_pair_type dup = { 7 * 300, 0 };
+    pairs.push_back(dup);
+
+    CHECK(map.build(&pairs[0], pairs.size()));
+    CHECK(map.size() == 4096);
+    CHECK(map.overflow_size() == 4096 - 256);
+
+    for (i = 0; i < 4096; ++i) {
+        index = map.find(i * 7);
+        CHECK(index >= 0);
+        if (index < 0)
+            continue;
+        map.get_entry_with_index(entry, index);
+        CHECK(entry->k == i * 7 && entry->v == i);
+    }
+    for (i = 0; i < 4096; ++i)
+        CHECK(map.find(i * 7 + 1) == -ENOENT);
+}
+
+struct cache_lookups {
+    ShareHotKeyCache<check_map> *cache;
+    uint32_t                     found;
+};
+
+static void *
+cache_thread(void *arg)
+{
+    cache_lookups *lookups = (cache_lookups *)arg;
+
+    for (uint32_t i = 0; i < 1000; ++i)
+        if (lookups->cache->find(i) >= 0)
+            ++lookups->found;
+    return NULL;
+}
+
+/*
+ * A thread which isn't an lcore looks up the map directly and doesn't
+ * touch the cache of any lcore.
+ */
+static void
+check_hot_cache_threads(void)
+{
+    check_map map("chk_hot_cache", 1 << 12, 8);
+    unsigned lcore;
+    pthread_t thread;
+    uint32_t i;
+
+    CHECK(map.create());
+    for (i = 0; i < 1000; ++i)
+        CHECK(map.insert(i, i) >= 0);
+
+    ShareHotKeyCache<check_map> cache(map);
+    cache_lookups lookups = { &cache, 0 };
+
+    CHECK(pthread_create(&thread, NULL, cache_thread, &lookups) == 0);
+    pthread_join(thread, NULL);
+    CHECK(lookups.found == 1000);
+    for (lcore = 0; lcore < RTE_MAX_LCORE; ++lcore)
+        CHECK(cache.hits(lcore) == 0 && cache.misses(lcore) == 0);
+    CHECK(cache.hits(LCORE_ID_ANY) == 0);
+
+    CHECK(cache.find(1) >= 0 && cache.find(1) >= 0);
+    CHECK(cache.hits(rte_lcore_id()) == 1 && cache.misses(rte_lcore_id()) == 1);
+}
+
+typedef ShareShardedHashMap<uint32_t, uint32_t, sharehash::hash<uint32_t>,
+                            share_runtime_geometry, add<uint32_t> > adding_map;
+
+struct owner_job {
+    adding_map   * map;
+    volatile int   stop;
+};
+
+static int
+own_shard(void *arg)
+{
+    owner_job *job = (owner_job *)arg;
+
+    while (!job->stop)
+        job->map->poll();
+    job->map->poll();
+    return 0;
+}
+
+/* Update the value of a key from any lcore, wait for the result if forwarded */
+static int32_t
+apply_update(adding_map & map, uint32_t key, uint32_t value)
+{
+    adding_map::ticket_type ticket = NULL;
+    int32_t ret = map.update_value(key, value, &ticket);
+
+    if (ret == 0 && ticket != NULL)
+        return map.wait(key, ticket);
+    return ret;
+}
+
+/*
+ * A forwarded update applies the modifier of the map like a direct one,
+ * whatever the owner passes to its loop.
+ */
+static void
+check_sharded_update(void)
+{
+    unsigned lcore = rte_get_next_lcore(-1, 1, 0);
+    if (lcore >= RTE_MAX_LCORE)
+        return;
+
+    adding_map map("chk_sharded", 2, 1 << 10, 8);
+    const unsigned owners[2] = { rte_lcore_id(), lcore };
+    owner_job job = { &map, 0 };
+    adding_map::key_value_pair_type *entry;
+    uint32_t i, shard, forwarded = 0;
+    int32_t position;
+
+    CHECK(map.create(owners));
+    rte_eal_remote_launch(own_shard, &job, lcore);
+
+    for (i = 0; i < 100; ++i) {
+        adding_map::ticket_type ticket = NULL;
+        position = map.insert(i, 1, &ticket);
+        if (position == 0 && ticket != NULL)
+            position = map.wait(i, ticket);
+        CHECK(position >= 0);
+    }
+    for (i = 0; i < 100; ++i) {
+        CHECK(apply_update(map, i, 2) == 1);
+        CHECK(apply_update(map, i, 3) == 1);
+    }
+    job.stop = 1;
+    rte_eal_wait_lcore(lcore);
+
+    for (i = 0; i < 100; ++i) {
+        position = map.find(i, &shard);
+        CHECK(position >= 0);
+        if (position < 0)
+            continue;
+        map.get_entry_with_index(entry, shard, position);
+        CHECK(entry->v == 6);
+        forwarded += (shard == 1);
+    }
+    CHECK(forwarded > 0 && forwarded < 100);
+}
+
+static void
+run(const char *name, void (*check)(void))
+{
+    uint32_t before = failures;
+
+    printf("%s\n", name);
+    check();
+    printf("  %s\n", failures == before ? "ok" : "FAILED");
+}
+
+int
+main(int argc, char **argv)
+{
+    if (rte_eal_init(argc, argv) < 0)
+        rte_panic("Cannot init EAL\n");
+
+    run("changelog replay", check_changelog_replay);
+    run("checkpoint and restore", check_checkpoint_restore);
+    run("catalog attach", check_catalog_attach);
+    run("create an existing table", check_create_existing);
+    run("concurrent insert and erase", check_cas_concurrency);
+    run("lock-free versions", check_lockfree_versions);
+    run("segment boundary", check_segment_boundary);
+    run("handles", check_handles);
+    run("string arena", check_string_arena);
+    run("frozen collisions", check_frozen_collisions);
+    run("hot cache off an lcore", check_hot_cache_threads);
+    run("sharded update", check_sharded_update);
+    run("reduce", check_reduce);
+    run("parallel init", check_parallel_init);
+
+    printf("%u failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * @file : key_traits.h
+ * @description : how the hash table compares stored keys
+ *
+ * Keys are compared with operator== unless bitwise_key says that every
+ * byte of the key is significant. Then a memcmp of sizeof(key) bytes is
+ * used, which the compiler turns into a few fixed-size loads.
+ *
+ * A struct key may specialize bitwise_key only if it has no padding.
+ *
+ * shareable tells whether a key or value type may be stored at all.
+ */
+
+#ifndef __KEY_TRAITS_H__
+#define __KEY_TRAITS_H__
+
+#include <string.h>
+
+namespace sharehash {
+
+template <class _Key> struct bitwise_key { static const bool value = false; };
+
+template<> struct bitwise_key<char> { static const bool value = true; };
+template<> struct bitwise_key<signed char> { static const bool value = true; };
+template<> struct bitwise_key<unsigned char> { static const bool value = true; };
+template<> struct bitwise_key<short> { static const bool value = true; };
+template<> struct bitwise_key<unsigned short> { static const bool value = true; };
+template<> struct bitwise_key<int> { static const bool value = true; };
+template<> struct bitwise_key<unsigned int> { static const bool value = true; };
+template<> struct bitwise_key<long> { static const bool value = true; };
+template<> struct bitwise_key<unsigned long> { static const bool value = true; };
+template<> struct bitwise_key<long long> { static const bool value = true; };
+template<> struct bitwise_key<unsigned long long> { static const bool value = true; };
+
+template <class _Key, bool _Bitwise = bitwise_key<_Key>::value>
+struct key_compare {
+    static inline bool equal(const _Key & __a, const _Key & __b) {
+        return __a == __b;
+    }
+};
+
+template <class _Key>
+struct key_compare<_Key, true> {
+    static inline bool equal(const _Key & __a, const _Key & __b) {
+        return memcmp(&__a, &__b, sizeof(_Key)) == 0;
+    }
+};
+
+template <class _Key>
+inline bool key_equal(const _Key & __a, const _Key & __b)
+{
+    return key_compare<_Key>::equal(__a, __b);
+}
+
+/*
+ * Whether a type can live in a shared table: the entries are copied with
+ * memcpy and never destroyed, and another process may read them, so the
+ * type must be trivially copyable and destructible, with no vtable.
+ */
+template <class _Type>
+struct shareable {
+    static const bool value = __has_trivial_copy(_Type) && __has_trivial_assign(_Type) &&
+                              __has_trivial_destructor(_Type) && !__is_polymorphic(_Type);
+};
+
+}
+
+#endif
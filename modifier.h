@@ -15,6 +15,9 @@
  * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
  */
 
+#ifndef __MODIFIER_H__
+#define __MODIFIER_H__
+
 template <typename _Value>
 struct add {
     void operator() (_Value & left, const _Value & right) {
@@ -22,4 +25,12 @@ struct add {
     }
 };
 
+template <typename _Value>
+struct assign {
+    void operator() (_Value & left, const _Value & right) {
+        left = right;
+    }
+};
+
+#endif
 
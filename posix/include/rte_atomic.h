@@ -0,0 +1,69 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Atomic operations and barriers, with the GCC __sync builtins.
+ * The store and load barriers are compiler barriers, which is enough on x86.
+ */
+
+#ifndef _RTE_ATOMIC_H_
+#define _RTE_ATOMIC_H_
+#include <stdint.h>
+
+#define rte_mb()  __sync_synchronize()
+#define rte_wmb() __asm__ volatile ("" : : : "memory")
+#define rte_rmb() __asm__ volatile ("" : : : "memory")
+#define rte_compiler_barrier() __asm__ volatile ("" : : : "memory")
+
+typedef struct { volatile int16_t cnt; } rte_atomic16_t;
+typedef struct { volatile int32_t cnt; } rte_atomic32_t;
+typedef struct { volatile int64_t cnt; } rte_atomic64_t;
+#define RTE_ATOMIC32_INIT(val) { (val) }
+#define RTE_ATOMIC64_INIT(val) { (val) }
+
+static inline int rte_atomic16_cmpset(volatile uint16_t *dst, uint16_t exp, uint16_t src)
+{ return __sync_bool_compare_and_swap(dst, exp, src); }
+static inline int rte_atomic32_cmpset(volatile uint32_t *dst, uint32_t exp, uint32_t src)
+{ return __sync_bool_compare_and_swap(dst, exp, src); }
+static inline int rte_atomic64_cmpset(volatile uint64_t *dst, uint64_t exp, uint64_t src)
+{ return __sync_bool_compare_and_swap(dst, exp, src); }
+
+static inline void rte_atomic32_init(rte_atomic32_t *v) { v->cnt = 0; }
+static inline int32_t rte_atomic32_read(const rte_atomic32_t *v) { return v->cnt; }
+static inline void rte_atomic32_set(rte_atomic32_t *v, int32_t n) { v->cnt = n; }
+static inline void rte_atomic32_add(rte_atomic32_t *v, int32_t n) { __sync_fetch_and_add(&v->cnt, n); }
+static inline void rte_atomic32_sub(rte_atomic32_t *v, int32_t n) { __sync_fetch_and_sub(&v->cnt, n); }
+static inline void rte_atomic32_inc(rte_atomic32_t *v) { rte_atomic32_add(v, 1); }
+static inline void rte_atomic32_dec(rte_atomic32_t *v) { rte_atomic32_sub(v, 1); }
+static inline int32_t rte_atomic32_add_return(rte_atomic32_t *v, int32_t n) { return __sync_add_and_fetch(&v->cnt, n); }
+static inline int32_t rte_atomic32_sub_return(rte_atomic32_t *v, int32_t n) { return __sync_sub_and_fetch(&v->cnt, n); }
+static inline int rte_atomic32_inc_and_test(rte_atomic32_t *v) { return __sync_add_and_fetch(&v->cnt, 1) == 0; }
+static inline int rte_atomic32_dec_and_test(rte_atomic32_t *v) { return __sync_sub_and_fetch(&v->cnt, 1) == 0; }
+static inline int rte_atomic32_test_and_set(rte_atomic32_t *v) { return rte_atomic32_cmpset((volatile uint32_t *)&v->cnt, 0, 1); }
+static inline void rte_atomic32_clear(rte_atomic32_t *v) { v->cnt = 0; }
+
+static inline void rte_atomic64_init(rte_atomic64_t *v) { v->cnt = 0; }
+static inline int64_t rte_atomic64_read(rte_atomic64_t *v) { return v->cnt; }
+static inline void rte_atomic64_set(rte_atomic64_t *v, int64_t n) { v->cnt = n; }
+static inline void rte_atomic64_add(rte_atomic64_t *v, int64_t n) { __sync_fetch_and_add(&v->cnt, n); }
+static inline void rte_atomic64_sub(rte_atomic64_t *v, int64_t n) { __sync_fetch_and_sub(&v->cnt, n); }
+static inline void rte_atomic64_inc(rte_atomic64_t *v) { rte_atomic64_add(v, 1); }
+static inline void rte_atomic64_dec(rte_atomic64_t *v) { rte_atomic64_sub(v, 1); }
+static inline int64_t rte_atomic64_add_return(rte_atomic64_t *v, int64_t n) { return __sync_add_and_fetch(&v->cnt, n); }
+static inline int64_t rte_atomic64_sub_return(rte_atomic64_t *v, int64_t n) { return __sync_sub_and_fetch(&v->cnt, n); }
+static inline void rte_atomic64_clear(rte_atomic64_t *v) { v->cnt = 0; }
+#endif
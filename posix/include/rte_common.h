@@ -0,0 +1,66 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Alignment macros and helpers.
+ */
+
+#ifndef _RTE_COMMON_H_
+#define _RTE_COMMON_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <emmintrin.h>
+
+#define CACHE_LINE_SIZE 64
+#define CACHE_LINE_MASK (CACHE_LINE_SIZE - 1)
+#define __rte_cache_aligned __attribute__((__aligned__(CACHE_LINE_SIZE)))
+#define __rte_unused __attribute__((__unused__))
+#define RTE_SET_USED(x) (void)(x)
+#define RTE_PTR_ADD(ptr, x) ((void *)((uintptr_t)(ptr) + (x)))
+#define RTE_ALIGN_CEIL(val, align) \
+	(((val) + ((typeof(val))(align) - 1)) & (~((typeof(val))((align) - 1))))
+#define RTE_ALIGN(val, align) RTE_ALIGN_CEIL(val, align)
+#define RTE_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define RTE_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define RTE_DIM(a) (sizeof(a) / sizeof((a)[0]))
+
+static inline int
+rte_is_power_of_2(uint32_t n)
+{
+	return n && !(n & (n - 1));
+}
+
+static inline uint32_t
+rte_align32pow2(uint32_t x)
+{
+	x--;
+	x |= x >> 1;
+	x |= x >> 2;
+	x |= x >> 4;
+	x |= x >> 8;
+	x |= x >> 16;
+	return x + 1;
+}
+
+static inline void
+rte_pause(void)
+{
+	_mm_pause();
+}
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: TSC access. rte_get_tsc_hz() is measured at rte_eal_init.
+ */
+
+#ifndef _RTE_CYCLES_H_
+#define _RTE_CYCLES_H_
+#include <stdint.h>
+static inline uint64_t
+rte_rdtsc(void)
+{
+	uint32_t lo, hi;
+	__asm__ volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t)hi << 32) | lo;
+}
+#ifdef __cplusplus
+extern "C" {
+#endif
+uint64_t rte_get_tsc_hz(void);
+void rte_delay_us(unsigned us);
+#ifdef __cplusplus
+}
+#endif
+#endif
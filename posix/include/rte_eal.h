@@ -0,0 +1,42 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Process configuration and rte_eal_init.
+ */
+
+#ifndef _RTE_EAL_H_
+#define _RTE_EAL_H_
+#include <stdint.h>
+enum rte_proc_type_t { RTE_PROC_AUTO = -1, RTE_PROC_PRIMARY = 0, RTE_PROC_SECONDARY, RTE_PROC_INVALID };
+struct rte_mem_config;
+struct rte_config {
+	uint32_t master_lcore;
+	uint32_t lcore_count;
+	enum rte_proc_type_t process_type;
+	struct rte_mem_config *mem_config;
+};
+#ifdef __cplusplus
+extern "C" {
+#endif
+struct rte_config *rte_eal_get_configuration(void);
+enum rte_proc_type_t rte_eal_process_type(void);
+int rte_eal_init(int argc, char **argv);
+#ifdef __cplusplus
+}
+#endif
+#endif
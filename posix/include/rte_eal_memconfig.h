@@ -0,0 +1,67 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Head of the shared segment: the memzone registry, the tail queues
+ * and their locks.
+ */
+
+#ifndef _RTE_EAL_MEMCONFIG_H_
+#define _RTE_EAL_MEMCONFIG_H_
+#include <sys/queue.h>
+#include <rte_rwlock.h>
+#include <rte_spinlock.h>
+#include <rte_memzone.h>
+#include <rte_eal.h>
+
+enum rte_tailq_t {
+	RTE_TAILQ_PCI = 0,
+	RTE_TAILQ_MEMPOOL,
+	RTE_TAILQ_RING,
+	RTE_TAILQ_HASH,
+	RTE_TAILQ_FBK_HASH,
+	RTE_TAILQ_LPM,
+	RTE_TAILQ_NUM
+};
+#define RTE_MAX_TAILQ RTE_TAILQ_NUM
+#define RTE_MAX_MEMZONE 2560
+
+struct rte_dummy { TAILQ_ENTRY(rte_dummy) next; };
+TAILQ_HEAD(rte_dummy_head, rte_dummy);
+
+#define RTE_TAILQ_NAMESIZE 32
+struct rte_tailq_head {
+	struct rte_dummy_head tailq_head;
+	char qname[RTE_TAILQ_NAMESIZE];
+};
+
+struct rte_mem_config {
+	volatile uint32_t magic;
+	uint64_t size;
+	rte_rwlock_t mlock;
+	rte_rwlock_t qlock;
+	rte_rwlock_t mplock;
+	rte_spinlock_t heap_lock;
+	uint64_t heap_start;
+	uint32_t memzone_idx;
+	struct rte_memzone memzone[RTE_MAX_MEMZONE];
+	struct rte_tailq_head tailq_head[RTE_MAX_TAILQ];
+} __rte_cache_aligned;
+
+#define RTE_EAL_TAILQ_RWLOCK (&rte_eal_get_configuration()->mem_config->qlock)
+#define RTE_EAL_MEMPOOL_RWLOCK (&rte_eal_get_configuration()->mem_config->mplock)
+#endif
@@ -0,0 +1,40 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Per-thread rte_errno and the dpdk error codes.
+ */
+
+#ifndef _RTE_ERRNO_H_
+#define _RTE_ERRNO_H_
+#include <errno.h>
+#include <rte_per_lcore.h>
+RTE_DECLARE_PER_LCORE(int, _rte_errno);
+#define rte_errno RTE_PER_LCORE(_rte_errno)
+#define RTE_MAX_ERRNO 1024
+enum {
+	RTE_MIN_ERRNO = 1000,
+	E_RTE_SECONDARY,
+	E_RTE_NO_CONFIG,
+	E_RTE_NO_TAILQ,
+	RTE_MAX_ERRNO_
+};
+#ifdef __cplusplus
+extern "C"
+#endif
+const char *rte_strerror(int errnum);
+#endif
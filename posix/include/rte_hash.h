@@ -0,0 +1,62 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: struct rte_hash as laid out by dpdk 1.6, ShareRteHash uses it as
+ * table header.
+ */
+
+#ifndef _RTE_HASH_H_
+#define _RTE_HASH_H_
+#include <stdint.h>
+#include <sys/queue.h>
+
+#define RTE_HASH_ENTRIES_MAX (1 << 26)
+#define RTE_HASH_BUCKET_ENTRIES_MAX 16
+#define RTE_HASH_KEY_LENGTH_MAX 64
+#define RTE_HASH_NAMESIZE 32
+
+typedef uint32_t hash_sig_t;
+typedef uint32_t (*rte_hash_function)(const void *key, uint32_t key_len, uint32_t init_val);
+
+struct rte_hash_parameters {
+	const char *name;
+	uint32_t entries;
+	uint32_t bucket_entries;
+	uint32_t key_len;
+	rte_hash_function hash_func;
+	uint32_t hash_func_init_val;
+	int socket_id;
+};
+
+struct rte_hash {
+	TAILQ_ENTRY(rte_hash) next;
+	char name[RTE_HASH_NAMESIZE];
+	uint32_t entries;
+	uint32_t bucket_entries;
+	uint32_t key_len;
+	rte_hash_function hash_func;
+	uint32_t hash_func_init_val;
+	uint32_t num_buckets;
+	uint32_t bucket_bitmask;
+	hash_sig_t sig_msb;
+	uint8_t *sig_tbl;
+	uint32_t sig_tbl_bucket_size;
+	uint8_t *key_tbl;
+	uint32_t key_tbl_key_size;
+};
+#endif
@@ -0,0 +1,58 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: CRC32c hash, with SSE4.2 when the compiler targets it.
+ */
+
+#ifndef _RTE_HASH_CRC_H_
+#define _RTE_HASH_CRC_H_
+#include <stdint.h>
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+static inline uint32_t
+rte_hash_crc_4byte(uint32_t data, uint32_t init_val)
+{
+#ifdef __SSE4_2__
+	return _mm_crc32_u32(init_val, data);
+#else
+	uint32_t crc = init_val ^ data;
+	for (int i = 0; i < 32; i++)
+		crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+	return crc;
+#endif
+}
+
+static inline uint32_t
+rte_hash_crc(const void *data, uint32_t data_len, uint32_t init_val)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	uint32_t i, tmp;
+	for (i = 0; i + 4 <= data_len; i += 4) {
+		__builtin_memcpy(&tmp, p + i, 4);
+		init_val = rte_hash_crc_4byte(tmp, init_val);
+	}
+	if (i < data_len) {
+		tmp = 0;
+		__builtin_memcpy(&tmp, p + i, data_len - i);
+		init_val = rte_hash_crc_4byte(tmp, init_val);
+	}
+	return init_val;
+}
+#endif
@@ -0,0 +1,88 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Jenkins hash, as in dpdk 1.6.
+ */
+
+#ifndef _RTE_JHASH_H_
+#define _RTE_JHASH_H_
+#include <stdint.h>
+
+#define RTE_JHASH_GOLDEN_RATIO 0x9e3779b9
+
+#define __rte_jhash_mix(a, b, c) do { \
+	a -= b; a -= c; a ^= (c>>13); \
+	b -= c; b -= a; b ^= (a<<8); \
+	c -= a; c -= b; c ^= (b>>13); \
+	a -= b; a -= c; a ^= (c>>12); \
+	b -= c; b -= a; b ^= (a<<16); \
+	c -= a; c -= b; c ^= (b>>5); \
+	a -= b; a -= c; a ^= (c>>3); \
+	b -= c; b -= a; b ^= (a<<10); \
+	c -= a; c -= b; c ^= (b>>15); \
+} while (0)
+
+static inline uint32_t
+rte_jhash(const void *key, uint32_t length, uint32_t initval)
+{
+	uint32_t a, b, c, len;
+	const uint8_t *k = (const uint8_t *)key;
+
+	len = length;
+	a = b = RTE_JHASH_GOLDEN_RATIO;
+	c = initval;
+
+	while (len >= 12) {
+		a += (k[0] + ((uint32_t)k[1] << 8) + ((uint32_t)k[2] << 16) + ((uint32_t)k[3] << 24));
+		b += (k[4] + ((uint32_t)k[5] << 8) + ((uint32_t)k[6] << 16) + ((uint32_t)k[7] << 24));
+		c += (k[8] + ((uint32_t)k[9] << 8) + ((uint32_t)k[10] << 16) + ((uint32_t)k[11] << 24));
+		__rte_jhash_mix(a, b, c);
+		k += 12;
+		len -= 12;
+	}
+
+	c += length;
+	switch (len) {
+		case 11: c += ((uint32_t)k[10] << 24); /* fallthrough */
+		case 10: c += ((uint32_t)k[9] << 16); /* fallthrough */
+		case 9 : c += ((uint32_t)k[8] << 8); /* fallthrough */
+		case 8 : b += ((uint32_t)k[7] << 24); /* fallthrough */
+		case 7 : b += ((uint32_t)k[6] << 16); /* fallthrough */
+		case 6 : b += ((uint32_t)k[5] << 8); /* fallthrough */
+		case 5 : b += k[4]; /* fallthrough */
+		case 4 : a += ((uint32_t)k[3] << 24); /* fallthrough */
+		case 3 : a += ((uint32_t)k[2] << 16); /* fallthrough */
+		case 2 : a += ((uint32_t)k[1] << 8); /* fallthrough */
+		case 1 : a += k[0]; /* fallthrough */
+		default: break;
+	};
+
+	__rte_jhash_mix(a, b, c);
+	return c;
+}
+
+static inline uint32_t
+rte_jhash_1word(uint32_t a, uint32_t initval)
+{
+	uint32_t b = RTE_JHASH_GOLDEN_RATIO, c = initval;
+	a += RTE_JHASH_GOLDEN_RATIO;
+	c += 4;
+	__rte_jhash_mix(a, b, c);
+	return c;
+}
+#endif
@@ -0,0 +1,38 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Running functions on the slave lcores.
+ */
+
+#ifndef _RTE_LAUNCH_H_
+#define _RTE_LAUNCH_H_
+enum rte_lcore_state_t { WAIT, RUNNING, FINISHED };
+typedef int (lcore_function_t)(void *);
+enum rte_rmt_call_master_t { SKIP_MASTER = 0, CALL_MASTER };
+#ifdef __cplusplus
+extern "C" {
+#endif
+int rte_eal_remote_launch(lcore_function_t *f, void *arg, unsigned slave_id);
+int rte_eal_mp_remote_launch(lcore_function_t *f, void *arg, enum rte_rmt_call_master_t call_master);
+enum rte_lcore_state_t rte_eal_get_lcore_state(unsigned slave_id);
+int rte_eal_wait_lcore(unsigned slave_id);
+void rte_eal_mp_wait_lcore(void);
+#ifdef __cplusplus
+}
+#endif
+#endif
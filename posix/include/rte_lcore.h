@@ -0,0 +1,54 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: lcores are pthreads created by rte_eal_init from the -c coremask.
+ */
+
+#ifndef _RTE_LCORE_H_
+#define _RTE_LCORE_H_
+#include <rte_per_lcore.h>
+#include <rte_eal.h>
+#include <rte_launch.h>
+
+#define RTE_MAX_LCORE 64
+#define LCORE_ID_ANY -1
+#include <rte_memory.h>
+#define RTE_MAX_NUMA_NODES 8
+
+RTE_DECLARE_PER_LCORE(unsigned, _lcore_id);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+unsigned rte_lcore_count(void);
+unsigned rte_get_master_lcore(void);
+int rte_lcore_is_enabled(unsigned lcore_id);
+unsigned rte_get_next_lcore(unsigned i, int skip_master, int wrap);
+unsigned rte_socket_id(void);
+unsigned rte_lcore_to_socket_id(unsigned lcore_id);
+#ifdef __cplusplus
+}
+#endif
+
+static inline unsigned rte_lcore_id(void) { return RTE_PER_LCORE(_lcore_id); }
+
+#define RTE_LCORE_FOREACH(i) \
+	for (i = rte_get_next_lcore(-1, 0, 0); i < RTE_MAX_LCORE; i = rte_get_next_lcore(i, 0, 0))
+#define RTE_LCORE_FOREACH_SLAVE(i) \
+	for (i = rte_get_next_lcore(-1, 1, 0); i < RTE_MAX_LCORE; i = rte_get_next_lcore(i, 1, 0))
+#endif
@@ -0,0 +1,36 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Allocation from the shared segment.
+ */
+
+#ifndef _RTE_MALLOC_H_
+#define _RTE_MALLOC_H_
+#include <stddef.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+void *rte_malloc(const char *type, size_t size, unsigned align);
+void *rte_zmalloc(const char *type, size_t size, unsigned align);
+void *rte_malloc_socket(const char *type, size_t size, unsigned align, int socket);
+void *rte_zmalloc_socket(const char *type, size_t size, unsigned align, int socket);
+void rte_free(void *ptr);
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,33 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Memory types and SOCKET_ID_ANY. There is a single socket.
+ */
+
+#ifndef _RTE_MEMORY_H_
+#define _RTE_MEMORY_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <rte_common.h>
+typedef uint64_t phys_addr_t;
+
+#define SOCKET_ID_ANY -1
+#define RTE_PGSIZE_4K (1ULL << 12)
+#define RTE_PGSIZE_2M (1ULL << 21)
+#define RTE_PGSIZE_1G (1ULL << 30)
+#endif
@@ -0,0 +1,70 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Fixed size object pools, one ring of free objects each, no
+ * per-lcore cache.
+ */
+
+#ifndef _RTE_MEMPOOL_H_
+#define _RTE_MEMPOOL_H_
+#include <stdint.h>
+#include <errno.h>
+#include <rte_common.h>
+#include <rte_ring.h>
+
+#define RTE_MEMPOOL_NAMESIZE 32
+#define MEMPOOL_F_SP_PUT 0x0004
+#define MEMPOOL_F_SC_GET 0x0008
+
+struct rte_mempool {
+	char name[RTE_MEMPOOL_NAMESIZE];
+	struct rte_ring *ring;
+	unsigned size;
+	unsigned elt_size;
+	unsigned private_data_size;
+	void *elt_va_start;
+	void *elt_va_end;
+} __rte_cache_aligned;
+
+typedef void (rte_mempool_obj_ctor_t)(struct rte_mempool *, void *, void *, unsigned);
+typedef void (rte_mempool_ctor_t)(struct rte_mempool *, void *);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+struct rte_mempool *rte_mempool_create(const char *name, unsigned n, unsigned elt_size,
+		unsigned cache_size, unsigned private_data_size,
+		rte_mempool_ctor_t *mp_init, void *mp_init_arg,
+		rte_mempool_obj_ctor_t *obj_init, void *obj_init_arg,
+		int socket_id, unsigned flags);
+struct rte_mempool *rte_mempool_lookup(const char *name);
+#ifdef __cplusplus
+}
+#endif
+
+static inline int rte_mempool_get(struct rte_mempool *mp, void **obj_p)
+{ return rte_ring_dequeue(mp->ring, obj_p); }
+static inline int rte_mempool_get_bulk(struct rte_mempool *mp, void **obj_table, unsigned n)
+{ return rte_ring_dequeue_bulk(mp->ring, obj_table, n); }
+static inline void rte_mempool_put(struct rte_mempool *mp, void *obj)
+{ rte_ring_enqueue(mp->ring, obj); }
+static inline void rte_mempool_put_bulk(struct rte_mempool *mp, void * const *obj_table, unsigned n)
+{ rte_ring_enqueue_bulk(mp->ring, obj_table, n); }
+static inline unsigned rte_mempool_count(const struct rte_mempool *mp)
+{ return rte_ring_count(mp->ring); }
+#endif
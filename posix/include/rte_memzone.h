@@ -0,0 +1,52 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Named memzones, carved from the shared segment and never freed.
+ */
+
+#ifndef _RTE_MEMZONE_H_
+#define _RTE_MEMZONE_H_
+#include <stdio.h>
+#include <rte_memory.h>
+#define RTE_MEMZONE_NAMESIZE 32
+#define RTE_MEMZONE_2MB 0x00000001
+#define RTE_MEMZONE_1GB 0x00000002
+#define RTE_MEMZONE_SIZE_HINT_ONLY 0x00000004
+struct rte_memzone {
+	char name[RTE_MEMZONE_NAMESIZE];
+	phys_addr_t phys_addr;
+	union {
+		void *addr;
+		uint64_t addr_64;
+	};
+	size_t len;
+	size_t hugepage_sz;
+	int32_t socket_id;
+	uint32_t flags;
+} __attribute__((__packed__));
+#ifdef __cplusplus
+extern "C" {
+#endif
+const struct rte_memzone *rte_memzone_reserve(const char *name, size_t len, int socket_id, unsigned flags);
+const struct rte_memzone *rte_memzone_reserve_aligned(const char *name, size_t len, int socket_id, unsigned flags, unsigned align);
+const struct rte_memzone *rte_memzone_lookup(const char *name);
+void rte_memzone_dump(FILE *f);
+#ifdef __cplusplus
+}
+#endif
+#endif
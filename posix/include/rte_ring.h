@@ -0,0 +1,179 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Lock-free multi-producer/multi-consumer ring, same algorithm as dpdk.
+ */
+
+#ifndef _RTE_RING_H_
+#define _RTE_RING_H_
+#include <stdint.h>
+#include <errno.h>
+#include <sys/queue.h>
+#include <rte_common.h>
+#include <rte_atomic.h>
+#include <rte_memzone.h>
+
+#define RTE_RING_NAMESIZE 32
+#define RTE_RING_SZ_MASK (unsigned)(0x0fffffff)
+#define RING_F_SP_ENQ 0x0001
+#define RING_F_SC_DEQ 0x0002
+
+struct rte_ring {
+	TAILQ_ENTRY(rte_ring) next;
+	char name[RTE_RING_NAMESIZE];
+	int flags;
+	struct prod {
+		uint32_t watermark;
+		uint32_t sp_enqueue;
+		uint32_t size;
+		uint32_t mask;
+		volatile uint32_t head;
+		volatile uint32_t tail;
+	} prod __rte_cache_aligned;
+	struct cons {
+		uint32_t sc_dequeue;
+		uint32_t size;
+		uint32_t mask;
+		volatile uint32_t head;
+		volatile uint32_t tail;
+	} cons __rte_cache_aligned;
+	void *ring[0] __rte_cache_aligned;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+struct rte_ring *rte_ring_create(const char *name, unsigned count, int socket_id, unsigned flags);
+struct rte_ring *rte_ring_lookup(const char *name);
+#ifdef __cplusplus
+}
+#endif
+
+static inline unsigned
+__rte_ring_do_enqueue(struct rte_ring *r, void * const *obj_table, unsigned n, int fixed, int single)
+{
+	uint32_t prod_head, prod_next, cons_tail, free_entries;
+	unsigned i, max = n;
+	int success;
+	uint32_t mask = r->prod.mask;
+
+	do {
+		n = max;
+		prod_head = r->prod.head;
+		cons_tail = r->cons.tail;
+		free_entries = mask + cons_tail - prod_head;
+		if (n > free_entries) {
+			if (fixed)
+				return 0;
+			n = free_entries;
+			if (n == 0)
+				return 0;
+		}
+		prod_next = prod_head + n;
+		if (single) {
+			r->prod.head = prod_next;
+			success = 1;
+		} else
+			success = rte_atomic32_cmpset(&r->prod.head, prod_head, prod_next);
+	} while (success == 0);
+
+	for (i = 0; i < n; i++)
+		r->ring[(prod_head + i) & mask] = obj_table[i];
+	rte_wmb();
+
+	while (r->prod.tail != prod_head)
+		rte_pause();
+	r->prod.tail = prod_next;
+	return n;
+}
+
+static inline unsigned
+__rte_ring_do_dequeue(struct rte_ring *r, void **obj_table, unsigned n, int fixed, int single)
+{
+	uint32_t cons_head, prod_tail, cons_next, entries;
+	unsigned i, max = n;
+	int success;
+	uint32_t mask = r->prod.mask;
+
+	do {
+		n = max;
+		cons_head = r->cons.head;
+		prod_tail = r->prod.tail;
+		entries = prod_tail - cons_head;
+		if (n > entries) {
+			if (fixed)
+				return 0;
+			n = entries;
+			if (n == 0)
+				return 0;
+		}
+		cons_next = cons_head + n;
+		if (single) {
+			r->cons.head = cons_next;
+			success = 1;
+		} else
+			success = rte_atomic32_cmpset(&r->cons.head, cons_head, cons_next);
+	} while (success == 0);
+
+	for (i = 0; i < n; i++)
+		obj_table[i] = r->ring[(cons_head + i) & mask];
+	rte_rmb();
+
+	while (r->cons.tail != cons_head)
+		rte_pause();
+	r->cons.tail = cons_next;
+	return n;
+}
+
+static inline int rte_ring_mp_enqueue_bulk(struct rte_ring *r, void * const *obj_table, unsigned n)
+{ return __rte_ring_do_enqueue(r, obj_table, n, 1, 0) ? 0 : -ENOBUFS; }
+static inline int rte_ring_sp_enqueue_bulk(struct rte_ring *r, void * const *obj_table, unsigned n)
+{ return __rte_ring_do_enqueue(r, obj_table, n, 1, 1) ? 0 : -ENOBUFS; }
+static inline int rte_ring_enqueue_bulk(struct rte_ring *r, void * const *obj_table, unsigned n)
+{ return __rte_ring_do_enqueue(r, obj_table, n, 1, r->prod.sp_enqueue) ? 0 : -ENOBUFS; }
+static inline int rte_ring_mp_enqueue(struct rte_ring *r, void *obj) { return rte_ring_mp_enqueue_bulk(r, &obj, 1); }
+static inline int rte_ring_sp_enqueue(struct rte_ring *r, void *obj) { return rte_ring_sp_enqueue_bulk(r, &obj, 1); }
+static inline int rte_ring_enqueue(struct rte_ring *r, void *obj) { return rte_ring_enqueue_bulk(r, &obj, 1); }
+static inline unsigned rte_ring_mp_enqueue_burst(struct rte_ring *r, void * const *obj_table, unsigned n)
+{ return __rte_ring_do_enqueue(r, obj_table, n, 0, 0); }
+static inline unsigned rte_ring_enqueue_burst(struct rte_ring *r, void * const *obj_table, unsigned n)
+{ return __rte_ring_do_enqueue(r, obj_table, n, 0, r->prod.sp_enqueue); }
+
+static inline int rte_ring_mc_dequeue_bulk(struct rte_ring *r, void **obj_table, unsigned n)
+{ return __rte_ring_do_dequeue(r, obj_table, n, 1, 0) ? 0 : -ENOENT; }
+static inline int rte_ring_sc_dequeue_bulk(struct rte_ring *r, void **obj_table, unsigned n)
+{ return __rte_ring_do_dequeue(r, obj_table, n, 1, 1) ? 0 : -ENOENT; }
+static inline int rte_ring_dequeue_bulk(struct rte_ring *r, void **obj_table, unsigned n)
+{ return __rte_ring_do_dequeue(r, obj_table, n, 1, r->cons.sc_dequeue) ? 0 : -ENOENT; }
+static inline int rte_ring_mc_dequeue(struct rte_ring *r, void **obj_p) { return rte_ring_mc_dequeue_bulk(r, obj_p, 1); }
+static inline int rte_ring_sc_dequeue(struct rte_ring *r, void **obj_p) { return rte_ring_sc_dequeue_bulk(r, obj_p, 1); }
+static inline int rte_ring_dequeue(struct rte_ring *r, void **obj_p) { return rte_ring_dequeue_bulk(r, obj_p, 1); }
+static inline unsigned rte_ring_sc_dequeue_burst(struct rte_ring *r, void **obj_table, unsigned n)
+{ return __rte_ring_do_dequeue(r, obj_table, n, 0, 1); }
+static inline unsigned rte_ring_mc_dequeue_burst(struct rte_ring *r, void **obj_table, unsigned n)
+{ return __rte_ring_do_dequeue(r, obj_table, n, 0, 0); }
+static inline unsigned rte_ring_dequeue_burst(struct rte_ring *r, void **obj_table, unsigned n)
+{ return __rte_ring_do_dequeue(r, obj_table, n, 0, r->cons.sc_dequeue); }
+
+static inline unsigned rte_ring_count(const struct rte_ring *r)
+{ return (r->prod.tail - r->cons.tail) & r->prod.mask; }
+static inline unsigned rte_ring_free_count(const struct rte_ring *r)
+{ return (r->cons.tail - r->prod.tail - 1) & r->prod.mask; }
+static inline int rte_ring_empty(const struct rte_ring *r) { return r->cons.tail == r->prod.tail; }
+static inline int rte_ring_full(const struct rte_ring *r) { return rte_ring_free_count(r) == 0; }
+#endif
@@ -0,0 +1,73 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Reader/writer spin lock on one atomic counter, as in dpdk.
+ */
+
+#ifndef _RTE_RWLOCK_H_
+#define _RTE_RWLOCK_H_
+#include <rte_common.h>
+#include <rte_atomic.h>
+
+typedef struct { volatile int32_t cnt; } rte_rwlock_t;
+#define RTE_RWLOCK_INITIALIZER { 0 }
+
+static inline void rte_rwlock_init(rte_rwlock_t *rwl) { rwl->cnt = 0; }
+
+static inline void
+rte_rwlock_read_lock(rte_rwlock_t *rwl)
+{
+	int32_t x;
+	int success = 0;
+	while (success == 0) {
+		x = rwl->cnt;
+		if (x < 0) {
+			rte_pause();
+			continue;
+		}
+		success = rte_atomic32_cmpset((volatile uint32_t *)&rwl->cnt, x, x + 1);
+	}
+}
+
+static inline void
+rte_rwlock_read_unlock(rte_rwlock_t *rwl)
+{
+	__sync_fetch_and_sub(&rwl->cnt, 1);
+}
+
+static inline void
+rte_rwlock_write_lock(rte_rwlock_t *rwl)
+{
+	int32_t x;
+	int success = 0;
+	while (success == 0) {
+		x = rwl->cnt;
+		if (x != 0) {
+			rte_pause();
+			continue;
+		}
+		success = rte_atomic32_cmpset((volatile uint32_t *)&rwl->cnt, 0, -1);
+	}
+}
+
+static inline void
+rte_rwlock_write_unlock(rte_rwlock_t *rwl)
+{
+	__sync_fetch_and_add(&rwl->cnt, 1);
+}
+#endif
@@ -0,0 +1,38 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Spin lock.
+ */
+
+#ifndef _RTE_SPINLOCK_H_
+#define _RTE_SPINLOCK_H_
+#include <rte_common.h>
+#include <rte_atomic.h>
+
+typedef struct { volatile int locked; } rte_spinlock_t;
+#define RTE_SPINLOCK_INITIALIZER { 0 }
+static inline void rte_spinlock_init(rte_spinlock_t *sl) { sl->locked = 0; }
+static inline void rte_spinlock_lock(rte_spinlock_t *sl)
+{
+	while (__sync_lock_test_and_set(&sl->locked, 1))
+		while (sl->locked)
+			rte_pause();
+}
+static inline void rte_spinlock_unlock(rte_spinlock_t *sl) { __sync_lock_release(&sl->locked); }
+static inline int rte_spinlock_trylock(rte_spinlock_t *sl) { return __sync_lock_test_and_set(&sl->locked, 1) == 0; }
+#endif
@@ -0,0 +1,38 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * POSIX backend: Shared tail queues, used to find rte_hash tables by name.
+ */
+
+#ifndef _RTE_TAILQ_H_
+#define _RTE_TAILQ_H_
+#include <sys/queue.h>
+#include <rte_eal.h>
+#include <rte_eal_memconfig.h>
+
+
+#define RTE_TAILQ_LOOKUP_BY_IDX(idx, struct_name) \
+	(struct struct_name *)&rte_eal_get_configuration()->mem_config->tailq_head[idx].tailq_head
+
+#define RTE_EAL_TAILQ_REMOVE(idx, type, elm) do { \
+	struct type *list = RTE_TAILQ_LOOKUP_BY_IDX(idx, type); \
+	rte_rwlock_write_lock(RTE_EAL_TAILQ_RWLOCK); \
+	TAILQ_REMOVE(list, elm, next); \
+	rte_rwlock_write_unlock(RTE_EAL_TAILQ_RWLOCK); \
+} while (0)
+#endif
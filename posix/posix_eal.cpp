@@ -0,0 +1,718 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * Description:
+ *
+ * POSIX backend: the part of the dpdk EAL which the share hash map uses,
+ * so that it builds with plain g++ and runs on any Linux box.
+ *
+ * All the processes share one segment, /dev/shm/<prefix>_share_mem
+ * (--file-prefix, "rte" by default), created by shm_open and mapped at
+ * the same address in every process, so that pointers stored in shared
+ * memory stay valid. It begins with struct rte_mem_config, which holds
+ * the memzone registry and the tail queues; the rest is a first-fit heap
+ * for rte_malloc and the memzones.
+ *
+ * Options: -c coremask, -m megabytes, --file-prefix=, --proc-type=.
+ * Huge pages, NUMA and the PCI devices are not supported.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_log.h>
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_lcore.h>
+#include <rte_launch.h>
+#include <rte_memzone.h>
+#include <rte_malloc.h>
+#include <rte_tailq.h>
+#include <rte_ring.h>
+#include <rte_mempool.h>
+#include <rte_string_fns.h>
+
+#define POSIX_EAL_MAGIC      0x53484d31
+#define POSIX_EAL_BASE_ADDR  0x100000000000ULL
+#define POSIX_EAL_DEFAULT_MB 1024
+
+RTE_DEFINE_PER_LCORE(int, _rte_errno);
+RTE_DEFINE_PER_LCORE(unsigned, _lcore_id) = (unsigned)LCORE_ID_ANY;
+
+struct lcore_config {
+	int enabled;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	lcore_function_t *volatile f;
+	void *volatile arg;
+	volatile int ret;
+	volatile enum rte_lcore_state_t state;
+};
+
+static struct rte_config config;
+static struct lcore_config lcore_config[RTE_MAX_LCORE];
+static uint64_t tsc_hz;
+
+/* Heap block header, kept one cache line long so payloads stay aligned */
+struct heap_block {
+	uint64_t size;       /* whole block, header included */
+	uint32_t free;
+	uint32_t magic;
+	uint64_t pad[6];
+};
+
+#define HEAP_BLOCK_MAGIC 0x4b4c4248U
+
+struct rte_config *
+rte_eal_get_configuration(void)
+{
+	return &config;
+}
+
+enum rte_proc_type_t
+rte_eal_process_type(void)
+{
+	return config.process_type;
+}
+
+const char *
+rte_strerror(int errnum)
+{
+	switch (errnum) {
+	case E_RTE_SECONDARY: return "Invalid call in secondary process";
+	case E_RTE_NO_CONFIG: return "Missing rte_config structure";
+	case E_RTE_NO_TAILQ: return "No TAILQ initialised";
+	default: return strerror(errnum);
+	}
+}
+
+uint64_t
+rte_get_tsc_hz(void)
+{
+	return tsc_hz;
+}
+
+void
+rte_delay_us(unsigned us)
+{
+	uint64_t end = rte_rdtsc() + tsc_hz / 1000000 * us;
+	while (rte_rdtsc() < end)
+		rte_pause();
+}
+
+static uint64_t
+estimate_tsc_hz(void)
+{
+	struct timespec sleep = { 0, 20 * 1000 * 1000 };
+	uint64_t start = rte_rdtsc();
+	nanosleep(&sleep, NULL);
+	return (rte_rdtsc() - start) * 50;
+}
+
+/*
+ * Shared heap: a first-fit list of blocks laid out one after another in the
+ * mapped segment. It is only used at create/free time.
+ */
+static inline struct heap_block *
+heap_first(void)
+{
+	return (struct heap_block *)((uint8_t *)config.mem_config + config.mem_config->heap_start);
+}
+
+static inline struct heap_block *
+heap_next(struct heap_block *b)
+{
+	uint8_t *end = (uint8_t *)config.mem_config + config.mem_config->size;
+	uint8_t *next = (uint8_t *)b + b->size;
+	return next >= end ? NULL : (struct heap_block *)next;
+}
+
+void *
+rte_malloc_socket(const char *type, size_t size, unsigned align, int socket)
+{
+	struct heap_block *b, *n;
+	uint64_t need;
+	void *ret = NULL;
+
+	RTE_SET_USED(type);
+	RTE_SET_USED(socket);
+
+	if (align == 0)
+		align = CACHE_LINE_SIZE;
+	if (!rte_is_power_of_2(align))
+		return NULL;
+	/* Payloads are cache aligned; larger alignments are padded */
+	need = RTE_ALIGN_CEIL((uint64_t)size, (uint64_t)CACHE_LINE_SIZE) + sizeof(struct heap_block);
+	if (align > CACHE_LINE_SIZE)
+		need += align;
+
+	rte_spinlock_lock(&config.mem_config->heap_lock);
+	for (b = heap_first(); b != NULL; b = heap_next(b)) {
+		if (!b->free)
+			continue;
+		/* coalesce following free blocks */
+		while ((n = heap_next(b)) != NULL && n->free)
+			b->size += n->size;
+		if (b->size < need)
+			continue;
+		if (b->size - need >= 2 * sizeof(struct heap_block)) {
+			n = (struct heap_block *)((uint8_t *)b + need);
+			n->size = b->size - need;
+			n->free = 1;
+			n->magic = HEAP_BLOCK_MAGIC;
+			b->size = need;
+		}
+		b->free = 0;
+		ret = (void *)(b + 1);
+		break;
+	}
+	rte_spinlock_unlock(&config.mem_config->heap_lock);
+
+	if (ret != NULL && align > CACHE_LINE_SIZE) {
+		/* record the owning block just before the aligned payload */
+		uintptr_t p = RTE_ALIGN_CEIL((uintptr_t)ret + sizeof(struct heap_block), (uintptr_t)align);
+		struct heap_block *shadow = (struct heap_block *)p - 1;
+		shadow->size = (uint64_t)((uint8_t *)shadow - (uint8_t *)(b));
+		shadow->free = 0;
+		shadow->magic = ~HEAP_BLOCK_MAGIC;
+		ret = (void *)p;
+	}
+	return ret;
+}
+
+void *
+rte_zmalloc_socket(const char *type, size_t size, unsigned align, int socket)
+{
+	void *p = rte_malloc_socket(type, size, align, socket);
+	if (p != NULL)
+		memset(p, 0, size);
+	return p;
+}
+
+void *
+rte_malloc(const char *type, size_t size, unsigned align)
+{
+	return rte_malloc_socket(type, size, align, SOCKET_ID_ANY);
+}
+
+void *
+rte_zmalloc(const char *type, size_t size, unsigned align)
+{
+	return rte_zmalloc_socket(type, size, align, SOCKET_ID_ANY);
+}
+
+void
+rte_free(void *ptr)
+{
+	struct heap_block *b;
+
+	if (ptr == NULL)
+		return;
+	b = (struct heap_block *)ptr - 1;
+	if (b->magic == ~HEAP_BLOCK_MAGIC)
+		b = (struct heap_block *)((uint8_t *)b - b->size);
+	if (b->magic != HEAP_BLOCK_MAGIC) {
+		RTE_LOG(ERR, EAL, "rte_free: invalid pointer %p\n", ptr);
+		return;
+	}
+	rte_spinlock_lock(&config.mem_config->heap_lock);
+	b->free = 1;
+	rte_spinlock_unlock(&config.mem_config->heap_lock);
+}
+
+/* Memzones are carved from the same heap but never released, as in DPDK */
+const struct rte_memzone *
+rte_memzone_reserve_aligned(const char *name, size_t len, int socket_id, unsigned flags, unsigned align)
+{
+	struct rte_mem_config *mcfg = config.mem_config;
+	struct rte_memzone *mz = NULL;
+	void *addr;
+	uint32_t i;
+
+	if (config.process_type == RTE_PROC_SECONDARY) {
+		rte_errno = E_RTE_SECONDARY;
+		return NULL;
+	}
+
+	rte_rwlock_write_lock(&mcfg->mlock);
+	for (i = 0; i < mcfg->memzone_idx; i++) {
+		if (strncmp(name, mcfg->memzone[i].name, RTE_MEMZONE_NAMESIZE) == 0) {
+			rte_errno = EEXIST;
+			goto exit;
+		}
+	}
+	if (mcfg->memzone_idx >= RTE_MAX_MEMZONE) {
+		rte_errno = ENOSPC;
+		goto exit;
+	}
+	addr = rte_zmalloc_socket(name, len, align, socket_id);
+	if (addr == NULL) {
+		rte_errno = ENOMEM;
+		goto exit;
+	}
+	mz = &mcfg->memzone[mcfg->memzone_idx];
+	rte_snprintf(mz->name, sizeof(mz->name), "%s", name);
+	mz->addr = addr;
+	mz->phys_addr = (phys_addr_t)(uintptr_t)addr;
+	mz->len = len;
+	mz->hugepage_sz = RTE_PGSIZE_4K;
+	mz->socket_id = socket_id;
+	mz->flags = flags;
+	rte_wmb();
+	mcfg->memzone_idx++;
+exit:
+	rte_rwlock_write_unlock(&mcfg->mlock);
+	return mz;
+}
+
+const struct rte_memzone *
+rte_memzone_reserve(const char *name, size_t len, int socket_id, unsigned flags)
+{
+	return rte_memzone_reserve_aligned(name, len, socket_id, flags, CACHE_LINE_SIZE);
+}
+
+const struct rte_memzone *
+rte_memzone_lookup(const char *name)
+{
+	struct rte_mem_config *mcfg = config.mem_config;
+	const struct rte_memzone *mz = NULL;
+	uint32_t i;
+
+	rte_rwlock_read_lock(&mcfg->mlock);
+	for (i = 0; i < mcfg->memzone_idx; i++) {
+		if (strncmp(name, mcfg->memzone[i].name, RTE_MEMZONE_NAMESIZE) == 0) {
+			mz = &mcfg->memzone[i];
+			break;
+		}
+	}
+	rte_rwlock_read_unlock(&mcfg->mlock);
+	return mz;
+}
+
+void
+rte_memzone_dump(FILE *f)
+{
+	struct rte_mem_config *mcfg = config.mem_config;
+	uint32_t i;
+
+	for (i = 0; i < mcfg->memzone_idx; i++)
+		fprintf(f, "Zone %u: name:<%s>, addr:%p, len:0x%zx, socket_id:%d\n", i,
+			mcfg->memzone[i].name, mcfg->memzone[i].addr,
+			mcfg->memzone[i].len, mcfg->memzone[i].socket_id);
+}
+
+struct rte_ring *
+rte_ring_create(const char *name, unsigned count, int socket_id, unsigned flags)
+{
+	char mz_name[RTE_MEMZONE_NAMESIZE];
+	const struct rte_memzone *mz;
+	struct rte_ring *r;
+
+	if (!rte_is_power_of_2(count) || count > RTE_RING_SZ_MASK) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+	rte_snprintf(mz_name, sizeof(mz_name), "RG_%s", name);
+	mz = rte_memzone_reserve(mz_name, sizeof(*r) + count * sizeof(void *), socket_id, 0);
+	if (mz == NULL)
+		return NULL;
+	r = (struct rte_ring *)mz->addr;
+	rte_snprintf(r->name, sizeof(r->name), "%s", name);
+	r->flags = flags;
+	r->prod.sp_enqueue = !!(flags & RING_F_SP_ENQ);
+	r->cons.sc_dequeue = !!(flags & RING_F_SC_DEQ);
+	r->prod.size = r->cons.size = count;
+	r->prod.mask = r->cons.mask = count - 1;
+	r->prod.head = r->cons.head = 0;
+	r->prod.tail = r->cons.tail = 0;
+	return r;
+}
+
+struct rte_ring *
+rte_ring_lookup(const char *name)
+{
+	char mz_name[RTE_MEMZONE_NAMESIZE];
+	const struct rte_memzone *mz;
+
+	rte_snprintf(mz_name, sizeof(mz_name), "RG_%s", name);
+	mz = rte_memzone_lookup(mz_name);
+	if (mz == NULL) {
+		rte_errno = ENOENT;
+		return NULL;
+	}
+	return (struct rte_ring *)mz->addr;
+}
+
+struct rte_mempool *
+rte_mempool_create(const char *name, unsigned n, unsigned elt_size,
+		unsigned cache_size, unsigned private_data_size,
+		rte_mempool_ctor_t *mp_init, void *mp_init_arg,
+		rte_mempool_obj_ctor_t *obj_init, void *obj_init_arg,
+		int socket_id, unsigned flags)
+{
+	char mz_name[RTE_MEMZONE_NAMESIZE];
+	const struct rte_memzone *mz;
+	struct rte_mempool *mp;
+	unsigned ring_flags = 0, i;
+	size_t obj_size, hdr_size;
+	uint8_t *obj;
+
+	RTE_SET_USED(cache_size);
+
+	if (flags & MEMPOOL_F_SP_PUT)
+		ring_flags |= RING_F_SP_ENQ;
+	if (flags & MEMPOOL_F_SC_GET)
+		ring_flags |= RING_F_SC_DEQ;
+
+	rte_snprintf(mz_name, sizeof(mz_name), "MP_%s", name);
+	obj_size = RTE_ALIGN_CEIL((size_t)elt_size, (size_t)CACHE_LINE_SIZE);
+	hdr_size = RTE_ALIGN_CEIL(sizeof(*mp) + private_data_size, (size_t)CACHE_LINE_SIZE);
+	mz = rte_memzone_reserve(mz_name, hdr_size + obj_size * n, socket_id, 0);
+	if (mz == NULL)
+		return NULL;
+	mp = (struct rte_mempool *)mz->addr;
+	mp->ring = rte_ring_create(mz_name, rte_align32pow2(n + 1), socket_id, ring_flags);
+	if (mp->ring == NULL)
+		return NULL;
+	rte_snprintf(mp->name, sizeof(mp->name), "%s", name);
+	mp->size = n;
+	mp->elt_size = elt_size;
+	mp->private_data_size = private_data_size;
+	mp->elt_va_start = (uint8_t *)mz->addr + hdr_size;
+	mp->elt_va_end = (uint8_t *)mp->elt_va_start + obj_size * n;
+
+	if (mp_init)
+		mp_init(mp, mp_init_arg);
+
+	obj = (uint8_t *)mp->elt_va_start;
+	for (i = 0; i < n; i++, obj += obj_size) {
+		if (obj_init)
+			obj_init(mp, obj_init_arg, obj, i);
+		rte_ring_enqueue(mp->ring, obj);
+	}
+	return mp;
+}
+
+struct rte_mempool *
+rte_mempool_lookup(const char *name)
+{
+	char mz_name[RTE_MEMZONE_NAMESIZE];
+	const struct rte_memzone *mz;
+
+	rte_snprintf(mz_name, sizeof(mz_name), "MP_%s", name);
+	mz = rte_memzone_lookup(mz_name);
+	if (mz == NULL) {
+		rte_errno = ENOENT;
+		return NULL;
+	}
+	return (struct rte_mempool *)mz->addr;
+}
+
+/* lcore management: one pthread per enabled slave lcore */
+unsigned
+rte_lcore_count(void)
+{
+	return config.lcore_count;
+}
+
+unsigned
+rte_get_master_lcore(void)
+{
+	return config.master_lcore;
+}
+
+int
+rte_lcore_is_enabled(unsigned lcore_id)
+{
+	if (lcore_id >= RTE_MAX_LCORE)
+		return 0;
+	return lcore_config[lcore_id].enabled;
+}
+
+unsigned
+rte_get_next_lcore(unsigned i, int skip_master, int wrap)
+{
+	i++;
+	if (wrap)
+		i %= RTE_MAX_LCORE;
+
+	while (i < RTE_MAX_LCORE) {
+		if (!rte_lcore_is_enabled(i) ||
+		    (skip_master && (i == rte_get_master_lcore()))) {
+			i++;
+			if (wrap)
+				i %= RTE_MAX_LCORE;
+			continue;
+		}
+		break;
+	}
+	return i;
+}
+
+unsigned
+rte_socket_id(void)
+{
+	return 0;
+}
+
+unsigned
+rte_lcore_to_socket_id(unsigned lcore_id)
+{
+	RTE_SET_USED(lcore_id);
+	return 0;
+}
+
+static void *
+lcore_thread(void *arg)
+{
+	unsigned lcore_id = (unsigned)(uintptr_t)arg;
+	struct lcore_config *lc = &lcore_config[lcore_id];
+
+	RTE_PER_LCORE(_lcore_id) = lcore_id;
+
+	for (;;) {
+		lcore_function_t *f;
+		void *farg;
+
+		pthread_mutex_lock(&lc->mutex);
+		while (lc->state != RUNNING)
+			pthread_cond_wait(&lc->cond, &lc->mutex);
+		f = lc->f;
+		farg = lc->arg;
+		pthread_mutex_unlock(&lc->mutex);
+
+		lc->ret = f(farg);
+
+		pthread_mutex_lock(&lc->mutex);
+		lc->state = FINISHED;
+		pthread_cond_broadcast(&lc->cond);
+		pthread_mutex_unlock(&lc->mutex);
+	}
+	return NULL;
+}
+
+int
+rte_eal_remote_launch(lcore_function_t *f, void *arg, unsigned slave_id)
+{
+	struct lcore_config *lc = &lcore_config[slave_id];
+	int ret = -EBUSY;
+
+	pthread_mutex_lock(&lc->mutex);
+	if (lc->state == WAIT) {
+		lc->f = f;
+		lc->arg = arg;
+		lc->state = RUNNING;
+		pthread_cond_broadcast(&lc->cond);
+		ret = 0;
+	}
+	pthread_mutex_unlock(&lc->mutex);
+	return ret;
+}
+
+enum rte_lcore_state_t
+rte_eal_get_lcore_state(unsigned slave_id)
+{
+	return lcore_config[slave_id].state;
+}
+
+int
+rte_eal_wait_lcore(unsigned slave_id)
+{
+	struct lcore_config *lc = &lcore_config[slave_id];
+	int ret;
+
+	pthread_mutex_lock(&lc->mutex);
+	if (lc->state == WAIT) {
+		pthread_mutex_unlock(&lc->mutex);
+		return 0;
+	}
+	while (lc->state != FINISHED)
+		pthread_cond_wait(&lc->cond, &lc->mutex);
+	lc->state = WAIT;
+	ret = lc->ret;
+	pthread_mutex_unlock(&lc->mutex);
+	return ret;
+}
+
+int
+rte_eal_mp_remote_launch(lcore_function_t *f, void *arg, enum rte_rmt_call_master_t call_master)
+{
+	unsigned lcore_id;
+
+	RTE_LCORE_FOREACH_SLAVE(lcore_id) {
+		if (rte_eal_remote_launch(f, arg, lcore_id) < 0)
+			return -EBUSY;
+	}
+	if (call_master == CALL_MASTER)
+		f(arg);
+	return 0;
+}
+
+void
+rte_eal_mp_wait_lcore(void)
+{
+	unsigned lcore_id;
+
+	RTE_LCORE_FOREACH_SLAVE(lcore_id)
+		rte_eal_wait_lcore(lcore_id);
+}
+
+static int
+eal_map_segment(const char *prefix, uint64_t size)
+{
+	char path[128];
+	struct stat st;
+	void *addr;
+	int fd, flags = MAP_SHARED | MAP_FIXED;
+	int primary = (config.process_type == RTE_PROC_PRIMARY);
+
+	rte_snprintf(path, sizeof(path), "/%s_share_mem", prefix);
+	fd = shm_open(path, primary ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0600);
+	if (fd < 0 && config.process_type == RTE_PROC_AUTO) {
+		primary = 1;
+		fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+	}
+	if (fd < 0) {
+		RTE_LOG(ERR, EAL, "cannot open shared segment %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (config.process_type == RTE_PROC_AUTO)
+		config.process_type = primary ? RTE_PROC_PRIMARY : RTE_PROC_SECONDARY;
+
+	if (primary) {
+		if (ftruncate(fd, (off_t)size) < 0) {
+			close(fd);
+			return -1;
+		}
+	} else {
+		if (fstat(fd, &st) < 0 || st.st_size == 0) {
+			close(fd);
+			return -1;
+		}
+		size = (uint64_t)st.st_size;
+	}
+
+#ifdef MAP_FIXED_NOREPLACE
+	flags = MAP_SHARED | MAP_FIXED_NOREPLACE;
+#endif
+	addr = mmap((void *)(uintptr_t)POSIX_EAL_BASE_ADDR, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+	close(fd);
+	if (addr != (void *)(uintptr_t)POSIX_EAL_BASE_ADDR) {
+		RTE_LOG(ERR, EAL, "cannot map shared segment at %p\n", (void *)(uintptr_t)POSIX_EAL_BASE_ADDR);
+		return -1;
+	}
+
+	config.mem_config = (struct rte_mem_config *)addr;
+	if (primary) {
+		struct rte_mem_config *mcfg = config.mem_config;
+		struct heap_block *b;
+		unsigned i;
+
+		mcfg->size = size;
+		rte_rwlock_init(&mcfg->mlock);
+		rte_rwlock_init(&mcfg->qlock);
+		rte_rwlock_init(&mcfg->mplock);
+		rte_spinlock_init(&mcfg->heap_lock);
+		for (i = 0; i < RTE_MAX_TAILQ; i++)
+			TAILQ_INIT(&mcfg->tailq_head[i].tailq_head);
+		mcfg->heap_start = RTE_ALIGN_CEIL((uint64_t)sizeof(*mcfg), (uint64_t)CACHE_LINE_SIZE);
+		b = heap_first();
+		b->size = size - mcfg->heap_start;
+		b->free = 1;
+		b->magic = HEAP_BLOCK_MAGIC;
+		rte_wmb();
+		mcfg->magic = POSIX_EAL_MAGIC;
+	} else {
+		while (config.mem_config->magic != POSIX_EAL_MAGIC)
+			rte_pause();
+	}
+	return 0;
+}
+
+int
+rte_eal_init(int argc, char **argv)
+{
+	const char *prefix = "rte";
+	uint64_t coremask = 1, mem_mb = POSIX_EAL_DEFAULT_MB;
+	int i, lcore_id, parsed = 0;
+
+	config.process_type = RTE_PROC_PRIMARY;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--") == 0) {
+			parsed = i;
+			break;
+		}
+		if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+			coremask = strtoull(argv[++i], NULL, 16);
+		else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			i++;
+		else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+			mem_mb = strtoull(argv[++i], NULL, 0);
+		else if (strncmp(argv[i], "--file-prefix=", 14) == 0)
+			prefix = argv[i] + 14;
+		else if (strcmp(argv[i], "--proc-type=primary") == 0)
+			config.process_type = RTE_PROC_PRIMARY;
+		else if (strcmp(argv[i], "--proc-type=secondary") == 0)
+			config.process_type = RTE_PROC_SECONDARY;
+		else if (strcmp(argv[i], "--proc-type=auto") == 0)
+			config.process_type = RTE_PROC_AUTO;
+		parsed = i;
+	}
+
+	if (coremask == 0)
+		return -1;
+
+	tsc_hz = estimate_tsc_hz();
+	if (eal_map_segment(prefix, mem_mb << 20) < 0)
+		return -1;
+
+	config.master_lcore = (uint32_t)__builtin_ctzll(coremask);
+	config.lcore_count = 0;
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++) {
+		struct lcore_config *lc = &lcore_config[lcore_id];
+
+		if (!(coremask & (1ULL << lcore_id)))
+			continue;
+		lc->enabled = 1;
+		lc->state = WAIT;
+		config.lcore_count++;
+		pthread_mutex_init(&lc->mutex, NULL);
+		pthread_cond_init(&lc->cond, NULL);
+		if ((unsigned)lcore_id == config.master_lcore)
+			continue;
+		if (pthread_create(&lc->thread, NULL, lcore_thread, (void *)(uintptr_t)lcore_id) != 0)
+			return -1;
+	}
+	RTE_PER_LCORE(_lcore_id) = config.master_lcore;
+
+	return parsed;
+}
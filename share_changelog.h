@@ -0,0 +1,164 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * Description:
+ *
+ * Tail the change log of a ShareHashMap, see ShareHashMap::create_changelog,
+ * to keep a standby copy of the table current.
+ *
+ * Every add, del, update, erase_if and clear of the table appends a record
+ * holding the operation, the signature, the slot and the whole key/value
+ * pair as it is after the change, so applying a record twice does no harm.
+ *
+ * A reader starts with snapshot(): it notes the head of the log, hands
+ * every entry of the table to the handler as an add, then goes on from the
+ * noted head with poll(). Changes made during the walk are seen twice,
+ * which is fine. When poll() returns -ERANGE the reader fell more than a
+ * log behind and must take a snapshot again.
+ *
+ * The handler is called as handler(op, const key_value_pair_type &), op is
+ * one of ShareRteHash::k_CHANGE_*. ShareStandby applies the changes to
+ * another map; a handler may as well send them to a standby in another
+ * dpdk process group.
+ *
+ *   ShareChangeLogReader<map_type> reader(map);
+ *   ShareStandby<map_type> standby(standby_map);
+ *
+ *   reader.snapshot(standby);
+ *   for (;;)
+ *       if (reader.poll(standby) == -ERANGE)
+ *           reader.snapshot(standby);
+ */
+
+#ifndef _SHARE_CHANGELOG_H_
+#define _SHARE_CHANGELOG_H_
+
+#include <stdint.h>
+#include <errno.h>
+
+#include "share_rte_hash.h"
+
+template <class _Map>
+class ShareChangeLogReader {
+    public:
+        static const uint32_t DEFAULT_BURST_SIZE = 32;
+
+        typedef typename _Map::key_value_pair_type key_value_pair_type;
+
+    public:
+        ShareChangeLogReader(_Map & __map) : m_map(__map), m_seq(0) {}
+
+        /*
+         * Hand the whole table to __handler, then position the reader at
+         * the head of the log as it was before the walk. Returns that
+         * sequence number.
+         */
+        template<typename _Handler>
+        uint64_t snapshot(_Handler & __handler) {
+            uint64_t seq = m_map.changelog_head();
+            snapshot_visitor<_Handler> visit(__handler);
+
+            m_map.for_each(visit);
+            m_seq = seq;
+            return seq;
+        }
+
+        // go on from a sequence number, e.g. one kept by the standby
+        void seek(uint64_t __seq) { m_seq = __seq; }
+
+        // the next record to read
+        uint64_t position(void) { return m_seq; }
+
+        /*
+         * Hand up to __burst new records to __handler. Returns how many, or
+         * -ERANGE if records were lost: take a snapshot again.
+         */
+        template<typename _Handler>
+        int32_t poll(_Handler & __handler, uint32_t __burst = DEFAULT_BURST_SIZE) {
+            share_rte_hash_change change;
+            key_value_pair_type kv;
+            uint32_t n;
+            int ret;
+
+            for (n = 0; n < __burst; ++n) {
+                ret = m_map.read_change(m_seq, change, kv);
+                if (ret == -EAGAIN)
+                    break;
+                if (ret < 0)
+                    return ret;
+
+                __handler(change.op, kv);
+                ++m_seq;
+            }
+            return n;
+        }
+
+    private:
+        template<typename _Handler>
+        struct snapshot_visitor {
+            _Handler & handler;
+            snapshot_visitor(_Handler & __handler) : handler(__handler) {}
+            void operator()(const key_value_pair_type * __kv, uint32_t) {
+                handler(ShareRteHash::k_CHANGE_ADD, *__kv);
+            }
+        };
+
+    private:
+        _Map   & m_map;
+        uint64_t m_seq;
+};
+
+/* A handler of ShareChangeLogReader which applies the changes to a map */
+template <class _Map>
+class ShareStandby {
+    public:
+        typedef typename _Map::key_value_pair_type key_value_pair_type;
+        typedef typename _Map::value_type value_type;
+
+    public:
+        ShareStandby(_Map & __map) : m_map(__map), m_failed(0) {}
+
+        void operator()(uint32_t __op, const key_value_pair_type & __kv) {
+            switch (__op) {
+                case ShareRteHash::k_CHANGE_ADD:
+                case ShareRteHash::k_CHANGE_UPDATE:
+                    if (m_map.insert(__kv.k, __kv.v) < 0)
+                        ++m_failed;
+                    else
+                        m_map.update_value(__kv.k, __kv.v, assign());
+                    break;
+                case ShareRteHash::k_CHANGE_DEL:
+                    m_map.erase(__kv.k);
+                    break;
+            }
+        }
+
+        // adds which found the standby full
+        uint64_t failed(void) { return m_failed; }
+
+    private:
+        struct assign {
+            void operator()(value_type & __left, const value_type & __right) const { __left = __right; }
+        };
+
+    private:
+        _Map   & m_map;
+        uint64_t m_failed;
+};
+
+#endif
@@ -0,0 +1,391 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * Description:
+ *
+ * An immutable hash map for tables which are built once and then only
+ * read. The primary process builds it from a ShareHashMap or an array,
+ * and secondary processes attach to it by name.
+ *
+ * Keys are placed with a minimal perfect hash (hash and displace): the
+ * key hash picks a small displacement bucket, and the displacement of
+ * that bucket picks the slot. Every key owns exactly one slot, so the
+ * entries are stored densely and a lookup reads one slot without locks.
+ *
+ * Keys whose hasher gives the same value can't be told apart by any seed.
+ * The first one is placed, the others go to a small overflow run after
+ * the placed entries, sorted by hash. A lookup only searches it when the
+ * slot holds another key and the run isn't empty.
+ *
+ * The table lives in one memzone, FZ_<name>, which DPDK can't release.
+ * The memory layout looks like following graphic:
+ *
+ *     +--------+----------------------+-----------------------------+------------------+
+ *     | header | displacement[buckets]| key_value[entries+overflow] | hash[overflow]   |
+ *     +--------+----------------------+-----------------------------+------------------+
+ */
+
+#ifndef _SHARE_FROZEN_HASHMAP_H_
+#define _SHARE_FROZEN_HASHMAP_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <vector>
+#include <algorithm>
+
+#include <rte_common.h>
+#include <rte_branch_prediction.h>
+#include <rte_log.h>
+#include <rte_errno.h>
+#include <rte_memzone.h>
+#include <rte_string_fns.h>
+
+#include "hash_func.h"
+#include "share_hashmap.h"
+
+/* Layout of the head of the FZ_<name> memzone */
+struct share_frozen_header {
+    uint32_t num_entries;
+    uint32_t num_buckets;
+    uint32_t key_value_size;
+    uint32_t seed;
+    uint32_t disp_offset;
+    uint32_t entry_offset;
+    uint32_t num_overflow;      /* entries after num_entries, see ShareFrozenHashMap */
+    uint32_t overflow_offset;   /* hashes of the overflow entries */
+} __rte_cache_aligned;
+
+template <class _Key, class _Value, class _HashFunc = sharehash::hash<_Key> >
+class ShareFrozenHashMap {
+    public:
+        /* Average keys per displacement bucket */
+        static const uint32_t KEYS_PER_BUCKET = 4;
+        static const uint32_t MAX_DISPLACEMENT = 1 << 20;
+        static const uint32_t MAX_SEEDS = 16;
+
+    public:
+        typedef _Key key_type;
+        typedef _Value value_type;
+        typedef _HashFunc hasher;
+
+        typedef struct KeyValuePair {
+            key_type   k;
+            value_type v;
+        } key_value_pair_type;
+
+    public:
+        ShareFrozenHashMap(const char * __name)
+            : m_name(__name), m_header(NULL), m_disp(NULL), m_entries(NULL), m_overflow(NULL) {}
+
+        // build the table from an existing map, used by primary process
+        template<typename _Map>
+        bool build(_Map & __map) {
+            collector<typename _Map::key_value_pair_type> collect;
+            __map.for_each(collect);
+            return build(collect.pairs.empty() ? NULL : &collect.pairs[0], collect.pairs.size());
+        }
+
+        // build the table from an array, used by primary process
+        // duplicated keys keep their first value
+        template<typename _KeyValue>
+        bool build(const _KeyValue * __pairs, uint32_t __count) {
+            std::vector<uint32_t> disp, order, overflow;
+            uint32_t num_buckets = __count / KEYS_PER_BUCKET + 1;
+            uint32_t seed, i;
+
+            for (seed = 0; seed < MAX_SEEDS; ++seed) {
+                if (place(__pairs, __count, num_buckets, seed, disp, order, overflow))
+                    break;
+            }
+            if (seed == MAX_SEEDS) {
+                RTE_LOG(ERR, HASH, "ShareFrozenHashMap::build can't place the keys of %s\n", m_name);
+                rte_errno = EINVAL;
+                return false;
+            }
+
+            if (!reserve(order.size(), overflow.size(), num_buckets))
+                return false;
+
+            m_header->seed = seed;
+            memcpy(m_disp, &disp[0], num_buckets * sizeof(uint32_t));
+            for (i = 0; i < order.size(); ++i) {
+                key_value_pair_type * entry = &m_entries[slot(__pairs[order[i]].k)];
+                entry->k = __pairs[order[i]].k;
+                entry->v = __pairs[order[i]].v;
+            }
+
+            std::sort(overflow.begin(), overflow.end(), hash_less<_KeyValue>(__pairs, m_hash_func));
+            for (i = 0; i < overflow.size(); ++i) {
+                key_value_pair_type * entry = &m_entries[order.size() + i];
+                entry->k = __pairs[overflow[i]].k;
+                entry->v = __pairs[overflow[i]].v;
+                m_overflow[i] = m_hash_func(entry->k);
+            }
+            return true;
+        }
+
+        // attach to an existing table, used by secondary process
+        bool attach(void) {
+            char mz_name[RTE_MEMZONE_NAMESIZE];
+            const struct rte_memzone *mz;
+
+            rte_snprintf(mz_name, sizeof(mz_name), "FZ_%s", m_name);
+            mz = rte_memzone_lookup(mz_name);
+            if (mz == NULL) {
+                rte_errno = ENOENT;
+                return false;
+            }
+
+            setup(mz->addr);
+            if (m_header->key_value_size != sizeof(key_value_pair_type)) {
+                RTE_LOG(ERR, HASH, "ShareFrozenHashMap::attach %s has another key/value size\n", m_name);
+                rte_errno = EINVAL;
+                m_header = NULL;
+                return false;
+            }
+            return true;
+        }
+
+        // get the index of a key, return -ENOENT if it isn't in the table
+        int32_t find(const key_type & __key) {
+            if (unlikely(m_header->num_entries == 0))
+                return -ENOENT;
+
+            uint64_t raw = m_hash_func(__key);
+            uint32_t index = slot_with_hash(raw);
+            if (m_entries[index].k == __key)
+                return index;
+            if (unlikely(m_header->num_overflow != 0))
+                return find_overflow(__key, raw);
+            return -ENOENT;
+        }
+
+        void get_entry_with_index(const key_value_pair_type *& ret, uint32_t index) {
+            ret = &m_entries[index];
+        }
+
+        uint32_t size(void) {
+            return m_header->num_entries + m_header->num_overflow;
+        }
+
+        // keys kept out of the perfect hash, their hasher value was taken
+        uint32_t overflow_size(void) {
+            return m_header->num_overflow;
+        }
+
+        // bytes used by the memzone
+        uint64_t memory_size(void) {
+            return (uint64_t)m_header->overflow_offset + (uint64_t)m_header->num_overflow * sizeof(uint64_t);
+        }
+
+    private:
+        template<typename _KeyValue>
+        struct collector {
+            std::vector<_KeyValue> pairs;
+            void operator() (const _KeyValue * __kv, uint32_t) {
+                pairs.push_back(*__kv);
+            }
+        };
+
+        static inline uint64_t mix(uint64_t x) {
+            x ^= x >> 33;
+            x *= 0xff51afd7ed558ccdULL;
+            x ^= x >> 33;
+            x *= 0xc4ceb9fe1a85ec53ULL;
+            x ^= x >> 33;
+            return x;
+        }
+
+        /* Maps a 32 bits value to [0, n) without a division */
+        static inline uint32_t reduce(uint32_t x, uint32_t n) {
+            return ((uint64_t)x * n) >> 32;
+        }
+
+        /* The seeded hash of a hasher value; equal hasher values collide under every seed */
+        static inline uint64_t key_hash(uint64_t raw, uint32_t seed) {
+            return mix(raw ^ ((uint64_t)seed << 32 | seed));
+        }
+
+        static inline uint32_t bucket_of(uint64_t h, uint32_t num_buckets) {
+            return reduce(h >> 32, num_buckets);
+        }
+
+        static inline uint32_t slot_of(uint64_t h, uint32_t disp, uint32_t num_entries) {
+            return reduce(mix(h + disp * 0x9e3779b97f4a7c15ULL) >> 32, num_entries);
+        }
+
+        inline uint32_t slot_with_hash(uint64_t raw) {
+            uint64_t h = key_hash(raw, m_header->seed);
+            return slot_of(h, m_disp[bucket_of(h, m_header->num_buckets)], m_header->num_entries);
+        }
+
+        inline uint32_t slot(const key_type & __key) {
+            return slot_with_hash(m_hash_func(__key));
+        }
+
+        /* Binary search of the hash in the overflow run, then its keys */
+        int32_t find_overflow(const key_type & __key, uint64_t raw) {
+            const uint64_t * first = std::lower_bound(m_overflow, m_overflow + m_header->num_overflow, raw);
+
+            for (; first != m_overflow + m_header->num_overflow && *first == raw; ++first) {
+                uint32_t index = m_header->num_entries + (first - m_overflow);
+                if (m_entries[index].k == __key)
+                    return index;
+            }
+            return -ENOENT;
+        }
+
+        template<typename _KeyValue>
+        struct hash_less {
+            const _KeyValue * pairs;
+            hasher          & hash_func;
+            hash_less(const _KeyValue * p, hasher & h) : pairs(p), hash_func(h) {}
+            bool operator() (uint32_t a, uint32_t b) const {
+                return (uint64_t)hash_func(pairs[a].k) < (uint64_t)hash_func(pairs[b].k);
+            }
+        };
+
+        struct bucket_size_greater {
+            const std::vector< std::vector<uint32_t> > & members;
+            bucket_size_greater(const std::vector< std::vector<uint32_t> > & m) : members(m) {}
+            bool operator() (uint32_t a, uint32_t b) const {
+                return members[a].size() > members[b].size();
+            }
+        };
+
+        /*
+         * Find a displacement for every bucket, the largest buckets first.
+         * order gets the index of every distinct key in __pairs to place,
+         * overflow those whose hash is taken by a key placed.
+         */
+        template<typename _KeyValue>
+        bool place(const _KeyValue * __pairs, uint32_t __count, uint32_t num_buckets, uint32_t seed,
+                   std::vector<uint32_t> & disp, std::vector<uint32_t> & order,
+                   std::vector<uint32_t> & overflow) {
+            std::vector< std::vector<uint32_t> > members(num_buckets);
+            std::vector<uint64_t> hashes(__count);
+            std::vector<uint32_t> buckets(num_buckets);
+            uint32_t i, j, b, n = 0;
+
+            overflow.clear();
+            for (i = 0; i < __count; ++i) {
+                hashes[i] = key_hash(m_hash_func(__pairs[i].k), seed);
+                b = bucket_of(hashes[i], num_buckets);
+
+                /* drop duplicated keys, another key of the same hash overflows */
+                bool dup = false;
+                for (j = 0; j < members[b].size() && !dup; ++j) {
+                    if (hashes[members[b][j]] != hashes[i])
+                        continue;
+                    dup = __pairs[members[b][j]].k == __pairs[i].k;
+                    for (uint32_t o = 0; o < overflow.size() && !dup; ++o)
+                        dup = __pairs[overflow[o]].k == __pairs[i].k;
+                    if (!dup)
+                        overflow.push_back(i);
+                    dup = true;
+                }
+                if (!dup) {
+                    members[b].push_back(i);
+                    ++n;
+                }
+            }
+
+            for (b = 0; b < num_buckets; ++b)
+                buckets[b] = b;
+            std::sort(buckets.begin(), buckets.end(), bucket_size_greater(members));
+
+            std::vector<uint8_t> taken(n, 0);
+            std::vector<uint32_t> slots;
+            disp.assign(num_buckets, 0);
+            order.clear();
+
+            for (i = 0; i < num_buckets && !members[buckets[i]].empty(); ++i) {
+                const std::vector<uint32_t> & keys = members[buckets[i]];
+                uint32_t d;
+
+                for (d = 0; d < MAX_DISPLACEMENT; ++d) {
+                    slots.clear();
+                    for (j = 0; j < keys.size(); ++j) {
+                        uint32_t s = slot_of(hashes[keys[j]], d, n);
+                        if (taken[s] || std::find(slots.begin(), slots.end(), s) != slots.end())
+                            break;
+                        slots.push_back(s);
+                    }
+                    if (j == keys.size())
+                        break;
+                }
+                if (d == MAX_DISPLACEMENT)
+                    return false;
+
+                disp[buckets[i]] = d;
+                for (j = 0; j < keys.size(); ++j) {
+                    taken[slots[j]] = 1;
+                    order.push_back(keys[j]);
+                }
+            }
+
+            return true;
+        }
+
+        bool reserve(uint32_t num_entries, uint32_t num_overflow, uint32_t num_buckets) {
+            char mz_name[RTE_MEMZONE_NAMESIZE];
+            const struct rte_memzone *mz;
+            uint32_t disp_offset = sizeof(share_frozen_header);
+            uint32_t entry_offset = RTE_ALIGN(disp_offset + num_buckets * sizeof(uint32_t), CACHE_LINE_SIZE);
+            uint32_t overflow_offset = RTE_ALIGN(entry_offset +
+                    (num_entries + num_overflow) * sizeof(key_value_pair_type), sizeof(uint64_t));
+
+            rte_snprintf(mz_name, sizeof(mz_name), "FZ_%s", m_name);
+            mz = rte_memzone_reserve(mz_name,
+                    overflow_offset + (size_t)num_overflow * sizeof(uint64_t),
+                    SOCKET_ID_ANY, 0);
+            if (mz == NULL) {
+                RTE_LOG(ERR, HASH, "ShareFrozenHashMap::build memzone %s reserve failed\n", mz_name);
+                return false;
+            }
+
+            share_frozen_header * header = static_cast<share_frozen_header *>(mz->addr);
+            header->num_entries = num_entries;
+            header->num_buckets = num_buckets;
+            header->key_value_size = sizeof(key_value_pair_type);
+            header->disp_offset = disp_offset;
+            header->entry_offset = entry_offset;
+            header->num_overflow = num_overflow;
+            header->overflow_offset = overflow_offset;
+            setup(mz->addr);
+            return true;
+        }
+
+        void setup(void * __addr) {
+            m_header = static_cast<share_frozen_header *>(__addr);
+            m_disp = (uint32_t *)((uint8_t *)__addr + m_header->disp_offset);
+            m_entries = (key_value_pair_type *)(void *)((uint8_t *)__addr + m_header->entry_offset);
+            m_overflow = (uint64_t *)(void *)((uint8_t *)__addr + m_header->overflow_offset);
+        }
+
+    private:
+        const char           * m_name;
+        share_frozen_header  * m_header;
+        uint32_t             * m_disp;
+        key_value_pair_type  * m_entries;
+        uint64_t             * m_overflow;
+        hasher                 m_hash_func;
+};
+
+#endif
@@ -32,9 +32,14 @@
 #include <stdio.h>
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <new>
 
 #include <errno.h>
 #include <rte_errno.h>
+#include <rte_log.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
 /* Hash function used if none is specified */
 #ifdef RTE_MACHINE_CPUFLAG_SSE4_2
 #include <rte_hash_crc.h>
@@ -46,15 +51,30 @@
 
 #include "hash_func.h"
 #include "share_rte_hash.h"
+#include "share_qsbr.h"
+#include "share_trace.h"
 #include "exception.h"
 
 using namespace std;
 
+template <class _Key, class _Value>
+struct ShareKeyValuePair {
+    _Key   k;
+    _Value v;
+};
+
 // Forward declaration
-template <class _Key, class _Value, class _HashFunc = sharehash::hash<_Key> >
+template <class _Key, class _Value, class _HashFunc = sharehash::hash<_Key>,
+          class _Geometry = share_runtime_geometry>
 class ShareHashMap;
 
-template <class _Key, class _Value, class _HashFunc>
+template <class _Map, uint32_t _MaxKeys> class ShareHashTransaction;
+
+/*
+ * _Geometry tells the engine how the buckets are laid out, see
+ * share_runtime_geometry and share_fixed_geometry in share_rte_hash.h.
+ */
+template <class _Key, class _Value, class _HashFunc, class _Geometry>
 class ShareHashMap {
     public:
         static const int DEFAULT_BUCKET_ENTRIES = 128;
@@ -64,23 +84,29 @@ class ShareHashMap {
         typedef _Key key_type;
         typedef _Value value_type;
         typedef _HashFunc hasher;
+        typedef _Geometry geometry_type;
         
-        typedef struct KeyValuePair {
-            key_type   k;
-            value_type v;
-        } key_value_pair_type; 
+        typedef ShareKeyValuePair<key_type, value_type> key_value_pair_type; 
+        typedef share_rte_hash_handle handle_type;
+
+    private:
+        /* Entries are copied with memcpy and read by other processes */
+        typedef char key_must_be_trivially_copyable[sharehash::shareable<_Key>::value ? 1 : -1];
+        typedef char value_must_be_trivially_copyable[sharehash::shareable<_Value>::value ? 1 : -1];
 
     public:
-        ShareHashMap(const char * __name) {
+        ShareHashMap(const char * __name, uint32_t __entries = DEFAULT_TOTAL_ENTRIES,
+                     uint32_t __bucket_entries = DEFAULT_BUCKET_ENTRIES, int __socket_id = 0) {
             m_hash_params.name = __name;
-            m_hash_params.entries = DEFAULT_TOTAL_ENTRIES;
-            m_hash_params.bucket_entries = DEFAULT_BUCKET_ENTRIES;
+            m_hash_params.entries = __entries;
+            m_hash_params.bucket_entries = __bucket_entries;
             m_hash_params.key_len = sizeof(key_value_pair_type);
             m_hash_params.hash_func = NULL;
             m_hash_params.hash_func_init_val = 0;
-            m_hash_params.socket_id = 0; 
+            m_hash_params.socket_id = __socket_id; 
         
             m_rte_hash = NULL;
+            m_trace_id = sharehash::hash<const char*>()(__name);
         }
 
         ~ShareHashMap(void) {
@@ -89,117 +115,479 @@ class ShareHashMap {
         }
 
         // create a hashmap, used by primary process
-        bool create(void) {
-            m_rte_hash = ShareRteHash::instance().create_hash_table(&m_hash_params); 
+        // __flags is a combination of ShareRteHash::k_FLAG_*
+        bool create(uint32_t __flags = 0) {
+            bool created;
+
+            m_rte_hash = ShareRteHash::instance().create_hash_table(&m_hash_params, __flags,
+                                                                    type_fingerprint(), &created);
             
             if (m_rte_hash)
-                return true;
+                return check_geometry(created);
             else
                 return false;
         }
 
         // attach to an existing hashmap, used by secondary process
-        bool attach(void) {
-            m_rte_hash = ShareRteHash::instance().attach_hash_table(m_hash_params.name); 
+        // fails if it was created with other key/value types, see type_fingerprint
+        // __prefault touches every page of the table now rather than on first access
+        bool attach(bool __prefault = false) {
+            m_rte_hash = ShareRteHash::instance().attach_hash_table(m_hash_params.name, type_fingerprint()); 
             
-            if (m_rte_hash)
-                return true;
-            else
+            if (m_rte_hash == NULL || !check_geometry(false))
                 return false;
+            if (__prefault)
+                ShareRteHash::instance().prefault_hash_table(m_rte_hash);
+            return true;
         }
 
         // get value by index
         void get_entry_with_index(key_value_pair_type *& ret, uint32_t index) {
-            ShareRteHash::instance().get_value_with_index(ret, m_rte_hash, index);
+            ShareRteHash::instance().get_value_with_index<geometry_type>(ret, m_rte_hash, index);
+        }
+
+        // call __visit(const key_value_pair_type *, uint32_t index) for every entry
+        template<typename _Visitor>
+        void for_each(_Visitor & __visit) {
+            for (uint32_t i = 0; i < m_rte_hash->num_buckets; ++i)
+                ShareRteHash::instance().walk_bucket<geometry_type, key_value_pair_type>(m_rte_hash, i, __visit);
+        }
+
+        /*
+         * Fold every entry into __result, in parallel. The buckets are split
+         * between this lcore and the slave lcores which are idle (WAIT),
+         * launched with rte_eal_remote_launch. Each part starts from a copy
+         * of __init and of __fold, called as
+         * __fold(_Result &, const key_value_pair_type &), then the partial
+         * results are combined in part order with
+         * __merge(_Result &, const _Result &).
+         *
+         * Like rte_eal_remote_launch, it must be called on the master
+         * lcore; elsewhere it returns -EPERM and leaves __result alone.
+         * Returns the number of parts otherwise.
+         *
+         *   uint64_t bytes;
+         *   map.reduce(bytes, uint64_t(0), add_bytes(), sum());
+         */
+        template<typename _Result, typename _Fold, typename _Merge>
+        int32_t reduce(_Result & __result, const _Result & __init, const _Fold & __fold, const _Merge & __merge) {
+            typedef reduce_job<_Result, _Fold> job_type;
+            uint32_t parts = 1, part;
+            unsigned lcore;
+
+            if (rte_lcore_id() != rte_get_master_lcore())
+                return -EPERM;
+
+            RTE_LCORE_FOREACH_SLAVE(lcore) {
+                if (rte_eal_get_lcore_state(lcore) == WAIT)
+                    ++parts;
+            }
+
+            std::vector<job_type> jobs(parts, job_type(this, parts, __init, __fold));
+            part = 0;
+            RTE_LCORE_FOREACH_SLAVE(lcore) {
+                if (part + 1 == parts)
+                    break;
+                if (rte_eal_get_lcore_state(lcore) != WAIT)
+                    continue;
+                ++part;
+                jobs[part].part = part;
+                if (rte_eal_remote_launch(job_type::run, &jobs[part], lcore) == 0)
+                    jobs[part].lcore = lcore;
+            }
+
+            /* Parts whose launch failed are folded here too */
+            for (part = 0; part < parts; ++part)
+                if (jobs[part].lcore == RTE_MAX_LCORE)
+                    job_type::run(&jobs[part]);
+
+            __result = jobs[0].result;
+            for (part = 1; part < parts; ++part) {
+                if (jobs[part].lcore != RTE_MAX_LCORE)
+                    rte_eal_wait_lcore(jobs[part].lcore);
+                __merge(__result, jobs[part].result);
+            }
+            return parts;
+        }
+
+        // count the entries for which __pred(const key_value_pair_type &) is true, see reduce
+        template<typename _Predicate>
+        int32_t count_if(uint64_t & __count, const _Predicate & __pred) {
+            return reduce(__count, uint64_t(0), count_fold<_Predicate>(__pred), count_merge());
+        }
+
+        /*
+         * Identifies the layout of the key/value pairs: the size and the
+         * alignment of the key and of the value. Maps which only differ in
+         * their geometry policy share a table, check_geometry checks the
+         * geometry itself. The hasher isn't part of it, every process of a
+         * table must hash the keys the same way.
+         */
+        static uint64_t type_fingerprint(void) {
+            return (uint64_t)sizeof(key_type) << 40 | (uint64_t)__alignof__(key_type) << 32 |
+                   (uint64_t)sizeof(value_type) << 8 | __alignof__(value_type);
+        }
+
+        // get the signature of a key, for the *_with_hash functions
+        hash_sig_t hash(const key_type& __key) {
+            return m_hash_func(__key);
         }
 
         // insert a <key, value> pair to hash table
         int32_t insert(const key_type& __key, const value_type& __value) {
+            return insert_with_hash(__key, __value, m_hash_func(__key));
+        }
+
+        int32_t insert_with_hash(const key_type& __key, const value_type& __value, hash_sig_t signature) {
             key_value_pair_type key_value_pair = {__key, __value};
-            hash_sig_t signature = m_hash_func(__key);
-            int32_t position = ShareRteHash::instance().add_key_value_with_hash(m_rte_hash, &key_value_pair, signature);
-        
-#ifdef DEBUG
-            cout << " ... ... insert key : " << __key
-                 << " signature : " << signature
-                 << " to position " << position << endl;
-#endif
+            int32_t position = ShareRteHash::instance().add_key_value_with_hash<geometry_type>(m_rte_hash, &key_value_pair, signature);
         
+            SHARE_TRACE_MUTATION(SHARE_TRACE_INSERT, m_trace_id, signature, position);
             return position;
         }
 
+        /*
+         * Insert a key whose value is built directly in its slot by
+         * __init(value_type &), under the bucket lock, so the value isn't
+         * copied. __init must set the whole value, the slot may hold an old
+         * one. Returns like insert, __init isn't called if the key exists.
+         */
+        template<typename _Initializer>
+        int32_t insert_with(const key_type & __key, _Initializer & __init) {
+            return insert_with(__key, __init, m_hash_func(__key));
+        }
+
+        template<typename _Initializer>
+        int32_t insert_with(const key_type & __key, _Initializer & __init, hash_sig_t signature) {
+            int32_t position = ShareRteHash::instance().add_key_in_place_with_hash<geometry_type, key_value_pair_type>(
+                    m_rte_hash, __key, signature, __init);
+
+            SHARE_TRACE_MUTATION(SHARE_TRACE_INSERT, m_trace_id, signature, position);
+            return position;
+        }
+
+        // insert a key whose value is constructed in place from the arguments
+        int32_t emplace(const key_type & __key) {
+            emplace_init0 init;
+            return insert_with(__key, init);
+        }
+
+        template<typename _A1>
+        int32_t emplace(const key_type & __key, const _A1 & __a1) {
+            emplace_init1<_A1> init(__a1);
+            return insert_with(__key, init);
+        }
+
+        template<typename _A1, typename _A2>
+        int32_t emplace(const key_type & __key, const _A1 & __a1, const _A2 & __a2) {
+            emplace_init2<_A1, _A2> init(__a1, __a2);
+            return insert_with(__key, init);
+        }
+
+        template<typename _A1, typename _A2, typename _A3>
+        int32_t emplace(const key_type & __key, const _A1 & __a1, const _A2 & __a2, const _A3 & __a3) {
+            emplace_init3<_A1, _A2, _A3> init(__a1, __a2, __a3);
+            return insert_with(__key, init);
+        }
+
         // update a <key, value> pair in hash table
         template<typename _Modifier>
         bool update_value(const key_type& __key, const value_type& __new_value, const _Modifier& update) {
+            return update_value_with_hash(__key, __new_value, m_hash_func(__key), update);
+        }
+
+        template<typename _Modifier>
+        bool update_value_with_hash(const key_type& __key, const value_type& __new_value,
+                                    hash_sig_t signature, const _Modifier& update) {
             key_value_pair_type key_value_pair = {__key, __new_value};
-            hash_sig_t signature = m_hash_func(__key);
-            return ShareRteHash::instance().update_value_with_hash(m_rte_hash, &key_value_pair, signature, update);
+            bool updated = ShareRteHash::instance().update_value_with_hash<geometry_type>(m_rte_hash, &key_value_pair, signature, update);
+
+            SHARE_TRACE_MUTATION(SHARE_TRACE_UPDATE, m_trace_id, signature, updated);
+            return updated;
         }
 
         // get the index of a key in hash table
         // return a negative number if fail
         int32_t find(const key_type& __key) {
+            return find_with_hash(__key, m_hash_func(__key));
+        }
+
+        int32_t find_with_hash(const key_type& __key, hash_sig_t signature) {
             key_value_pair_type key_value_pair;
             key_value_pair.k = __key;
-            hash_sig_t signature = m_hash_func(__key);
-            int32_t position = ShareRteHash::instance().lookup_with_hash(m_rte_hash, &key_value_pair, signature);
+            int32_t position = ShareRteHash::instance().lookup_with_hash<geometry_type>(m_rte_hash, &key_value_pair, signature);
         
-            if (position == EINVAL) {
-                cout << " ... ... Invalid parameters!" << endl;
-            } else if (position == ENOENT) {
-                cout << " ... ... Can't find this key!" << endl;
-            } else {
-#ifdef DEBUG
-                cout << " ... ... Lookup key : " << __key
-                     << " signature : " << signature
-                     << " to position " << position << endl;
-#endif
-            }
-    
+            SHARE_TRACE_LOOKUP(SHARE_TRACE_FIND, m_trace_id, signature, position);
             return position;
         }
 
-        int32_t erase(const key_type & __key) {
+        /*
+         * find for a reader registered with __qsbr, without the bucket read
+         * lock whatever the flags. An entry erased with erase(key, qsbr)
+         * keeps its slot until this reader reports a quiescent state, so
+         * the position stays usable until then.
+         */
+        int32_t find(const key_type& __key, const ShareQsbr & __qsbr) {
             key_value_pair_type key_value_pair;
             key_value_pair.k = __key;
             hash_sig_t signature = m_hash_func(__key);
-            int32_t position = ShareRteHash::instance().del_key_value_with_hash(m_rte_hash, &key_value_pair, signature);
-        
-#ifdef DEBUG
-            cout << " ... ... Erase key : " << __key
-                 << " signature : " << signature
-                 << " to position " << position << endl;
-#endif
+            int32_t position = ShareRteHash::instance().lookup_lockless_with_hash<geometry_type>(m_rte_hash,
+                    &key_value_pair, signature);
+
+            (void)__qsbr;
+            SHARE_TRACE_LOOKUP(SHARE_TRACE_FIND, m_trace_id, signature, position);
+            return position;
+        }
+
+        /*
+         * Find a key and get a handle of its entry, in a map created with
+         * ShareRteHash::k_FLAG_GENERATIONS. The handle gives the entry again
+         * without hashing, until the entry is erased.
+         */
+        int32_t find(const key_type& __key, handle_type & __handle) {
+            return find_with_hash(__key, m_hash_func(__key), __handle);
+        }
+
+        int32_t find_with_hash(const key_type& __key, hash_sig_t signature, handle_type & __handle) {
+            key_value_pair_type key_value_pair;
+            key_value_pair.k = __key;
+            int32_t position = ShareRteHash::instance().lookup_handle_with_hash<geometry_type>(m_rte_hash,
+                    &key_value_pair, signature, &__handle);
+
+            SHARE_TRACE_LOOKUP(SHARE_TRACE_FIND, m_trace_id, signature, position);
+            return position;
+        }
+
+        // the entry of a handle wasn't erased, false for a handle not of this map
+        bool valid(const handle_type & __handle) {
+            return ShareRteHash::instance().handle_valid(m_rte_hash, __handle);
+        }
+
+        /*
+         * Like get_entry_with_index, false if the entry of the handle was
+         * erased. Unless the caller owns the key, the entry may be erased
+         * while it is read: check valid() afterwards, or use read_entry.
+         */
+        bool get_entry_with_handle(key_value_pair_type *& ret, const handle_type & __handle) {
+            if (!valid(__handle))
+                return false;
+            get_entry_with_index(ret, __handle.index);
+            return true;
+        }
+
+        // copy the entry of a handle, false if it was erased
+        bool read_entry(const handle_type & __handle, key_value_pair_type & __kv) {
+            return ShareRteHash::instance().read_with_handle<geometry_type>(m_rte_hash, __handle, &__kv);
+        }
+
+        // the version of the bucket of a signature, it changes with the bucket
+        uint32_t bucket_version(hash_sig_t signature) {
+            return ShareRteHash::instance().bucket_version_with_hash(m_rte_hash, signature);
+        }
+
+        int32_t erase(const key_type & __key) {
+            return erase_with_hash(__key, m_hash_func(__key));
+        }
+
+        int32_t erase_with_hash(const key_type & __key, hash_sig_t signature) {
+            key_value_pair_type key_value_pair;
+            key_value_pair.k = __key;
+            int32_t position = ShareRteHash::instance().del_key_value_with_hash<geometry_type>(m_rte_hash, &key_value_pair, signature);
         
+            SHARE_TRACE_MUTATION(SHARE_TRACE_ERASE, m_trace_id, signature, position);
+            return position;
+        }
+
+        /*
+         * Bulk insert, update_value and erase for bursts, e.g. the packets
+         * of an rx burst. The keys are grouped by bucket and every bucket
+         * is locked once for its group. __results[i] is what the single key
+         * function returns for key i. They return how many keys were
+         * inserted (or found), updated or erased.
+         */
+        uint32_t insert_bulk(const key_type * __keys, const value_type * __values, uint32_t __n,
+                             int32_t * __results) {
+            key_value_pair_type key_values[ShareRteHash::k_BULK_MAX];
+            hash_sig_t signatures[ShareRteHash::k_BULK_MAX];
+            uint32_t i, m, done = 0;
+
+            for (; __n > 0; __n -= m, __keys += m, __values += m, __results += m) {
+                m = __n < ShareRteHash::k_BULK_MAX ? __n : ShareRteHash::k_BULK_MAX;
+                for (i = 0; i < m; ++i) {
+                    key_values[i].k = __keys[i];
+                    key_values[i].v = __values[i];
+                    signatures[i] = m_hash_func(__keys[i]);
+                }
+
+                ShareRteHash::instance().add_key_value_bulk<geometry_type>(m_rte_hash, key_values, signatures,
+                                                                           m, __results);
+                for (i = 0; i < m; ++i) {
+                    SHARE_TRACE_MUTATION(SHARE_TRACE_INSERT, m_trace_id, signatures[i], __results[i]);
+                    done += __results[i] >= 0;
+                }
+            }
+            return done;
+        }
+
+        template<typename _Modifier>
+        uint32_t update_value_bulk(const key_type * __keys, const value_type * __new_values, uint32_t __n,
+                                   const _Modifier & __update, bool * __results) {
+            key_value_pair_type key_values[ShareRteHash::k_BULK_MAX];
+            hash_sig_t signatures[ShareRteHash::k_BULK_MAX];
+            uint32_t i, m, done = 0;
+
+            for (; __n > 0; __n -= m, __keys += m, __new_values += m, __results += m) {
+                m = __n < ShareRteHash::k_BULK_MAX ? __n : ShareRteHash::k_BULK_MAX;
+                for (i = 0; i < m; ++i) {
+                    key_values[i].k = __keys[i];
+                    key_values[i].v = __new_values[i];
+                    signatures[i] = m_hash_func(__keys[i]);
+                }
+
+                ShareRteHash::instance().update_value_bulk<geometry_type>(m_rte_hash, key_values, signatures,
+                                                                          m, __update, __results);
+                for (i = 0; i < m; ++i) {
+                    SHARE_TRACE_MUTATION(SHARE_TRACE_UPDATE, m_trace_id, signatures[i], __results[i]);
+                    done += __results[i];
+                }
+            }
+            return done;
+        }
+
+        uint32_t erase_bulk(const key_type * __keys, uint32_t __n, int32_t * __results) {
+            key_value_pair_type key_values[ShareRteHash::k_BULK_MAX];
+            hash_sig_t signatures[ShareRteHash::k_BULK_MAX];
+            uint32_t i, m, done = 0;
+
+            for (; __n > 0; __n -= m, __keys += m, __results += m) {
+                m = __n < ShareRteHash::k_BULK_MAX ? __n : ShareRteHash::k_BULK_MAX;
+                for (i = 0; i < m; ++i) {
+                    key_values[i].k = __keys[i];
+                    signatures[i] = m_hash_func(__keys[i]);
+                }
+
+                ShareRteHash::instance().del_key_value_bulk<geometry_type>(m_rte_hash, key_values, signatures,
+                                                                           m, __results);
+                for (i = 0; i < m; ++i) {
+                    SHARE_TRACE_MUTATION(SHARE_TRACE_ERASE, m_trace_id, signatures[i], __results[i]);
+                    done += __results[i] >= 0;
+                }
+            }
+            return done;
+        }
+
+        // erase a key, but keep its slot until all readers of qsbr are quiescent
+        int32_t erase(const key_type & __key, ShareQsbr & __qsbr) {
+            key_value_pair_type key_value_pair;
+            key_value_pair.k = __key;
+            hash_sig_t signature = m_hash_func(__key);
+            int32_t position = ShareRteHash::instance().retire_key_value_with_hash<geometry_type>(m_rte_hash, &key_value_pair, signature);
+
+            SHARE_TRACE_MUTATION(SHARE_TRACE_RETIRE, m_trace_id, signature, position);
+            if (position >= 0)
+                __qsbr.defer(reclaim_entry, m_rte_hash, position);
+
             return position;
         }
         
         
-#define NULL_SIGNATURE 0
+        /*
+         * Remove every entry, return how many were removed. The buckets
+         * can be split between lcores: each calls clear(i, n) with its own
+         * part i of n. With k_FLAG_SINGLE_WRITER only the writer may call it.
+         */
+        uint32_t clear(uint32_t __part = 0, uint32_t __parts = 1) {
+            uint32_t first, last, n = 0;
+
+            bucket_range(__part, __parts, first, last);
+            for (uint32_t i = first; i < last; ++i)
+                n += ShareRteHash::instance().clear_bucket<geometry_type>(m_rte_hash, i);
+            return n;
+        }
+
+        // remove every entry for which __pred(const key_value_pair_type &) is true
+        template<typename _Predicate>
+        uint32_t erase_if(_Predicate & __pred, uint32_t __part = 0, uint32_t __parts = 1) {
+            uint32_t first, last, n = 0;
+
+            bucket_range(__part, __parts, first, last);
+            for (uint32_t i = first; i < last; ++i)
+                n += ShareRteHash::instance().erase_bucket_if<geometry_type, key_value_pair_type>(m_rte_hash, i, __pred);
+            return n;
+        }
+
+        /*
+         * Recount the negative lookup filter of a table created with
+         * ShareRteHash::k_FLAG_FILTER, so that the counters saturated by
+         * many inserts and erases in the same place work again. Lookups and
+         * updates go on meanwhile. The buckets can be split like clear().
+         */
+        void rebuild_filter(uint32_t __part = 0, uint32_t __parts = 1) {
+            uint32_t first, last;
+
+            bucket_range(__part, __parts, first, last);
+            for (uint32_t i = first; i < last; ++i)
+                ShareRteHash::instance().rebuild_filter_bucket(m_rte_hash, i);
+        }
+
+        /*
+         * Append the buckets modified since the last checkpoint to the file
+         * at __path, or all of them if __full. Incremental checkpoints need
+         * a table created with ShareRteHash::k_FLAG_DIRTY_TRACKING. Returns
+         * the number of buckets written or a negative errno.
+         */
+        int checkpoint(const char * __path, bool __full = false) {
+            return ShareRteHash::instance().checkpoint_table(m_rte_hash, __path, __full);
+        }
+
+        // replay a checkpoint file, into a table just created normally
+        int restore(const char * __path) {
+            return ShareRteHash::instance().restore_table(m_rte_hash, __path);
+        }
+
+        // merge the segments of a checkpoint file into a new file
+        static int compact_checkpoint(const char * __in_path, const char * __out_path) {
+            return ShareRteHash::compact_checkpoint(__in_path, __out_path);
+        }
+
+        /*
+         * Log every change to a ring of __records records, a power of 2,
+         * see ShareChangeLogReader. Used by primary process after create.
+         */
+        bool create_changelog(uint32_t __records) {
+            int ret = ShareRteHash::instance().enable_changelog(m_rte_hash, __records);
+
+            if (ret < 0) {
+                rte_errno = -ret;
+                return false;
+            }
+            return true;
+        }
+
+        // sequence number of the next change, 0 without a change log
+        uint64_t changelog_head(void) {
+            return ShareRteHash::instance().changelog_head(m_rte_hash);
+        }
+
+        // see ShareRteHash::read_change
+        int read_change(uint64_t __seq, share_rte_hash_change & __change, key_value_pair_type & __kv) {
+            return ShareRteHash::instance().read_change(m_rte_hash, __seq, &__change, &__kv);
+        }
+
+        // bytes used by the table, see share_rte_hash_footprint
+        void footprint(share_rte_hash_footprint & __fp) {
+            ShareRteHash::instance().get_footprint(m_rte_hash, &__fp);
+        }
+
         int32_t free_entry_count(void)
         {
-            int32_t count = 0;
-            const uint32_t * sig_tbl = (const uint32_t *)m_rte_hash->sig_tbl;
-        
-            for (uint32_t i = 0; i < m_rte_hash->entries; ++i)
-                if (sig_tbl[i] == NULL_SIGNATURE)
-                    ++count;
-        
-            return count;
+            return m_rte_hash->entries - used_entry_count();
         }
         
         int32_t used_entry_count(void)
         {
-            int32_t count = 0;
-            const uint32_t * sig_tbl = (const uint32_t *)m_rte_hash->sig_tbl;
-        
-            for (uint32_t i = 0; i < m_rte_hash->entries; ++i)
-                if (sig_tbl[i] != NULL_SIGNATURE)
-                    ++count;
-        
-            return count;
+            return ShareRteHash::instance().entry_count(m_rte_hash);
         }
-#undef NULL_SIGNATURE
         
         void str(ostream & __log) {
             if (!m_rte_hash) {
@@ -215,6 +603,20 @@ class ShareHashMap {
             __log << "used entries  : " << used_entry_count() << endl;
             __log << "free entries  : " << free_entry_count() << endl;
 
+            share_rte_hash_footprint fp;
+            footprint(fp);
+            __log << "slot bytes    : " << fp.slot_bytes << endl;
+            __log << "memory bytes  : " << fp.total_bytes
+                  << " (HT_ " << fp.ht_bytes << ", SIG_ " << fp.sig_bytes
+                  << ", locks " << fp.lock_bytes << ", versions " << fp.version_bytes
+                  << ", filter " << fp.filter_bytes << ", dirty " << fp.dirty_bytes
+                  << ", generations " << fp.generation_bytes
+                  << ", KV_ " << fp.kv_bytes << ", CL_ " << fp.log_bytes << ")" << endl;
+            if (fp.segments)
+                __log << "segments      : " << fp.segments << " (table " << fp.segment_bytes << " bytes)" << endl;
+            __log << "bytes/entry   : " << fp.bytes_per_entry << endl;
+            __log << "overhead      : " << fp.overhead_ratio << endl;
+
             // for debug
             __log << endl;
             __log << "---------- Debug Information -----------" << endl;
@@ -232,9 +634,130 @@ class ShareHashMap {
         }
 
     private:
+        /* A part of reduce, run by one lcore */
+        template<typename _Result, typename _Fold>
+        struct reduce_job {
+            ShareHashMap * map;
+            uint32_t       part;
+            uint32_t       parts;
+            unsigned       lcore;       /* RTE_MAX_LCORE when run by the caller */
+            _Result        result;
+            _Fold          fold;
+
+            reduce_job(ShareHashMap * __map, uint32_t __parts, const _Result & __init, const _Fold & __fold)
+                : map(__map), part(0), parts(__parts), lcore(RTE_MAX_LCORE), result(__init), fold(__fold) {}
+
+            void operator()(const key_value_pair_type * __kv) { fold(result, *__kv); }
+
+            static int run(void * __arg) {
+                reduce_job * job = static_cast<reduce_job *>(__arg);
+                uint32_t first, last;
+
+                job->map->bucket_range(job->part, job->parts, first, last);
+                ShareRteHash::instance().fold_buckets<geometry_type, key_value_pair_type>(job->map->m_rte_hash,
+                                                                                         first, last, *job);
+                return 0;
+            }
+        };
+
+        template<typename _Predicate>
+        struct count_fold {
+            _Predicate pred;
+            count_fold(const _Predicate & __pred) : pred(__pred) {}
+            void operator()(uint64_t & __n, const key_value_pair_type & __kv) { if (pred(__kv)) ++__n; }
+        };
+
+        struct count_merge {
+            void operator()(uint64_t & __n, const uint64_t & __m) const { __n += __m; }
+        };
+
+        /* Initializers of emplace, they construct the value with placement new */
+        struct emplace_init0 {
+            void operator()(value_type & __v) { new (&__v) value_type(); }
+        };
+
+        template<typename _A1>
+        struct emplace_init1 {
+            const _A1 & a1;
+            emplace_init1(const _A1 & __a1) : a1(__a1) {}
+            void operator()(value_type & __v) { new (&__v) value_type(a1); }
+        };
+
+        template<typename _A1, typename _A2>
+        struct emplace_init2 {
+            const _A1 & a1;
+            const _A2 & a2;
+            emplace_init2(const _A1 & __a1, const _A2 & __a2) : a1(__a1), a2(__a2) {}
+            void operator()(value_type & __v) { new (&__v) value_type(a1, a2); }
+        };
+
+        template<typename _A1, typename _A2, typename _A3>
+        struct emplace_init3 {
+            const _A1 & a1;
+            const _A2 & a2;
+            const _A3 & a3;
+            emplace_init3(const _A1 & __a1, const _A2 & __a2, const _A3 & __a3)
+                : a1(__a1), a2(__a2), a3(__a3) {}
+            void operator()(value_type & __v) { new (&__v) value_type(a1, a2, a3); }
+        };
+
+        void bucket_range(uint32_t __part, uint32_t __parts, uint32_t & __first, uint32_t & __last) {
+            uint64_t num_buckets = m_rte_hash->num_buckets;
+
+            __first = num_buckets * __part / __parts;
+            __last = num_buckets * (__part + 1) / __parts;
+        }
+
+        // a table with another layout can't be used with a fixed geometry
+        // a table this map just made is freed; an existing one, shared with others, is left alone
+        bool check_geometry(bool __created) {
+            if (m_rte_hash->key_len != sizeof(key_value_pair_type)) {
+                RTE_LOG(ERR, HASH, "ShareHashMap %s has key/value pairs of %u bytes, not %u\n",
+                        m_hash_params.name, m_rte_hash->key_len, (unsigned)sizeof(key_value_pair_type));
+            } else if (geometry_type::matches(m_rte_hash)) {
+                return true;
+            } else {
+                RTE_LOG(ERR, HASH, "ShareHashMap %s doesn't match the compile-time geometry\n",
+                        m_hash_params.name);
+            }
+            if (__created)
+                ShareRteHash::instance().free_hash_table(m_rte_hash);
+            m_rte_hash = NULL;
+            rte_errno = EINVAL;
+            return false;
+        }
+
+        static void reclaim_entry(void *__hash, uint64_t __index) {
+            ShareRteHash::instance().reclaim_slot(static_cast<rte_hash *>(__hash), __index);
+        }
+
+    private:
+        template <class, uint32_t> friend class ShareHashTransaction;
+
         rte_hash *m_rte_hash;
         hasher    m_hash_func;  // we can't use the hash_fun in rte_hash, because it would be in share memory.
+        uint32_t  m_trace_id;   // identifies this table in trace events
         rte_hash_parameters m_hash_params; 
 };
 
+/*
+ * A ShareHashMap whose bucket geometry is fixed at compile time, so that
+ * the bucket and slot offsets are constants and the bucket scans can be
+ * unrolled. Every process must use the same _BucketEntries and _Packed;
+ * a _Packed map must be created with ShareRteHash::k_FLAG_PACKED.
+ */
+template <class _Key, class _Value, uint32_t _BucketEntries = 128,
+          class _HashFunc = sharehash::hash<_Key>, bool _Packed = false>
+class ShareFixedHashMap
+    : public ShareHashMap<_Key, _Value, _HashFunc,
+                          share_fixed_geometry<_BucketEntries, sizeof(ShareKeyValuePair<_Key, _Value>), _Packed> > {
+    public:
+        typedef ShareHashMap<_Key, _Value, _HashFunc,
+                share_fixed_geometry<_BucketEntries, sizeof(ShareKeyValuePair<_Key, _Value>), _Packed> > base_type;
+
+    public:
+        ShareFixedHashMap(const char * __name, uint32_t __entries = _BucketEntries * 16)
+            : base_type(__name, __entries, _BucketEntries) {}
+};
+
 #endif
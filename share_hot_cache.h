@@ -0,0 +1,163 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * Description:
+ *
+ * A small direct-mapped cache of find() results in front of a ShareHashMap,
+ * one per lcore, for skewed lookups where a few keys take most of the hits.
+ *
+ * An entry keeps the key, its signature, its position and the version of
+ * its bucket when it was found. It is used only while the bucket version
+ * is unchanged, and every write to a bucket, from any process, changes its
+ * version. A hit reads the private cache entry and the bucket version, it
+ * takes no lock and scans no signature.
+ *
+ * An update of the value also changes the version, so it evicts the key
+ * from the caches although its position stays the same.
+ *
+ *   ShareHotKeyCache< ShareHashMap<int, int> > cache(map);
+ *   int32_t position = cache.find(key);
+ */
+
+#ifndef _SHARE_HOT_CACHE_H_
+#define _SHARE_HOT_CACHE_H_
+
+#include <stdint.h>
+
+#include <rte_common.h>
+#include <rte_branch_prediction.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+
+#include "key_traits.h"
+
+template <class _Map, uint32_t _Entries = 256>
+class ShareHotKeyCache {
+    public:
+        typedef typename _Map::key_type key_type;
+        typedef uint32_t hash_sig_t;
+
+        struct entry {
+            hash_sig_t signature;
+            uint32_t   version;     /* 1 when empty, never a stable bucket version */
+            int32_t    position;
+            key_type   key;
+        };
+
+        /* Private to one lcore */
+        struct lcore_cache {
+            entry    entries[_Entries];
+            uint64_t hits;
+            uint64_t misses;
+        } __rte_cache_aligned;
+
+    public:
+        // the caches of the enabled lcores are allocated on their sockets
+        ShareHotKeyCache(_Map & __map) : m_map(__map) {
+            unsigned lcore;
+
+            for (lcore = 0; lcore < RTE_MAX_LCORE; ++lcore)
+                m_caches[lcore] = NULL;
+
+            RTE_LCORE_FOREACH(lcore) {
+                m_caches[lcore] = static_cast<lcore_cache *>(rte_zmalloc_socket(NULL,
+                        sizeof(lcore_cache), CACHE_LINE_SIZE, rte_lcore_to_socket_id(lcore)));
+                if (m_caches[lcore])
+                    flush(m_caches[lcore]);
+            }
+        }
+
+        ~ShareHotKeyCache(void) {
+            for (unsigned lcore = 0; lcore < RTE_MAX_LCORE; ++lcore)
+                rte_free(m_caches[lcore]);
+        }
+
+        // like _Map::find
+        int32_t find(const key_type & __key) {
+            return find_with_hash(__key, m_map.hash(__key));
+        }
+
+        int32_t find_with_hash(const key_type & __key, hash_sig_t __signature) {
+            lcore_cache *cache = local_cache();
+            uint32_t version;
+            int32_t position;
+
+            /* No cache on this lcore, e.g. a thread which isn't an lcore */
+            if (unlikely(cache == NULL))
+                return m_map.find_with_hash(__key, __signature);
+
+            entry & e = cache->entries[__signature & (_Entries - 1)];
+            if (e.signature == __signature && sharehash::key_equal(e.key, __key) &&
+                e.version == m_map.bucket_version(__signature)) {
+                ++cache->hits;
+                return e.position;
+            }
+
+            ++cache->misses;
+
+            /* Keep the result only if the bucket didn't change meanwhile */
+            version = m_map.bucket_version(__signature);
+            position = m_map.find_with_hash(__key, __signature);
+            if (position >= 0 && m_map.bucket_version(__signature) == version) {
+                e.signature = __signature;
+                e.version = version;
+                e.position = position;
+                e.key = __key;
+            }
+            return position;
+        }
+
+        // empty the cache of this lcore
+        void flush(void) {
+            lcore_cache *cache = local_cache();
+
+            if (cache)
+                flush(cache);
+        }
+
+        uint64_t hits(unsigned __lcore) {
+            return __lcore < RTE_MAX_LCORE && m_caches[__lcore] ? m_caches[__lcore]->hits : 0;
+        }
+
+        uint64_t misses(unsigned __lcore) {
+            return __lcore < RTE_MAX_LCORE && m_caches[__lcore] ? m_caches[__lcore]->misses : 0;
+        }
+
+    private:
+        /* NULL on a thread which isn't an lcore, its id is LCORE_ID_ANY */
+        inline lcore_cache * local_cache(void) {
+            unsigned lcore = rte_lcore_id();
+            return lcore < RTE_MAX_LCORE ? m_caches[lcore] : NULL;
+        }
+
+        static void flush(lcore_cache * __cache) {
+            for (uint32_t i = 0; i < _Entries; ++i) {
+                __cache->entries[i].signature = 0;
+                __cache->entries[i].version = 1;
+            }
+        }
+
+    private:
+        /* The entry of a signature is given by its low bits */
+        typedef char entries_must_be_a_power_of_2[(_Entries & (_Entries - 1)) == 0 ? 1 : -1];
+
+        _Map        & m_map;
+        lcore_cache * m_caches[RTE_MAX_LCORE];
+};
+
+#endif
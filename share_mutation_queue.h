@@ -0,0 +1,231 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * Description:
+ *
+ * A mutation queue for a ShareHashMap created with
+ * ShareRteHash::k_FLAG_SINGLE_WRITER. Any lcore of any process queues
+ * insert/erase/update_value commands on a multi-producer rte_ring, and
+ * the one writer lcore applies them in bursts with drain(). Commands are
+ * fixed-size objects from a mempool, so they live in shared memory and
+ * can carry the result back to the producer.
+ *
+ * The writer lcore may also call the map's insert/erase/update_value
+ * directly; no other lcore may.
+ */
+
+#ifndef _SHARE_MUTATION_QUEUE_H_
+#define _SHARE_MUTATION_QUEUE_H_
+
+#include <errno.h>
+#include <rte_common.h>
+#include <rte_atomic.h>
+#include <rte_errno.h>
+#include <rte_lcore.h>
+#include <rte_ring.h>
+#include <rte_mempool.h>
+#include <rte_prefetch.h>
+#include <rte_string_fns.h>
+
+#include "share_hashmap.h"
+
+template <class _Map>
+class ShareMutationQueue {
+    public:
+        static const uint32_t DEFAULT_QUEUE_SIZE = 4096;
+        static const uint32_t DEFAULT_BURST_SIZE = 64;
+
+        enum { OP_INSERT = 1, OP_ERASE, OP_UPDATE };
+
+    public:
+        typedef typename _Map::key_type key_type;
+        typedef typename _Map::value_type value_type;
+        typedef typename _Map::key_value_pair_type key_value_pair_type;
+
+        struct Command {
+            uint32_t            op;
+            uint32_t            want_result;
+            volatile uint32_t   done;
+            volatile int32_t    result;
+            hash_sig_t          signature;
+            key_value_pair_type key_value;
+        };
+
+        // a queued command whose result the producer waits for
+        typedef Command * ticket_type;
+
+    public:
+        ShareMutationQueue(const char * __name, _Map & __map)
+            : m_name(__name), m_map(__map), m_ring(NULL), m_pool(NULL) {}
+
+        // create the ring and the command pool, used by primary process
+        bool create(uint32_t __size = DEFAULT_QUEUE_SIZE, int __socket_id = SOCKET_ID_ANY) {
+            char name[RTE_RING_NAMESIZE];
+
+            rte_snprintf(name, sizeof(name), "MQ_%s", m_name);
+            m_ring = rte_ring_create(name, __size, __socket_id, RING_F_SC_DEQ);
+            if (m_ring == NULL)
+                return false;
+
+            rte_snprintf(name, sizeof(name), "MC_%s", m_name);
+            m_pool = rte_mempool_create(name, __size - 1, sizeof(Command), 0, 0,
+                                        NULL, NULL, NULL, NULL, __socket_id, 0);
+            return m_pool != NULL;
+        }
+
+        // attach to an existing queue, used by secondary process
+        bool attach(void) {
+            char name[RTE_RING_NAMESIZE];
+
+            rte_snprintf(name, sizeof(name), "MQ_%s", m_name);
+            m_ring = rte_ring_lookup(name);
+
+            rte_snprintf(name, sizeof(name), "MC_%s", m_name);
+            m_pool = rte_mempool_lookup(name);
+
+            return m_ring != NULL && m_pool != NULL;
+        }
+
+        /*
+         * Producer side. They return 0 once the command is queued, or
+         * -ENOBUFS if the queue is full. If __ticket is given, the caller
+         * must collect the result with wait() or poll().
+         */
+        int insert(const key_type & __key, const value_type & __value, ticket_type * __ticket = NULL) {
+            return enqueue(OP_INSERT, __key, &__value, __ticket);
+        }
+
+        int erase(const key_type & __key, ticket_type * __ticket = NULL) {
+            return enqueue(OP_ERASE, __key, NULL, __ticket);
+        }
+
+        // the writer applies its own modifier to the stored and the new value
+        int update_value(const key_type & __key, const value_type & __new_value, ticket_type * __ticket = NULL) {
+            return enqueue(OP_UPDATE, __key, &__new_value, __ticket);
+        }
+
+        // get the result if the command has been applied
+        // insert/erase give a position, update_value gives 1 or 0
+        bool poll(ticket_type __ticket, int32_t * __result) {
+            if (!__ticket->done)
+                return false;
+
+            rte_rmb();
+            *__result = __ticket->result;
+            rte_mempool_put(m_pool, __ticket);
+            return true;
+        }
+
+        int32_t wait(ticket_type __ticket) {
+            int32_t result;
+
+            while (!poll(__ticket, &result))
+                rte_pause();
+            return result;
+        }
+
+        /*
+         * Writer side. Apply up to __burst queued commands and return how
+         * many were applied.
+         */
+        template<typename _Modifier>
+        uint32_t drain(const _Modifier & __update, uint32_t __burst = DEFAULT_BURST_SIZE) {
+            Command * cmds[DEFAULT_BURST_SIZE];
+            void    * done[DEFAULT_BURST_SIZE];
+            uint32_t  i, n, n_done = 0;
+
+            if (__burst > DEFAULT_BURST_SIZE)
+                __burst = DEFAULT_BURST_SIZE;
+
+            n = rte_ring_sc_dequeue_burst(m_ring, (void **)cmds, __burst);
+            for (i = 0; i < n; i++)
+                rte_prefetch0(cmds[i]);
+
+            for (i = 0; i < n; i++) {
+                Command * cmd = cmds[i];
+                int32_t result = -EINVAL;
+
+                switch (cmd->op) {
+                    case OP_INSERT:
+                        result = m_map.insert_with_hash(cmd->key_value.k, cmd->key_value.v, cmd->signature);
+                        break;
+                    case OP_ERASE:
+                        result = m_map.erase_with_hash(cmd->key_value.k, cmd->signature);
+                        break;
+                    case OP_UPDATE:
+                        result = m_map.update_value_with_hash(cmd->key_value.k, cmd->key_value.v,
+                                                              cmd->signature, __update);
+                        break;
+                    default:
+                        break;
+                }
+
+                if (cmd->want_result) {
+                    cmd->result = result;
+                    rte_wmb();
+                    cmd->done = 1;
+                } else {
+                    done[n_done++] = cmd;
+                }
+            }
+
+            if (n_done)
+                rte_mempool_put_bulk(m_pool, done, n_done);
+
+            return n;
+        }
+
+        uint32_t count(void) {
+            return rte_ring_count(m_ring);
+        }
+
+    private:
+        int enqueue(uint32_t __op, const key_type & __key, const value_type * __value, ticket_type * __ticket) {
+            void * obj;
+
+            if (rte_mempool_get(m_pool, &obj) < 0)
+                return -ENOBUFS;
+
+            Command * cmd = static_cast<Command *>(obj);
+            cmd->op = __op;
+            cmd->want_result = (__ticket != NULL);
+            cmd->done = 0;
+            cmd->result = 0;
+            cmd->signature = m_map.hash(__key);
+            cmd->key_value.k = __key;
+            if (__value)
+                cmd->key_value.v = *__value;
+
+            if (rte_ring_mp_enqueue(m_ring, cmd) == -ENOBUFS) {
+                rte_mempool_put(m_pool, cmd);
+                return -ENOBUFS;
+            }
+
+            if (__ticket)
+                *__ticket = cmd;
+            return 0;
+        }
+
+    private:
+        const char      * m_name;
+        _Map            & m_map;
+        struct rte_ring * m_ring;
+        rte_mempool     * m_pool;
+};
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_log.h>
+#include <rte_atomic.h>
+#include <rte_memzone.h>
+#include <rte_errno.h>
+#include <rte_string_fns.h>
+
+#include "share_qsbr.h"
+
+bool
+ShareQsbr::create(int socket_id)
+{
+	char mz_name[RTE_MEMZONE_NAMESIZE];
+	const struct rte_memzone *mz;
+
+	rte_snprintf(mz_name, sizeof(mz_name), "QS_%s", m_name);
+	mz = rte_memzone_reserve(mz_name, sizeof(struct share_qsbr), socket_id, 0);
+	if (mz == NULL) {
+		RTE_LOG(ERR, HASH, "ShareQsbr::create memzone %s reserve failed\n", mz_name);
+		return false;
+	}
+
+	m_qsbr = (struct share_qsbr *)mz->addr;
+	memset(m_qsbr, 0, sizeof(*m_qsbr));
+	rte_snprintf(m_qsbr->name, sizeof(m_qsbr->name), "%s", m_name);
+
+	/* Token 0 is reserved for offline readers */
+	rte_atomic64_set(&m_qsbr->token, 1);
+	return true;
+}
+
+bool
+ShareQsbr::attach(void)
+{
+	char mz_name[RTE_MEMZONE_NAMESIZE];
+	const struct rte_memzone *mz;
+
+	rte_snprintf(mz_name, sizeof(mz_name), "QS_%s", m_name);
+	mz = rte_memzone_lookup(mz_name);
+	if (mz == NULL) {
+		rte_errno = ENOENT;
+		return false;
+	}
+
+	m_qsbr = (struct share_qsbr *)mz->addr;
+	return true;
+}
+
+int
+ShareQsbr::register_reader(uint32_t reader_id)
+{
+	uint32_t word = reader_id / SHARE_QSBR_MASK_BITS;
+	uint64_t bit = 1ULL << (reader_id % SHARE_QSBR_MASK_BITS);
+	uint64_t old;
+
+	if (reader_id >= RTE_MAX_LCORE)
+		return -EINVAL;
+
+	m_qsbr->readers[reader_id].cnt = SHARE_QSBR_OFFLINE;
+	do {
+		old = m_qsbr->reg_mask[word];
+		if (old & bit)
+			return -EEXIST;
+	} while (!rte_atomic64_cmpset(&m_qsbr->reg_mask[word], old, old | bit));
+
+	return 0;
+}
+
+int
+ShareQsbr::unregister_reader(uint32_t reader_id)
+{
+	uint32_t word = reader_id / SHARE_QSBR_MASK_BITS;
+	uint64_t bit = 1ULL << (reader_id % SHARE_QSBR_MASK_BITS);
+	uint64_t old;
+
+	if (reader_id >= RTE_MAX_LCORE)
+		return -EINVAL;
+
+	do {
+		old = m_qsbr->reg_mask[word];
+		if (!(old & bit))
+			return -ENOENT;
+	} while (!rte_atomic64_cmpset(&m_qsbr->reg_mask[word], old, old & ~bit));
+
+	m_qsbr->readers[reader_id].cnt = SHARE_QSBR_OFFLINE;
+	return 0;
+}
+
+void
+ShareQsbr::reader_online(uint32_t reader_id)
+{
+	/*
+	 * The counter must be visible before the reader loads any shared
+	 * pointer, otherwise a writer could miss this reader.
+	 */
+	m_qsbr->readers[reader_id].cnt = rte_atomic64_read(&m_qsbr->token);
+	rte_mb();
+}
+
+void
+ShareQsbr::reader_offline(uint32_t reader_id)
+{
+	rte_compiler_barrier();
+	m_qsbr->readers[reader_id].cnt = SHARE_QSBR_OFFLINE;
+}
+
+uint64_t
+ShareQsbr::start(void)
+{
+	/* Readers must see every change made before the new token */
+	rte_mb();
+	return rte_atomic64_add_return(&m_qsbr->token, 1);
+}
+
+bool
+ShareQsbr::check(uint64_t token, bool wait)
+{
+	uint32_t word, id;
+	uint64_t mask, cnt;
+
+	for (word = 0; word < SHARE_QSBR_MASK_WORDS; word++) {
+		mask = m_qsbr->reg_mask[word];
+		while (mask) {
+			id = word * SHARE_QSBR_MASK_BITS + __builtin_ctzll(mask);
+			mask &= mask - 1;
+
+			for (;;) {
+				cnt = m_qsbr->readers[id].cnt;
+				if (cnt == SHARE_QSBR_OFFLINE || cnt >= token)
+					break;
+				if (!wait)
+					return false;
+				rte_pause();
+			}
+		}
+	}
+
+	rte_mb();
+	return true;
+}
+
+void
+ShareQsbr::defer(free_func_t free_fn, void *arg, uint64_t data)
+{
+	deferred_item item;
+
+	item.token   = start();
+	item.free_fn = free_fn;
+	item.arg     = arg;
+	item.data    = data;
+	m_deferred.push_back(item);
+}
+
+uint32_t
+ShareQsbr::reclaim(void)
+{
+	uint32_t count = 0;
+
+	if (m_qsbr == NULL)
+		return 0;
+
+	/* Tokens are increasing, so stop at the first item still in use */
+	while (!m_deferred.empty()) {
+		deferred_item &item = m_deferred.front();
+		if (!check(item.token, false))
+			break;
+		item.free_fn(item.arg, item.data);
+		m_deferred.pop_front();
+		++count;
+	}
+
+	return count;
+}
@@ -0,0 +1,124 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * @ file
+ * @ Quiescent-state based reclamation (QSBR) shared by primary and
+ * @ secondary processes.
+ * @
+ * @ Every reader lcore owns one counter in a shared memzone. A reader
+ * @ copies the global token into its counter whenever it is between two
+ * @ lookups (a quiescent state), so a lookup itself costs nothing. A
+ * @ writer that wants to free something takes a new token and waits until
+ * @ every online reader has reported a counter at least as large as it.
+ * @
+ * @ Deferred items are kept in the writer process, because the callbacks
+ * @ that free them are only meaningful in that process.
+ * @
+ * @ With a ShareHashMap, readers call find(key, qsbr), which checks the
+ * @ bucket version instead of taking the bucket read lock, and writers
+ * @ call erase(key, qsbr), which keeps the slot until a grace period has
+ * @ passed. The plain find still takes the read lock unless the table has
+ * @ lockless readers anyway.
+ */
+
+#ifndef _SHARE_QSBR_H_
+#define _SHARE_QSBR_H_
+
+#include <stdint.h>
+#include <deque>
+
+#include <rte_common.h>
+#include <rte_atomic.h>
+#include <rte_lcore.h>
+#include <rte_memzone.h>
+
+/* Counter value of a reader which is offline */
+#define SHARE_QSBR_OFFLINE   0
+
+#define SHARE_QSBR_NAMESIZE  32
+#define SHARE_QSBR_MASK_BITS 64
+#define SHARE_QSBR_MASK_WORDS \
+    ((RTE_MAX_LCORE + SHARE_QSBR_MASK_BITS - 1) / SHARE_QSBR_MASK_BITS)
+
+struct share_qsbr_reader {
+    volatile uint64_t cnt;
+} __rte_cache_aligned;
+
+/* Layout of the QS_<name> memzone */
+struct share_qsbr {
+    char name[SHARE_QSBR_NAMESIZE];
+    volatile uint64_t reg_mask[SHARE_QSBR_MASK_WORDS];
+    rte_atomic64_t token __rte_cache_aligned;
+    struct share_qsbr_reader readers[RTE_MAX_LCORE];
+};
+
+class ShareQsbr {
+    public:
+        typedef void (*free_func_t)(void *arg, uint64_t data);
+
+    public:
+        ShareQsbr(const char * __name) : m_name(__name), m_qsbr(NULL) {}
+        ~ShareQsbr(void) {}
+
+        // create the shared state, used by primary process
+        bool create(int socket_id = SOCKET_ID_ANY);
+
+        // attach to existing shared state, used by secondary process
+        bool attach(void);
+
+        /*
+         * Reader side. reader_id is normally rte_lcore_id() and must be
+         * unique among all processes which use the same ShareQsbr.
+         */
+        int  register_reader(uint32_t reader_id);
+        int  unregister_reader(uint32_t reader_id);
+        void reader_online(uint32_t reader_id);
+        void reader_offline(uint32_t reader_id);
+
+        // report a quiescent state: no shared data is referenced any more
+        inline void quiescent(uint32_t reader_id) {
+            rte_compiler_barrier();
+            m_qsbr->readers[reader_id].cnt = m_qsbr->token.cnt;
+        }
+
+        /* Writer side */
+        uint64_t start(void);
+        bool     check(uint64_t token, bool wait);
+        void     synchronize(void) { check(start(), true); }
+
+        // free_fn(arg, data) is called once all readers passed a grace period
+        void     defer(free_func_t free_fn, void *arg, uint64_t data);
+
+        // run the deferred callbacks which are safe now, return how many ran
+        uint32_t reclaim(void);
+        uint32_t pending(void) const { return m_deferred.size(); }
+
+    private:
+        struct deferred_item {
+            uint64_t    token;
+            free_func_t free_fn;
+            void       *arg;
+            uint64_t    data;
+        };
+
+        const char                *m_name;
+        struct share_qsbr         *m_qsbr;
+        std::deque<deferred_item>  m_deferred;
+};
+
+#endif
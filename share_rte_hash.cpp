@@ -28,7 +28,9 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <unistd.h>
 #include <sys/queue.h>
+#include <vector>
 
 #include <rte_common.h>
 #include <rte_log.h>
@@ -40,6 +42,8 @@
 #include <rte_tailq.h>
 #include <rte_eal.h>
 #include <rte_eal_memconfig.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
 #include <rte_per_lcore.h>
 #include <rte_errno.h>
 #include <rte_string_fns.h>
@@ -63,11 +67,322 @@ TAILQ_HEAD(rte_hash_list, rte_hash);
 #endif
 
 
+static const char    k_CATALOG_ZONE[] = "SHARE_HASH_CATALOG";
+static const uint32_t k_CATALOG_MAGIC  = 0x54434853;   /* "SHCT" */
+
+static inline struct share_rte_hash_catalog_entry *
+catalog_entries(struct share_rte_hash_catalog *c)
+{
+	return (struct share_rte_hash_catalog_entry *)(void *)(c + 1);
+}
+
+/* Rounds a size up to a cache line, tables may be larger than 4GB */
+static inline uint64_t
+align_bytes(uint64_t size)
+{
+	return (size + CACHE_LINE_SIZE - 1) & ~(uint64_t)(CACHE_LINE_SIZE - 1);
+}
+
+/* Bytes of a bucket in a segment, see ShareRteHash::k_FLAG_SEGMENTED */
+static inline uint32_t
+segment_bucket_bytes(uint32_t bucket_entries, uint32_t sig_bucket_size, uint32_t key_value_size,
+		uint32_t flags)
+{
+	uint32_t bytes = sig_bucket_size + bucket_entries * key_value_size;
+
+	if (flags & ShareRteHash::k_FLAG_GENERATIONS)
+		bytes += bucket_entries * sizeof(uint32_t);
+	return bytes;
+}
+
+/* Pages are read this many bytes apart by prefault_hash_table */
+static const uint32_t k_PREFAULT_STRIDE = 4096;
+
+static void
+init_bucket_locks(void *bucket_lock_array, uint32_t first, uint32_t last, uint32_t flags)
+{
+	for (uint32_t i = first; i < last; ++i) {
+		switch (flags & ShareRteHash::k_FLAG_LOCK_MASK) {
+			case ShareRteHash::k_FLAG_LOCK_PHASE_FAIR:
+				share_pf_rwlock_init((share_pf_rwlock_t *)bucket_lock_array + i);
+				break;
+			case ShareRteHash::k_FLAG_LOCK_WRITER_PREF:
+				share_wp_rwlock_init((share_wp_rwlock_t *)bucket_lock_array + i,
+						ShareRteHash::k_WP_READER_BUDGET);
+				break;
+			default:
+				rte_rwlock_init((rte_rwlock_t *)bucket_lock_array + i);
+				break;
+		}
+	}
+}
+
+/* Memory of a new table to zero, see k_FLAG_PARALLEL_INIT */
+struct init_region {
+	uint8_t *addr;
+	size_t   size;
+};
+
+/* The share of one lcore in the set up of a new table */
+struct init_job {
+	struct init_region regions[4];
+	uint32_t num_regions;
+	uint8_t **segments;
+	uint32_t num_segments;
+	size_t   segment_size;
+	uint8_t *locks;
+	size_t   locks_size;
+	uint32_t lock_size;
+	uint32_t num_buckets;
+	uint32_t flags;
+	uint32_t part;
+	uint32_t parts;
+	unsigned lcore;		/* RTE_MAX_LCORE when run by the caller */
+};
+
+/* Zero part of every region and segment, and set up part of the locks */
+static int
+init_part(void *arg)
+{
+	struct init_job *job = (struct init_job *)arg;
+	uint64_t first, last;
+	uint32_t i;
+
+	for (i = 0; i < job->num_regions; i++) {
+		first = (uint64_t)job->regions[i].size * job->part / job->parts;
+		last = (uint64_t)job->regions[i].size * (job->part + 1) / job->parts;
+		memset(job->regions[i].addr + first, 0, last - first);
+	}
+
+	for (i = job->part; i < job->num_segments; i += job->parts)
+		memset(job->segments[i], 0, job->segment_size);
+
+	first = (uint64_t)job->num_buckets * job->part / job->parts;
+	last = (uint64_t)job->num_buckets * (job->part + 1) / job->parts;
+	init_bucket_locks(job->locks, first, last, job->flags);
+
+	/* The padding after the last lock goes with the last part */
+	if (job->part == job->parts - 1)
+		memset(job->locks + (size_t)job->num_buckets * job->lock_size, 0,
+		       job->locks_size - (size_t)job->num_buckets * job->lock_size);
+	return 0;
+}
+
+/*
+ * Run init_part on this lcore and on the idle slave lcores of the socket,
+ * a part whose lcore can't be launched is run here. Only the master lcore
+ * launches, elsewhere this lcore runs the single part.
+ */
+static void
+init_table(const struct init_job *job, int socket_id)
+{
+	struct init_job jobs[RTE_MAX_LCORE];
+	unsigned lcore;
+	uint32_t i, parts = 1;
+
+	jobs[0].lcore = RTE_MAX_LCORE;
+	RTE_LCORE_FOREACH_SLAVE(lcore) {
+		if (rte_lcore_id() != rte_get_master_lcore())
+			break;
+		if (socket_id != SOCKET_ID_ANY && rte_lcore_to_socket_id(lcore) != (unsigned)socket_id)
+			continue;
+		if (rte_eal_get_lcore_state(lcore) == WAIT)
+			jobs[parts++].lcore = lcore;
+	}
+
+	for (i = 0; i < parts; i++) {
+		lcore = jobs[i].lcore;
+		jobs[i] = *job;
+		jobs[i].part = i;
+		jobs[i].parts = parts;
+		jobs[i].lcore = lcore;
+	}
+
+	for (i = 1; i < parts; i++)
+		if (rte_eal_remote_launch(init_part, &jobs[i], jobs[i].lcore) != 0)
+			jobs[i].lcore = RTE_MAX_LCORE;
+
+	for (i = 0; i < parts; i++)
+		if (jobs[i].lcore == RTE_MAX_LCORE)
+			init_part(&jobs[i]);
+
+	for (i = 1; i < parts; i++)
+		if (jobs[i].lcore != RTE_MAX_LCORE)
+			rte_eal_wait_lcore(jobs[i].lcore);
+}
+
+static uint64_t
+touch_pages(const void *addr, uint64_t size)
+{
+	const volatile uint8_t *p = (const volatile uint8_t *)addr;
+	uint64_t offset;
+
+	for (offset = 0; offset < size; offset += k_PREFAULT_STRIDE)
+		(void)p[offset];
+	if (size)
+		(void)p[size - 1];
+	return size;
+}
+
+/* The rte_hash name of a table, a long name keeps its head and a hash of the whole */
+static void
+table_name(const char *name, char *buf)
+{
+	size_t len = strlen(name);
+
+	if (len < RTE_HASH_NAMESIZE)
+		rte_snprintf(buf, RTE_HASH_NAMESIZE, "%s", name);
+	else
+		rte_snprintf(buf, RTE_HASH_NAMESIZE, "%.*s~%08x", RTE_HASH_NAMESIZE - 10, name,
+			     DEFAULT_HASH_FUNC(name, len, 0));
+}
+
+share_rte_hash_catalog *
+ShareRteHash::catalog(bool create)
+{
+	const struct rte_memzone *mz;
+	struct share_rte_hash_catalog *c;
+
+	if (m_catalog)
+		return m_catalog;
+
+	mz = rte_memzone_lookup(k_CATALOG_ZONE);
+	if (mz == NULL && create && rte_eal_process_type() == RTE_PROC_PRIMARY) {
+		mz = rte_memzone_reserve(k_CATALOG_ZONE, sizeof(*c) +
+				k_CATALOG_ENTRIES * sizeof(struct share_rte_hash_catalog_entry),
+				SOCKET_ID_ANY, 0);
+		if (mz == NULL) {
+			RTE_LOG(ERR, HASH, "memory allocation failed - catalog\n");
+			return NULL;
+		}
+
+		c = (struct share_rte_hash_catalog *)mz->addr;
+		memset(c, 0, mz->len);
+		c->capacity = k_CATALOG_ENTRIES;
+		rte_wmb();
+		c->magic = k_CATALOG_MAGIC;
+	}
+	if (mz == NULL)
+		return NULL;
+
+	/* The primary may still be initializing it */
+	c = (struct share_rte_hash_catalog *)mz->addr;
+	if (c->magic != k_CATALOG_MAGIC)
+		return NULL;
+	rte_rmb();
+
+	m_catalog = c;
+	return c;
+}
+
+/* Copy the entry of a table, readers take no lock and retry on the entry version */
+int
+ShareRteHash::catalog_lookup(const char *name, share_rte_hash_catalog_entry *entry)
+{
+	struct share_rte_hash_catalog *c = catalog(false);
+	struct share_rte_hash_catalog_entry *e;
+	uint32_t hash, version, i;
+
+	if (c == NULL)
+		return -ENOENT;
+
+	hash = DEFAULT_HASH_FUNC(name, strlen(name), 0);
+	for (i = 0; i < c->capacity; i++) {
+		e = catalog_entries(c) + ((hash + i) & (c->capacity - 1));
+		do {
+			while ((version = e->version) & 1)
+				rte_pause();
+			rte_rmb();
+			memcpy(entry, (const void *)e, sizeof(*entry));
+			rte_rmb();
+		} while (e->version != version);
+
+		if (entry->state == k_CATALOG_FREE)
+			break;
+		if (entry->state == k_CATALOG_USED && entry->name_hash == hash &&
+		    strncmp(entry->name, name, k_CATALOG_NAMESIZE) == 0)
+			return 0;
+	}
+	return -ENOENT;
+}
+
+void
+ShareRteHash::catalog_add(const char *name, rte_hash *h, uint64_t fingerprint)
+{
+	struct share_rte_hash_catalog *c = catalog(true);
+	struct share_rte_hash_catalog_entry *e = NULL;
+	uint32_t hash, i;
+
+	if (c == NULL)
+		return;
+
+	hash = DEFAULT_HASH_FUNC(name, strlen(name), 0);
+	for (i = 0; i < c->capacity; i++) {
+		e = catalog_entries(c) + ((hash + i) & (c->capacity - 1));
+		if (e->state != k_CATALOG_USED)
+			break;
+	}
+	if (i == c->capacity) {
+		RTE_LOG(ERR, HASH, "the catalog is full, %s is found in the tailq only\n", name);
+		return;
+	}
+
+	if (e->state == k_CATALOG_FREE)
+		c->used++;
+
+	e->version++;
+	rte_wmb();
+	e->state = k_CATALOG_USED;
+	e->name_hash = hash;
+	e->fingerprint = fingerprint;
+	e->table = h;
+	rte_snprintf(e->name, sizeof(e->name), "%s", name);
+	rte_wmb();
+	e->version++;
+}
+
+void
+ShareRteHash::catalog_remove(const rte_hash *h)
+{
+	struct share_rte_hash_catalog *c = catalog(false);
+	struct share_rte_hash_catalog_entry *e;
+	uint32_t i;
+
+	if (c == NULL)
+		return;
+
+	for (i = 0; i < c->capacity; i++) {
+		e = catalog_entries(c) + i;
+		if (e->state != k_CATALOG_USED || e->table != h)
+			continue;
+
+		e->version++;
+		rte_wmb();
+		e->state = k_CATALOG_DELETED;
+		e->table = NULL;
+		rte_wmb();
+		e->version++;
+		break;
+	}
+}
+
 rte_hash *
-ShareRteHash::attach_hash_table(const char *name)
+ShareRteHash::attach_hash_table(const char *name, uint64_t fingerprint)
 {
 	struct rte_hash *h;
 	struct rte_hash_list *hash_list;
+	struct share_rte_hash_catalog_entry entry;
+	char short_name[RTE_HASH_NAMESIZE];
+
+	if (catalog_lookup(name, &entry) == 0) {
+		if (fingerprint && entry.fingerprint && fingerprint != entry.fingerprint) {
+			RTE_LOG(ERR, HASH, "ShareRteHash::attach_hash_table %s was created with other "
+				"key/value types\n", name);
+			rte_errno = EINVAL;
+			return NULL;
+		}
+		return entry.table;
+	}
 
 	/* check that we have an initialised tail queue */
 	if ((hash_list = RTE_TAILQ_LOOKUP_BY_IDX(RTE_TAILQ_HASH, rte_hash_list)) == NULL) {
@@ -75,18 +390,38 @@ ShareRteHash::attach_hash_table(const char *name)
 		return NULL;
 	}
 
+	table_name(name, short_name);
 	rte_rwlock_read_lock(RTE_EAL_TAILQ_RWLOCK);
 	TAILQ_FOREACH(h, hash_list, next) {
-		if (strncmp(name, h->name, RTE_HASH_NAMESIZE) == 0)
+		if (strncmp(short_name, h->name, RTE_HASH_NAMESIZE) == 0)
 			break;
 	}
 	rte_rwlock_read_unlock(RTE_EAL_TAILQ_RWLOCK);
 
-	if (h == NULL)
+	if (h == NULL) {
 		rte_errno = ENOENT;
+	} else if (get_hash_ext(h)->initializing) {
+		/* Not in the catalog yet, see k_FLAG_PARALLEL_INIT */
+		rte_errno = EAGAIN;
+		h = NULL;
+	}
 	return h;
 }
 
+uint32_t
+ShareRteHash::attach_hash_tables(const char * const *names, const uint64_t *fingerprints,
+		uint32_t n, rte_hash **tables)
+{
+	uint32_t i, attached = 0;
+
+	for (i = 0; i < n; i++) {
+		tables[i] = attach_hash_table(names[i], fingerprints ? fingerprints[i] : 0);
+		if (tables[i])
+			attached++;
+	}
+	return attached;
+}
+
 /*
  * @ Description:
  *   This function is based on rte_hash_create. It made following changes to
@@ -95,6 +430,8 @@ ShareRteHash::attach_hash_table(const char *name)
  *     . The memory zone of rte_hash, signature table and key_value table are
  *       independent now. So that it could support resize of hash table.
  *     . The maximum bulket entires is extended to 1024 now
+ *     . Table flags (see k_FLAG_*) are kept in share_rte_hash_ext, which
+ *       follows struct rte_hash in the same memory zone
  *
  * @ The overview of this rte_hash looks like fowlloing graphic:
  *                       +-----------+ 
@@ -103,28 +440,56 @@ ShareRteHash::attach_hash_table(const char *name)
  *                       |  sig_tbl  |------> |  signature table  | 
  *                       |-----------|        |-------------------|
  *                       |  key_tbl  |        | bucket locks array|
- *                       +-----------+        +-------------------+
+ *                       |-----------|        |-------------------|
+ *                       |    ext    |        | bucket versions   |
+ *                       +-----------+        |-------------------|
+ *                             |              | filter (optional) |
+ *                             |              |-------------------|
+ *                             |              | dirty bits (opt.) |
+ *                             |              |-------------------|
+ *                             |              | generations (opt.)|
+ *                             |              +-------------------+
  *                             |
- *                             |              <* The bucket locks array just follows sig_tbl *>
+ *                             |              <* The bucket locks, versions, filter and dirty bits just follow sig_tbl *>
  *                             v
  *                             +---------------+
  *                             |   key table   |
  *                             +---------------+
  *
+ *   With k_FLAG_SEGMENTED key_tbl is NULL and there is no signature table
+ *   in SIG_. Both tables are split into segments allocated one by one,
+ *   whose addresses are kept in a segment table after the dirty bits:
+ *
+ *     SEG_ 0 : | signature buckets | key/value buckets | generations |
+ *     SEG_ 1 : | signature buckets | key/value buckets | generations |
+ *     ...
+ *
  */
 rte_hash *
-ShareRteHash::create_hash_table(const rte_hash_parameters *params)
+ShareRteHash::create_hash_table(const rte_hash_parameters *params, uint32_t flags,
+		uint64_t fingerprint, bool *created)
 {
 	struct rte_hash *h = NULL;
     uint8_t *p_sig_tbl = NULL;
     uint8_t *p_key_value_tbl = NULL;
-	uint32_t num_buckets, sig_bucket_size, key_value_size,
-		hash_tbl_size, sig_tbl_size, key_value_tbl_size,
-        bucket_locks_array_size;
+    uint8_t **p_segments = NULL;
+	uint32_t num_buckets, sig_bucket_size, key_value_size, seg_shift = 0, i;
+	size_t hash_tbl_size, sig_tbl_size, key_value_tbl_size,
+        bucket_locks_array_size, bucket_versions_size, filter_size, dirty_size,
+        segment_tbl_size, generation_size, segment_size = 0;
 	char hash_name[RTE_HASH_NAMESIZE];
 	char sig_name[RTE_HASH_NAMESIZE];
 	char key_value_name[RTE_HASH_NAMESIZE];
+	char segment_name[RTE_HASH_NAMESIZE];
+	char short_name[RTE_HASH_NAMESIZE];
 	struct rte_hash_list *hash_list;
+	struct share_rte_hash_footprint fp;
+	struct init_job job;
+	void *(*table_alloc)(const char *, size_t, unsigned, int) =
+	    (flags & k_FLAG_PARALLEL_INIT) ? rte_malloc_socket : rte_zmalloc_socket;
+
+	if (created)
+		*created = false;
 
 	/* check that we have an initialised tail queue */
 	if ((hash_list = 
@@ -134,8 +499,10 @@ ShareRteHash::create_hash_table(const rte_hash_parameters *params)
 	}
 
 	/* Check for valid parameters */
-	if ((params == NULL) ||
-			(params->entries > k_RTE_HASH_ENTRIES_MAX) ||
+	if ((params == NULL) || (params->name == NULL) ||
+			(strnlen(params->name, k_CATALOG_NAMESIZE) == k_CATALOG_NAMESIZE) ||
+			(params->entries > ((flags & k_FLAG_SEGMENTED) ?
+			    k_RTE_HASH_ENTRIES_MAX_SEGMENTED : k_RTE_HASH_ENTRIES_MAX)) ||
 			(params->bucket_entries > k_RTE_HASH_BUCKET_ENTRIES_MAX) ||
 			(params->entries < params->bucket_entries) ||
 			!rte_is_power_of_2(params->entries) ||
@@ -147,32 +514,93 @@ ShareRteHash::create_hash_table(const rte_hash_parameters *params)
 		return NULL;
 	}
 
+	if ((flags & k_FLAG_LOCK_MASK) == k_FLAG_LOCK_MASK) {
+		rte_errno = EINVAL;
+		RTE_LOG(ERR, HASH, "ShareRteHash::create_hash_table got two bucket lock types\n");
+		return NULL;
+	}
+
+	if ((flags & k_FLAG_LOCK_FREE) && (flags & (k_FLAG_SINGLE_WRITER | k_FLAG_FILTER))) {
+		rte_errno = EINVAL;
+		RTE_LOG(ERR, HASH, "ShareRteHash::create_hash_table can't make a lock-free table "
+			"single writer or filtered\n");
+		return NULL;
+	}
+
+	if ((flags & k_FLAG_SEGMENTED) && (flags & k_FLAG_FILTER)) {
+		rte_errno = EINVAL;
+		RTE_LOG(ERR, HASH, "ShareRteHash::create_hash_table can't make a segmented table "
+			"filtered\n");
+		return NULL;
+	}
+
+	table_name(params->name, short_name);
 	rte_snprintf(hash_name, sizeof(hash_name), "HT_%s", params->name);
 	rte_snprintf(sig_name, sizeof(sig_name), "SIG_%s", params->name);
 	rte_snprintf(key_value_name, sizeof(key_value_name), "KV_%s", params->name);
+	rte_snprintf(segment_name, sizeof(segment_name), "SEG_%s", params->name);
 
 	/* Calculate hash dimensions */
 	num_buckets = params->entries / params->bucket_entries;
-	hash_tbl_size   = align_size(sizeof(struct rte_hash), CACHE_LINE_SIZE);
-
 	sig_bucket_size = align_size(params->bucket_entries * sizeof(hash_sig_t), k_SIG_BUCKET_ALIGNMENT);
-	sig_tbl_size    = align_size(num_buckets * sig_bucket_size, CACHE_LINE_SIZE);
 
-	key_value_size  = align_size(params->key_len, k_KEY_ALIGNMENT);
-	key_value_tbl_size = align_size(num_buckets * key_value_size * params->bucket_entries, CACHE_LINE_SIZE);
+	/* A packed slot keeps the natural size of the key/value pair */
+	if (flags & k_FLAG_PACKED)
+		key_value_size = params->key_len;
+	else
+		key_value_size = align_size(params->key_len, k_KEY_ALIGNMENT);
 
-    bucket_locks_array_size = align_size(num_buckets * sizeof(rte_rwlock_t), CACHE_LINE_SIZE);
+	compute_footprint(num_buckets, params->bucket_entries, sig_bucket_size, key_value_size,
+			  flags, &fp);
+	hash_tbl_size = fp.ht_bytes;
+	sig_tbl_size = fp.sig_bytes;
+	bucket_locks_array_size = fp.lock_bytes;
+	bucket_versions_size = fp.version_bytes;
+	filter_size = fp.filter_bytes;
+	dirty_size = fp.dirty_bytes;
+	segment_tbl_size = fp.segment_bytes;
+	generation_size = fp.generation_bytes;
+	key_value_tbl_size = fp.kv_bytes;
+
+	/* The segments hold the signature and key/value tables instead */
+	if (flags & k_FLAG_SEGMENTED) {
+		uint32_t bucket_bytes = segment_bucket_bytes(params->bucket_entries, sig_bucket_size,
+				key_value_size, flags);
+
+		seg_shift = segment_shift(num_buckets, bucket_bytes);
+		segment_size = (size_t)bucket_bytes << seg_shift;
+		sig_tbl_size = 0;
+		key_value_tbl_size = 0;
+		generation_size = 0;
+	}
 	
     /* Do Lock */
 	rte_rwlock_write_lock(RTE_EAL_TAILQ_RWLOCK);
 
 	/* guarantee there's no existing */
 	TAILQ_FOREACH(h, hash_list, next) {
-		if (strncmp(params->name, h->name, RTE_HASH_NAMESIZE) == 0)
+		if (strncmp(short_name, h->name, RTE_HASH_NAMESIZE) == 0)
 			break;
 	}
-	if (h != NULL)
-		goto exit;
+	if (h != NULL) {
+		/* The existing table is returned, unless it holds other types */
+		struct share_rte_hash_catalog_entry entry;
+
+		/* Its creator may still be setting it up, without the lock */
+		rte_rwlock_write_unlock(RTE_EAL_TAILQ_RWLOCK);
+		while (get_hash_ext(h)->initializing)
+			rte_pause();
+		rte_rmb();
+
+		if (fingerprint && catalog_lookup(params->name, &entry) == 0 &&
+		    entry.fingerprint && entry.fingerprint != fingerprint) {
+			RTE_LOG(ERR, HASH, "ShareRteHash::create_hash_table %s exists with other "
+				"key/value types\n", params->name);
+			rte_errno = EEXIST;
+			h = NULL;
+		}
+		return h;
+	}
 
     /* Allocate memory for rte_hash */
 	h = (struct rte_hash *)rte_zmalloc_socket(hash_name, hash_tbl_size,
@@ -183,33 +611,50 @@ ShareRteHash::create_hash_table(const rte_hash_parameters *params)
 	}
 
     /*
-     * Allocate memory for sig_tbl and bucket locks
+     * Allocate memory for sig_tbl, bucket locks and bucket versions
      * put the bucket locks array just after sig_tbl
      */
-    p_sig_tbl = (uint8_t *)rte_zmalloc_socket(sig_name, sig_tbl_size + bucket_locks_array_size,
+    p_sig_tbl = (uint8_t *)table_alloc(sig_name,
+            sig_tbl_size + bucket_locks_array_size + bucket_versions_size + filter_size + dirty_size +
+            segment_tbl_size + generation_size,
             CACHE_LINE_SIZE, params->socket_id);
 
 	if (p_sig_tbl == NULL) {
 		RTE_LOG(ERR, HASH, "memory allocation failed - sig table\n");
 		goto malloc_fail_1;
-	} else {
+	} else if (!(flags & k_FLAG_PARALLEL_INIT)) {
         /* Initialize bucket locks */
-        rte_rwlock_t * bucket_lock_array = static_cast<rte_rwlock_t *>((void *)(p_sig_tbl + sig_tbl_size)); 
-        for (uint32_t i = 0; i < num_buckets; ++i)
-            rte_rwlock_init(&bucket_lock_array[i]);
+        init_bucket_locks(p_sig_tbl + sig_tbl_size, 0, num_buckets, flags);
     }
 
-    /* Allocate memory for key_value table */
-    p_key_value_tbl = (uint8_t *)rte_zmalloc_socket(key_value_name, key_value_tbl_size,
-            CACHE_LINE_SIZE, params->socket_id);
+    if (flags & k_FLAG_SEGMENTED) {
+        /* Allocate the segments, each one on its own */
+        p_segments = (uint8_t **)(void *)(p_sig_tbl + bucket_locks_array_size +
+                bucket_versions_size + filter_size + dirty_size);
+        if (flags & k_FLAG_PARALLEL_INIT)
+            memset(p_segments, 0, segment_tbl_size);
+        for (i = 0; i < fp.segments; i++) {
+            p_segments[i] = (uint8_t *)table_alloc(segment_name, segment_size,
+                    CACHE_LINE_SIZE, params->socket_id);
+            if (p_segments[i] == NULL) {
+                RTE_LOG(ERR, HASH, "memory allocation failed - segment %u of %u\n",
+                        i, fp.segments);
+                goto malloc_fail_3;
+            }
+        }
+    } else {
+        /* Allocate memory for key_value table */
+        p_key_value_tbl = (uint8_t *)table_alloc(key_value_name, key_value_tbl_size,
+                CACHE_LINE_SIZE, params->socket_id);
 
-	if (p_key_value_tbl == NULL) {
-		RTE_LOG(ERR, HASH, "memory allocation failed - key value table\n");
-		goto malloc_fail_2;
-	}
+        if (p_key_value_tbl == NULL) {
+            RTE_LOG(ERR, HASH, "memory allocation failed - key value table\n");
+            goto malloc_fail_2;
+        }
+    }
 
 	/* Setup hash context */
-	rte_snprintf(h->name, sizeof(h->name), "%s", params->name);
+	rte_snprintf(h->name, sizeof(h->name), "%s", short_name);
 	h->entries = params->entries;
 	h->bucket_entries = params->bucket_entries;
 	h->key_len = params->key_len;
@@ -223,10 +668,74 @@ ShareRteHash::create_hash_table(const rte_hash_parameters *params)
 	h->key_tbl_key_size = key_value_size;
 	h->hash_func = (params->hash_func == NULL) ?
 		DEFAULT_HASH_FUNC : params->hash_func;
+	get_hash_ext(h)->flags = flags;
+	get_hash_ext(h)->bucket_locks = p_sig_tbl + sig_tbl_size;
+	get_hash_ext(h)->bucket_versions =
+	    (volatile uint32_t *)(void *)(p_sig_tbl + sig_tbl_size + bucket_locks_array_size);
+	if (flags & k_FLAG_FILTER) {
+		get_hash_ext(h)->filter = (uint64_t *)(void *)(p_sig_tbl + sig_tbl_size +
+		    bucket_locks_array_size + bucket_versions_size);
+		get_hash_ext(h)->filter_shift = filter_shift(params->bucket_entries);
+	}
+	if (flags & k_FLAG_DIRTY_TRACKING)
+		get_hash_ext(h)->dirty = (volatile uint64_t *)(void *)(p_sig_tbl + sig_tbl_size +
+		    bucket_locks_array_size + bucket_versions_size + filter_size);
+	if (flags & k_FLAG_SEGMENTED) {
+		get_hash_ext(h)->segments = p_segments;
+		get_hash_ext(h)->segment_shift = seg_shift;
+		get_hash_ext(h)->segment_entry_shift = seg_shift + __builtin_ctz(params->bucket_entries);
+		get_hash_ext(h)->segment_kv_offset = sig_bucket_size << seg_shift;
+		get_hash_ext(h)->segment_gen_offset = (sig_bucket_size +
+		    params->bucket_entries * key_value_size) << seg_shift;
+	} else if (flags & k_FLAG_GENERATIONS) {
+		get_hash_ext(h)->generations = (volatile uint32_t *)(void *)(p_sig_tbl + sig_tbl_size +
+		    bucket_locks_array_size + bucket_versions_size + filter_size + dirty_size);
+	}
+
+    /* Everything but the segment table, which is set already, once the lock is dropped */
+    if (flags & k_FLAG_PARALLEL_INIT) {
+        memset(&job, 0, sizeof(job));
+        job.regions[0].addr = p_sig_tbl;
+        job.regions[0].size = sig_tbl_size;
+        job.regions[1].addr = p_sig_tbl + sig_tbl_size + bucket_locks_array_size;
+        job.regions[1].size = bucket_versions_size + filter_size + dirty_size;
+        job.regions[2].addr = p_sig_tbl + sig_tbl_size + bucket_locks_array_size +
+                bucket_versions_size + filter_size + dirty_size + segment_tbl_size;
+        job.regions[2].size = generation_size;
+        job.regions[3].addr = p_key_value_tbl;
+        job.regions[3].size = key_value_tbl_size;
+        job.num_regions = 4;
+        job.segments = p_segments;
+        job.num_segments = fp.segments;
+        job.segment_size = segment_size;
+        job.locks = p_sig_tbl + sig_tbl_size;
+        job.locks_size = bucket_locks_array_size;
+        job.lock_size = bucket_lock_size(flags);
+        job.num_buckets = num_buckets;
+        job.flags = flags;
+        get_hash_ext(h)->initializing = 1;
+    }
 
 	TAILQ_INSERT_TAIL(hash_list, h, next);
+
+	/* The name is taken, set the table up without the lock */
+	if (flags & k_FLAG_PARALLEL_INIT) {
+		rte_rwlock_write_unlock(RTE_EAL_TAILQ_RWLOCK);
+		init_table(&job, params->socket_id);
+		rte_rwlock_write_lock(RTE_EAL_TAILQ_RWLOCK);
+	}
+
+	catalog_add(params->name, h, fingerprint);
+	rte_wmb();
+	get_hash_ext(h)->initializing = 0;
+	if (created)
+		*created = true;
     goto exit;
 
+malloc_fail_3:
+    for (i = 0; i < fp.segments; i++)
+        if (p_segments[i])
+            rte_free(p_segments[i]);
 malloc_fail_2:
     if (p_sig_tbl) {
         rte_free(p_sig_tbl);
@@ -249,15 +758,552 @@ ShareRteHash::free_hash_table(rte_hash *& h)
 	if (h == NULL)
 		return;
 
+	rte_rwlock_write_lock(RTE_EAL_TAILQ_RWLOCK);
+	catalog_remove(h);
+	rte_rwlock_write_unlock(RTE_EAL_TAILQ_RWLOCK);
+
 	RTE_EAL_TAILQ_REMOVE(RTE_TAILQ_HASH, rte_hash_list, h);
     
-    if (h->sig_tbl)
-        rte_free(h->sig_tbl);
+	if (is_segmented(h)) {
+		uint32_t segments = h->num_buckets >> get_hash_ext(h)->segment_shift;
 
-    if (h->key_tbl)
-        rte_free(h->key_tbl);
+		for (uint32_t i = 0; i < segments; i++)
+			rte_free(get_hash_ext(h)->segments[i]);
+	}
+
+	if (h->sig_tbl)
+		rte_free(h->sig_tbl);
+
+	if (h->key_tbl)
+		rte_free(h->key_tbl);
+
+	if (get_hash_ext(h)->changelog)
+		rte_free(get_hash_ext(h)->changelog);
 
 	rte_free(h);
-    h = NULL;
+	h = NULL;
+}
+
+uint64_t
+ShareRteHash::prefault_hash_table(const rte_hash *h)
+{
+	const share_rte_hash_ext *ext = get_hash_ext(h);
+	struct share_rte_hash_footprint fp;
+	uint64_t bytes, sig_zone;
+	uint32_t i;
+
+	get_footprint(h, &fp);
+	bytes = touch_pages(h, fp.ht_bytes);
+
+	sig_zone = fp.lock_bytes + fp.version_bytes + fp.filter_bytes + fp.dirty_bytes + fp.segment_bytes;
+	if (is_segmented(h)) {
+		size_t segment_size = (size_t)segment_bucket_bytes(h->bucket_entries, h->sig_tbl_bucket_size,
+				h->key_tbl_key_size, ext->flags) << ext->segment_shift;
+
+		bytes += touch_pages(h->sig_tbl, sig_zone);
+		for (i = 0; i < fp.segments; i++)
+			bytes += touch_pages(ext->segments[i], segment_size);
+	} else {
+		bytes += touch_pages(h->sig_tbl, fp.sig_bytes + sig_zone + fp.generation_bytes);
+		bytes += touch_pages(h->key_tbl, fp.kv_bytes);
+	}
+
+	if (ext->changelog)
+		bytes += touch_pages(ext->changelog, fp.log_bytes);
+	return bytes;
+}
+
+/*
+ * Bytes requested for each part of a table. create_hash_table allocates
+ * exactly these; the malloc heap adds its own small header to each of the
+ * HT_, SIG_ and KV_ allocations.
+ */
+void
+ShareRteHash::compute_footprint(uint32_t num_buckets, uint32_t bucket_entries,
+		uint32_t sig_bucket_size, uint32_t key_value_size, uint32_t flags,
+		struct share_rte_hash_footprint *fp)
+{
+	memset(fp, 0, sizeof(*fp));
+	fp->ht_bytes      = align_size(sizeof(struct rte_hash), CACHE_LINE_SIZE) +
+	                    align_size(sizeof(struct share_rte_hash_ext), CACHE_LINE_SIZE);
+	fp->sig_bytes     = align_bytes((uint64_t)num_buckets * sig_bucket_size);
+	fp->lock_bytes    = align_bytes((uint64_t)num_buckets * bucket_lock_size(flags));
+	fp->version_bytes = align_bytes((uint64_t)num_buckets * sizeof(uint32_t));
+	if (flags & k_FLAG_FILTER)
+		fp->filter_bytes = (uint64_t)num_buckets * k_FILTER_BLOCK_WORDS * sizeof(uint64_t)
+		                   << filter_shift(bucket_entries);
+	if (flags & k_FLAG_DIRTY_TRACKING)
+		fp->dirty_bytes = align_size(div_roundup(num_buckets, 64) * sizeof(uint64_t), CACHE_LINE_SIZE);
+	fp->kv_bytes      = align_bytes((uint64_t)num_buckets * key_value_size * bucket_entries);
+	if (flags & k_FLAG_GENERATIONS)
+		fp->generation_bytes = align_bytes((uint64_t)num_buckets * bucket_entries * sizeof(uint32_t));
+	if (flags & k_FLAG_SEGMENTED) {
+		fp->segments = num_buckets >> segment_shift(num_buckets,
+				segment_bucket_bytes(bucket_entries, sig_bucket_size, key_value_size, flags));
+		fp->segment_bytes = align_bytes((uint64_t)fp->segments * sizeof(uint8_t *));
+	}
+	fp->total_bytes   = fp->ht_bytes + fp->sig_bytes + fp->lock_bytes + fp->version_bytes +
+	                    fp->filter_bytes + fp->dirty_bytes + fp->segment_bytes +
+	                    fp->generation_bytes + fp->kv_bytes;
+	fp->slot_bytes    = key_value_size;
+}
+
+void
+ShareRteHash::get_footprint(const rte_hash *h, struct share_rte_hash_footprint *fp)
+{
+	compute_footprint(h->num_buckets, h->bucket_entries, h->sig_tbl_bucket_size,
+			  h->key_tbl_key_size, get_hash_ext(h)->flags, fp);
+
+	if (get_hash_ext(h)->changelog) {
+		fp->log_bytes = sizeof(struct share_rte_hash_changelog) +
+		                (uint64_t)get_hash_ext(h)->changelog->capacity *
+		                get_hash_ext(h)->changelog->record_size;
+		fp->total_bytes += fp->log_bytes;
+	}
+
+	fp->key_value_len = h->key_len;
+	fp->live_entries = entry_count(h);
+	if (fp->live_entries) {
+		fp->bytes_per_entry = (double)fp->total_bytes / fp->live_entries;
+		fp->overhead_ratio = (double)fp->total_bytes /
+		                     ((double)fp->live_entries * fp->key_value_len);
+	}
+}
+
+/*
+ * Segments hold a power of 2 buckets, as many as fit in k_SEGMENT_SIZE
+ * bytes, but not more than the table.
+ */
+uint32_t
+ShareRteHash::segment_shift(uint32_t num_buckets, uint32_t bucket_bytes)
+{
+	uint32_t shift = 0;
+
+	while ((2U << shift) <= num_buckets &&
+	       ((uint64_t)bucket_bytes << (shift + 1)) <= k_SEGMENT_SIZE)
+		++shift;
+	return shift;
 }
 
+/* One filter block of 128 counters for every k_FILTER_ENTRIES_PER_BLOCK entries */
+uint32_t
+ShareRteHash::filter_shift(uint32_t bucket_entries)
+{
+	uint32_t shift = 0;
+
+	while ((k_FILTER_ENTRIES_PER_BLOCK << shift) < bucket_entries)
+		++shift;
+	return shift;
+}
+
+int
+ShareRteHash::enable_changelog(const rte_hash *h, uint32_t records)
+{
+	char log_name[RTE_HASH_NAMESIZE];
+	struct share_rte_hash_changelog *log;
+	uint32_t record_size;
+
+	if (records == 0 || !rte_is_power_of_2(records))
+		return -EINVAL;
+	if (get_hash_ext(h)->changelog)
+		return -EEXIST;
+
+	rte_snprintf(log_name, sizeof(log_name), "CL_%.*s", (int)sizeof(log_name) - 4, h->name);
+	record_size = align_size(sizeof(struct share_rte_hash_change) + h->key_len, sizeof(uint64_t));
+	log = (struct share_rte_hash_changelog *)rte_zmalloc_socket(log_name,
+			sizeof(*log) + (size_t)records * record_size, CACHE_LINE_SIZE, SOCKET_ID_ANY);
+	if (log == NULL) {
+		RTE_LOG(ERR, HASH, "memory allocation failed - change log\n");
+		return -ENOMEM;
+	}
+
+	log->head = 1;
+	log->capacity = records;
+	log->record_size = record_size;
+	rte_wmb();
+	get_hash_ext(h)->changelog = log;
+	return 0;
+}
+
+/*
+ * Checkpoint file format, in host byte order:
+ *
+ *   file header | segment | segment | ...
+ *
+ *   segment = segment header | record ... | k_CKPT_END | count of records
+ *   record  = bucket index | signature bucket | key/value bucket
+ *
+ * A segment without its end mark was cut short and is ignored, with
+ * everything after it. Retired and pending slots are written as free ones.
+ */
+static const uint32_t k_CKPT_MAGIC   = 0x4b434853;      /* "SHCK" */
+static const uint32_t k_CKPT_VERSION = 1;
+static const uint32_t k_CKPT_SEGMENT = 0x47455348;      /* "HSEG" */
+static const uint32_t k_CKPT_END     = 0xffffffff;
+
+struct ckpt_file_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_buckets;
+	uint32_t bucket_entries;
+	uint32_t key_len;
+	uint32_t key_size;
+	uint32_t sig_bucket_size;
+	uint32_t reserved;
+};
+
+struct ckpt_segment_header {
+	uint32_t magic;
+	uint32_t full;
+	uint64_t log_seq;       /* head of the change log when the segment began */
+};
+
+static void
+ckpt_fill_header(const struct rte_hash *h, struct ckpt_file_header *fh)
+{
+	memset(fh, 0, sizeof(*fh));
+	fh->magic = k_CKPT_MAGIC;
+	fh->version = k_CKPT_VERSION;
+	fh->num_buckets = h->num_buckets;
+	fh->bucket_entries = h->bucket_entries;
+	fh->key_len = h->key_len;
+	fh->key_size = h->key_tbl_key_size;
+	fh->sig_bucket_size = h->sig_tbl_bucket_size;
+}
+
+static size_t
+ckpt_bucket_bytes(const struct ckpt_file_header *fh)
+{
+	return fh->sig_bucket_size + (size_t)fh->bucket_entries * fh->key_size;
+}
+
+/*
+ * Check the segment at the current position of f. Returns 1 and fills
+ * offsets with the file offset of each record if the segment is whole,
+ * 0 at the end of the file or on a cut segment, -EINVAL if corrupted.
+ * The file is left after the segment.
+ */
+static int
+ckpt_scan_segment(FILE *f, const struct ckpt_file_header *fh,
+		  struct ckpt_segment_header *sh, std::vector<long> *offsets)
+{
+	size_t bucket_bytes = ckpt_bucket_bytes(fh);
+	uint32_t tag, count;
+
+	offsets->clear();
+	if (fread(sh, sizeof(*sh), 1, f) != 1)
+		return 0;
+	if (sh->magic != k_CKPT_SEGMENT)
+		return -EINVAL;
+
+	for (;;) {
+		if (fread(&tag, sizeof(tag), 1, f) != 1)
+			return 0;
+		if (tag == k_CKPT_END)
+			break;
+		if (tag >= fh->num_buckets)
+			return -EINVAL;
+		offsets->push_back(ftell(f) - (long)sizeof(tag));
+		if (fseek(f, bucket_bytes, SEEK_CUR) != 0)
+			return 0;
+	}
+
+	if (fread(&count, sizeof(count), 1, f) != 1)
+		return 0;
+	if (count != offsets->size())
+		return -EINVAL;
+	return 1;
+}
+
+/* Read the record at offset, its bucket index goes to bucket_index */
+static int
+ckpt_read_record(FILE *f, const struct ckpt_file_header *fh, long offset,
+		 uint32_t *bucket_index, uint8_t *buf)
+{
+	if (fseek(f, offset, SEEK_SET) != 0 ||
+	    fread(bucket_index, sizeof(*bucket_index), 1, f) != 1 ||
+	    fread(buf, ckpt_bucket_bytes(fh), 1, f) != 1)
+		return -EIO;
+	return 0;
+}
+
+static int
+ckpt_finish(FILE *f)
+{
+	int ret = 0;
+
+	if (fflush(f) != 0 || fsync(fileno(f)) != 0)
+		ret = -EIO;
+	if (fclose(f) != 0)
+		ret = -EIO;
+	return ret;
+}
+
+/* Copy a bucket, signatures then key/values, as it is at one moment */
+void
+ShareRteHash::copy_bucket(const rte_hash *h, uint32_t bucket_index, uint8_t *buf)
+{
+	const uint8_t *sig_bucket = (const uint8_t *)get_sig_tbl_bucket<share_runtime_geometry>(h, bucket_index);
+	const uint8_t *key_bucket = get_key_tbl_bucket<share_runtime_geometry>(h, bucket_index);
+	size_t key_bytes = (size_t)h->bucket_entries * h->key_tbl_key_size;
+	hash_sig_t *sigs = (hash_sig_t *)(void *)buf;
+
+	if (has_lockless_readers(h)) {
+		volatile uint32_t *version = get_bucket_version(h, bucket_index);
+		uint32_t v;
+
+		do {
+			while ((v = *version) & k_VERSION_WRITERS)
+				rte_pause();
+			rte_rmb();
+			memcpy(buf, sig_bucket, h->sig_tbl_bucket_size);
+			memcpy(buf + h->sig_tbl_bucket_size, key_bucket, key_bytes);
+			rte_rmb();
+		} while (*version != v);
+	} else {
+		bucket_read_lock(h, bucket_index);
+		memcpy(buf, sig_bucket, h->sig_tbl_bucket_size);
+		memcpy(buf + h->sig_tbl_bucket_size, key_bucket, key_bytes);
+		bucket_read_unlock(h, bucket_index);
+	}
+
+	for (uint32_t i = 0; i < h->bucket_entries; i++)
+		if (!(sigs[i] & h->sig_msb))
+			sigs[i] = k_NULL_SIGNATURE;
+}
+
+/* Replace a bucket with one copied by copy_bucket */
+void
+ShareRteHash::apply_bucket(const rte_hash *h, uint32_t bucket_index, const uint8_t *buf)
+{
+	uint8_t *sig_bucket = (uint8_t *)get_sig_tbl_bucket<share_runtime_geometry>(h, bucket_index);
+	uint8_t *key_bucket = get_key_tbl_bucket<share_runtime_geometry>(h, bucket_index);
+	const hash_sig_t *old_sigs = (const hash_sig_t *)(const void *)sig_bucket;
+	const hash_sig_t *new_sigs = (const hash_sig_t *)(const void *)buf;
+	volatile uint32_t *version = get_bucket_version(h, bucket_index);
+	int32_t n = 0;
+
+	bucket_write_lock(h, bucket_index);
+	bucket_write_begin(h, version);
+
+	/* Every entry is replaced, the old ones lose their handles */
+	for (uint32_t i = 0; i < h->bucket_entries; i++) {
+		n += ((new_sigs[i] & h->sig_msb) != 0) - ((old_sigs[i] & h->sig_msb) != 0);
+		if (old_sigs[i] & h->sig_msb)
+			next_generation(h, bucket_index * h->bucket_entries + i);
+	}
+	rte_wmb();
+	memcpy(key_bucket, buf + h->sig_tbl_bucket_size, (size_t)h->bucket_entries * h->key_tbl_key_size);
+	for (uint32_t i = 0; i < h->bucket_entries; i++)
+		if (new_sigs[i] & h->sig_msb)
+			next_generation(h, bucket_index * h->bucket_entries + i);
+	rte_wmb();
+	memcpy(sig_bucket, buf, h->sig_tbl_bucket_size);
+
+	bucket_write_end(h, version);
+	bucket_write_unlock(h, bucket_index);
+
+	count_entries(h, n);
+	rebuild_filter_bucket(h, bucket_index);
+}
+
+int
+ShareRteHash::checkpoint_table(const rte_hash *h, const char *path, bool full)
+{
+	volatile uint64_t *dirty = get_hash_ext(h)->dirty;
+	struct ckpt_file_header fh, old;
+	struct ckpt_segment_header sh;
+	uint32_t word, bit, b, count = 0, end[2];
+	uint64_t taken;
+	std::vector<uint8_t> buf;
+	FILE *f;
+
+	if (!full && dirty == NULL)
+		return -EINVAL;
+
+	f = fopen(path, "a+b");
+	if (f == NULL)
+		return -errno;
+
+	/* A new file gets a header, an old one must be of the same table */
+	ckpt_fill_header(h, &fh);
+	fseek(f, 0, SEEK_END);
+	if (ftell(f) == 0) {
+		if (fwrite(&fh, sizeof(fh), 1, f) != 1)
+			goto write_fail;
+	} else {
+		rewind(f);
+		if (fread(&old, sizeof(old), 1, f) != 1 || memcmp(&old, &fh, sizeof(fh)) != 0) {
+			fclose(f);
+			return -EINVAL;
+		}
+		fseek(f, 0, SEEK_END);
+	}
+
+	sh.magic = k_CKPT_SEGMENT;
+	sh.full = full;
+	sh.log_seq = changelog_head(h);
+	if (fwrite(&sh, sizeof(sh), 1, f) != 1)
+		goto write_fail;
+
+	/*
+	 * The dirty bits of 64 buckets are taken at once before the buckets
+	 * are copied, a later write sets them again for the next segment.
+	 */
+	buf.resize(ckpt_bucket_bytes(&fh));
+	for (word = 0; word * 64 < h->num_buckets; word++) {
+		taken = dirty ? __sync_fetch_and_and(&dirty[word], 0) : 0;
+		if (full)
+			taken = ~0ULL;
+
+		for (bit = 0; bit < 64 && word * 64 + bit < h->num_buckets; bit++) {
+			if (!(taken & (1ULL << bit)))
+				continue;
+
+			b = word * 64 + bit;
+			copy_bucket(h, b, &buf[0]);
+			if (fwrite(&b, sizeof(b), 1, f) != 1 ||
+			    fwrite(&buf[0], buf.size(), 1, f) != 1)
+				goto write_fail;
+			++count;
+		}
+	}
+
+	end[0] = k_CKPT_END;
+	end[1] = count;
+	if (fwrite(end, sizeof(end), 1, f) != 1)
+		goto write_fail;
+
+	if (ckpt_finish(f) < 0)
+		goto sync_fail;
+	return count;
+
+write_fail:
+	fclose(f);
+sync_fail:
+	/* The segment is lost, the next one has to write every bucket */
+	if (dirty)
+		for (word = 0; word * 64 < h->num_buckets; word++)
+			dirty[word] = ~0ULL;
+	return -EIO;
+}
+
+int
+ShareRteHash::restore_table(const rte_hash *h, const char *path)
+{
+	struct ckpt_file_header fh, expected;
+	struct ckpt_segment_header sh;
+	std::vector<long> offsets;
+	std::vector<uint8_t> buf;
+	uint32_t b;
+	long next;
+	int ret, segments = 0;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (f == NULL)
+		return -errno;
+
+	ckpt_fill_header(h, &expected);
+	if (fread(&fh, sizeof(fh), 1, f) != 1 || memcmp(&fh, &expected, sizeof(fh)) != 0) {
+		fclose(f);
+		return -EINVAL;
+	}
+
+	buf.resize(ckpt_bucket_bytes(&fh));
+	while ((ret = ckpt_scan_segment(f, &fh, &sh, &offsets)) > 0) {
+		next = ftell(f);
+		for (size_t i = 0; i < offsets.size(); i++) {
+			ret = ckpt_read_record(f, &fh, offsets[i], &b, &buf[0]);
+			if (ret < 0)
+				goto exit;
+			apply_bucket(h, b, &buf[0]);
+		}
+		fseek(f, next, SEEK_SET);
+		++segments;
+	}
+	if (ret == 0)
+		ret = segments;
+
+exit:
+	fclose(f);
+	return ret;
+}
+
+int
+ShareRteHash::compact_checkpoint(const char *in_path, const char *out_path)
+{
+	struct ckpt_file_header fh;
+	struct ckpt_segment_header sh, last;
+	std::vector<long> offsets, latest;
+	std::vector<uint8_t> buf;
+	uint32_t b, count = 0, end[2];
+	int ret;
+	FILE *in, *out;
+
+	in = fopen(in_path, "rb");
+	if (in == NULL)
+		return -errno;
+	if (fread(&fh, sizeof(fh), 1, in) != 1 || fh.magic != k_CKPT_MAGIC ||
+	    fh.version != k_CKPT_VERSION) {
+		fclose(in);
+		return -EINVAL;
+	}
+
+	/* Offset of the latest image of every bucket */
+	latest.assign(fh.num_buckets, -1);
+	memset(&last, 0, sizeof(last));
+	last.magic = k_CKPT_SEGMENT;
+	while ((ret = ckpt_scan_segment(in, &fh, &sh, &offsets)) > 0) {
+		for (size_t i = 0; i < offsets.size(); i++) {
+			long next = ftell(in);
+			if (fseek(in, offsets[i], SEEK_SET) != 0 || fread(&b, sizeof(b), 1, in) != 1) {
+				fclose(in);
+				return -EIO;
+			}
+			latest[b] = offsets[i];
+			fseek(in, next, SEEK_SET);
+		}
+		last = sh;
+	}
+	if (ret < 0) {
+		fclose(in);
+		return ret;
+	}
+
+	out = fopen(out_path, "wb");
+	if (out == NULL) {
+		ret = -errno;
+		fclose(in);
+		return ret;
+	}
+
+	last.full = 1;
+	buf.resize(ckpt_bucket_bytes(&fh));
+	if (fwrite(&fh, sizeof(fh), 1, out) != 1 || fwrite(&last, sizeof(last), 1, out) != 1)
+		goto write_fail;
+
+	for (b = 0; b < fh.num_buckets; b++) {
+		if (latest[b] < 0)
+			continue;
+		uint32_t index;
+		if (ckpt_read_record(in, &fh, latest[b], &index, &buf[0]) < 0)
+			goto write_fail;
+		if (fwrite(&b, sizeof(b), 1, out) != 1 || fwrite(&buf[0], buf.size(), 1, out) != 1)
+			goto write_fail;
+		++count;
+	}
+
+	end[0] = k_CKPT_END;
+	end[1] = count;
+	if (fwrite(end, sizeof(end), 1, out) != 1)
+		goto write_fail;
+
+	fclose(in);
+	return ckpt_finish(out) < 0 ? -EIO : (int)count;
+
+write_fail:
+	fclose(in);
+	fclose(out);
+	return -EIO;
+}
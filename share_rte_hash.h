@@ -17,12 +17,27 @@
 
 
 #ifndef _SHARE_RTE_HASH_H_
-#define _ShARE_RTE_HASH_H_
+#define _SHARE_RTE_HASH_H_
 
 #include <iostream>
+#include <string.h>
 #include <rte_hash.h>
 #include <rte_rwlock.h>
 #include <rte_memcpy.h>         /* for definition of CACHE_LINE_SIZE */
+#include <rte_prefetch.h>
+#include <rte_atomic.h>
+#include <rte_lcore.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "key_traits.h"
+#include "share_rwlock.h"
+
+/* Bytes of a segment of a k_FLAG_SEGMENTED table at most */
+#ifndef SHARE_HASH_SEGMENT_SIZE
+#define SHARE_HASH_SEGMENT_SIZE (1 << 26)
+#endif
 
 /* Macro to enable/disable run-time checking of function parameters */
 #if defined(RTE_LIBRTE_HASH_DEBUG)
@@ -33,11 +48,118 @@
 #define RETURN_IF_TRUE(cond, retval)
 #endif
 
+/*
+ * Live entries added minus entries removed by one lcore. Only that lcore
+ * writes it, the sum over all lcores is the number of live entries.
+ */
+struct share_rte_hash_counter {
+    volatile int32_t used;
+} __rte_cache_aligned;
+
+/*
+ * A record of the change log. seq is 0 while the record is written, then
+ * its sequence number. The key/value bytes of the entry follow it.
+ */
+struct share_rte_hash_change {
+    volatile uint64_t seq;
+    uint32_t op;                /* ShareRteHash::k_CHANGE_* */
+    uint32_t signature;
+    uint32_t index;             /* slot of the entry */
+    uint32_t reserved;
+};
+
+/* Head of the change log allocated as CL_<name>, the records follow it */
+struct share_rte_hash_changelog {
+    volatile uint64_t head;     /* next sequence number, the first one is 1 */
+    uint32_t capacity;          /* records, a power of 2 */
+    uint32_t record_size;
+} __rte_cache_aligned;
+
+/*
+ * An entry of the table catalog, see ShareRteHash::attach_hash_table.
+ * version is odd while the entry is written.
+ */
+struct share_rte_hash_catalog_entry {
+    volatile uint32_t version;
+    uint32_t state;             /* ShareRteHash::k_CATALOG_* */
+    uint32_t name_hash;
+    uint32_t reserved;
+    uint64_t fingerprint;       /* of the key/value types, 0 if not given */
+    struct rte_hash *table;
+    char name[64];              /* ShareRteHash::k_CATALOG_NAMESIZE */
+} __rte_cache_aligned;
+
+/* Head of the catalog zone, the entries follow it */
+struct share_rte_hash_catalog {
+    volatile uint32_t magic;    /* set once the entries are initialized */
+    uint32_t capacity;          /* entries, a power of 2 */
+    uint32_t used;              /* entries ever used, deleted ones included */
+} __rte_cache_aligned;
+
+/*
+ * A slot and the generation of the entry in it, see
+ * ShareRteHash::k_FLAG_GENERATIONS.
+ */
+struct share_rte_hash_handle {
+    int32_t  index;
+    uint32_t generation;
+};
+
+/* Extra table state, stored in the HT_ zone just after struct rte_hash */
+struct share_rte_hash_ext {
+    uint32_t flags;
+    volatile uint32_t initializing;     /* see k_FLAG_PARALLEL_INIT */
+
+    /* Cached at create time, they are the same in every process */
+    void              *bucket_locks;    /* lock type given by the flags */
+    volatile uint32_t *bucket_versions;
+    uint64_t          *filter;          /* with k_FLAG_FILTER */
+    uint32_t           filter_shift;    /* log2 of the filter blocks of a bucket */
+    struct share_rte_hash_changelog *changelog;    /* see enable_changelog */
+    volatile uint64_t *dirty;           /* with k_FLAG_DIRTY_TRACKING, a bit per bucket */
+
+    /* With k_FLAG_SEGMENTED, see ShareRteHash::get_sig_tbl_bucket */
+    uint8_t          **segments;
+    uint32_t           segment_shift;       /* log2 of the buckets of a segment */
+    uint32_t           segment_entry_shift; /* log2 of the entries of a segment */
+    uint32_t           segment_kv_offset;   /* offset of the key/value buckets */
+    uint32_t           segment_gen_offset;  /* offset of the generations */
+
+    volatile uint32_t *generations;     /* with k_FLAG_GENERATIONS, unless segmented */
+
+    /* One per lcore, the last one is shared by the threads which aren't lcores */
+    struct share_rte_hash_counter counters[RTE_MAX_LCORE + 1];
+};
+
+struct share_runtime_geometry;
+
+/* Bytes used by a table, see ShareRteHash::get_footprint */
+struct share_rte_hash_footprint {
+    uint64_t ht_bytes;          /* HT_ : rte_hash and share_rte_hash_ext */
+    uint64_t sig_bytes;         /* SIG_ : signature table */
+    uint64_t lock_bytes;        /* SIG_ : bucket locks */
+    uint64_t version_bytes;     /* SIG_ : bucket versions */
+    uint64_t filter_bytes;      /* SIG_ : negative lookup filter */
+    uint64_t dirty_bytes;       /* SIG_ : dirty bucket bitmap */
+    uint64_t segment_bytes;     /* SIG_ : segment table, the segments count as sig and kv */
+    uint64_t generation_bytes;  /* SIG_ or SEG_ : slot generations */
+    uint64_t kv_bytes;          /* KV_ : key/value table */
+    uint64_t log_bytes;         /* CL_ : change log */
+    uint64_t total_bytes;
+    uint32_t slot_bytes;        /* bytes of a key/value slot */
+    uint32_t segments;          /* SEG_ : with k_FLAG_SEGMENTED */
+    uint32_t key_value_len;     /* useful bytes of a key/value pair */
+    uint32_t live_entries;
+    double   bytes_per_entry;   /* total_bytes / live_entries */
+    double   overhead_ratio;    /* total_bytes / useful bytes of live entries */
+};
+
 class ShareRteHash {
     public:
         typedef uint32_t hash_sig_t;
 
         static const uint32_t k_RTE_HASH_ENTRIES_MAX          = (1 << 26);
+        static const uint32_t k_RTE_HASH_ENTRIES_MAX_SEGMENTED = (1U << 31);
         static const uint32_t k_RTE_HASH_BUCKET_ENTRIES_MAX   = 1024;
         static const uint32_t k_RTE_HASH_KEY_VALUE_LENGTH_MAX = 128;
         static const uint32_t k_RTE_HASH_NAMESIZE             = 32; 
@@ -51,172 +173,1080 @@ class ShareRteHash {
         /* The high bit is always set in real signatures */
         static const uint32_t k_NULL_SIGNATURE = 0;
 
+        /* A retired slot never matches a lookup but can't be reused yet */
+        static const uint32_t k_RETIRED_SIGNATURE = 1;
+
+        /* A slot claimed by a lock-free writer, see pending_signature */
+        static const uint32_t k_BUSY_SIGNATURE = 2;
+
+        /*
+         * The low bits of a bucket version count the writers in progress,
+         * the high bits the writes done. Readers wait until no writer is
+         * in progress and retry if the version changed meanwhile. Lock-free
+         * writers overlap, so a single odd/even bit wouldn't tell.
+         */
+        static const uint32_t k_VERSION_WRITERS = 0xffff;
+        static const uint32_t k_VERSION_WRITE_DONE = 0x10000;
+
+        /* Signatures compared at once when scanning a bucket */
+        static const uint32_t k_SCAN_WIDTH = 4;
+
     public:
+        /* Table flags, given to create_hash_table */
+
+        /*
+         * All mutations come from one writer lcore. Writers don't take the
+         * bucket locks and readers use the bucket versions instead.
+         */
+        static const uint32_t k_FLAG_SINGLE_WRITER = 0x1;
+
+        /*
+         * Key/value slots keep the natural size of the pair instead of a
+         * multiple of k_KEY_ALIGNMENT. A slot may then cross a cache line.
+         */
+        static const uint32_t k_FLAG_PACKED = 0x2;
+
+        /*
+         * Bucket lock type, rte_rwlock when neither is given. See
+         * share_rwlock.h: the phase-fair lock bounds the wait of both
+         * readers and writers, the writer-preferring one lets at most
+         * k_WP_READER_BUDGET readers pass a waiting writer.
+         */
+        static const uint32_t k_FLAG_LOCK_PHASE_FAIR = 0x4;
+        static const uint32_t k_FLAG_LOCK_WRITER_PREF = 0x8;
+        static const uint32_t k_FLAG_LOCK_MASK = k_FLAG_LOCK_PHASE_FAIR | k_FLAG_LOCK_WRITER_PREF;
+
+        static const uint32_t k_WP_READER_BUDGET = 8;
+
+        /*
+         * Keep a counting blocked Bloom filter of the signatures, which
+         * lookups check before taking the bucket lock. Most misses then cost
+         * one cache line, but hits read that line too: it pays off when
+         * most lookups miss. Every bucket has its own filter blocks, updated
+         * under the bucket lock like the signatures, so no atomics are
+         * needed. A counter stays stuck at k_FILTER_COUNTER_MAX until
+         * rebuild_filter_bucket recounts the bucket.
+         */
+        static const uint32_t k_FLAG_FILTER = 0x10;
+
+        static const uint32_t k_FILTER_HASHES = 4;
+        static const uint32_t k_FILTER_BLOCK_WORDS = 8;         /* 64 bytes, 128 counters of 4 bits */
+        static const uint32_t k_FILTER_ENTRIES_PER_BLOCK = 8;
+        static const uint32_t k_FILTER_COUNTER_MAX = 15;
+
+        /*
+         * Set a bit for every bucket modified since the last checkpoint, so
+         * that checkpoint_table writes only those buckets.
+         */
+        static const uint32_t k_FLAG_DIRTY_TRACKING = 0x20;
+
+        /*
+         * Inserts and deletes take no bucket lock. An insert claims a free
+         * slot by a compare-and-swap to the pending signature of its key,
+         * writes the entry and then publishes its signature. When two
+         * inserts of one key race, the copy in the lowest slot stays and
+         * the others are freed. A delete takes the slot of its key the same
+         * way, logs it, then frees it. An insert waits while a slot of its
+         * bucket is pending for the same signature, so the changes of a key
+         * are logged in order; a writer stopped in between blocks only the
+         * inserts of that signature in the bucket.
+         *
+         * Writers count themselves in the bucket version while they change
+         * a slot, so readers retry on it like with k_FLAG_SINGLE_WRITER.
+         * update_value, erase_if and clear still take the bucket lock; an
+         * update racing an erase of the same key may touch the slot after
+         * it was reused, so a key should be updated by its owner only.
+         * Can't be used with k_FLAG_FILTER, whose counters aren't atomic,
+         * nor with k_FLAG_SINGLE_WRITER.
+         */
+        static const uint32_t k_FLAG_LOCK_FREE = 0x40;
+
+        /*
+         * Split the signature and key/value tables into segments of at most
+         * k_SEGMENT_SIZE bytes, allocated one by one, so that a table needs
+         * no large contiguous run of hugepages and may hold up to
+         * k_RTE_HASH_ENTRIES_MAX_SEGMENTED entries. A segment holds a power
+         * of 2 buckets, its signature buckets then its key/value buckets,
+         * so the segment of a bucket or of a position is given by its high
+         * bits. Positions stay below 2^31 and fit the int32_t returned by
+         * the lookups. Can't be used with k_FLAG_FILTER.
+         */
+        static const uint32_t k_FLAG_SEGMENTED = 0x80;
+
+        static const uint32_t k_SEGMENT_SIZE = SHARE_HASH_SEGMENT_SIZE;
+
+        /*
+         * Keep a generation for every slot, odd while the slot holds an
+         * entry, which changes when the entry is added and when it is
+         * removed. A share_rte_hash_handle of an entry, its position and
+         * generation, stays valid until the entry is removed, whatever
+         * reuses the slot afterwards, and is checked by reading the
+         * generation of the slot. The slot is never reused before its
+         * generation changed. After 2^31 reuses of a slot a stale handle
+         * would match again.
+         */
+        static const uint32_t k_FLAG_GENERATIONS = 0x100;
+
+        /*
+         * Allocate the table without zeroing it, then zero it and set up
+         * its bucket locks on the calling lcore and the idle slave lcores of
+         * its socket at once, instead of zeroing gigabytes on one lcore.
+         * Off the master lcore the calling lcore does it all.
+         *
+         * The table is registered in the tailq under the tailq lock, which
+         * is then dropped while the table is set up. Until it is added to
+         * the catalog the table is marked initializing: create_hash_table
+         * of the same name waits for it, attach_hash_table fails with
+         * EAGAIN.
+         */
+        static const uint32_t k_FLAG_PARALLEL_INIT = 0x200;
+
+        /*
+         * The catalog is a memzone shared by all the tables, a hash of their
+         * names probed linearly. Processes find a table there with a few
+         * reads, without the tailq lock, and the fingerprint of its types.
+         * An entry never moves; a freed table leaves it k_CATALOG_DELETED.
+         */
+        static const uint32_t k_CATALOG_ENTRIES = 1024;
+        static const uint32_t k_CATALOG_NAMESIZE = 64;
+        static const uint32_t k_CATALOG_FREE = 0;
+        static const uint32_t k_CATALOG_USED = 1;
+        static const uint32_t k_CATALOG_DELETED = 2;
+
+        /* Keys of one call of the *_bulk functions */
+        static const uint32_t k_BULK_MAX = 64;
+
+        /* Operations of the change log records */
+        static const uint32_t k_CHANGE_ADD = 1;
+        static const uint32_t k_CHANGE_DEL = 2;
+        static const uint32_t k_CHANGE_UPDATE = 3;
+
+    public:
+        /*
+         * The engine functions take the bucket geometry as first template
+         * parameter, see share_runtime_geometry and share_fixed_geometry.
+         * The functions without it use the run-time geometry.
+         */
         template<typename _KeyValue>
         int32_t add_key_value_with_hash(const rte_hash *h, const _KeyValue *key_value, hash_sig_t sig)
+        {
+            return add_key_value_with_hash<share_runtime_geometry>(h, key_value, sig);
+        }
+
+        template<typename _KeyValue>
+        int32_t del_key_value_with_hash(const rte_hash *h, const _KeyValue *key_value, hash_sig_t sig)
+        {
+            return del_key_value_with_hash<share_runtime_geometry>(h, key_value, sig);
+        }
+
+        template<typename _KeyValue>
+        int32_t lookup_with_hash(const rte_hash *h, const _KeyValue *key_value, hash_sig_t sig)
+        {
+            return lookup_with_hash<share_runtime_geometry>(h, key_value, sig);
+        }
+
+        template<typename _KeyValue, typename _Modifier>
+        bool update_value_with_hash(const rte_hash *h, const _KeyValue *key_value,
+                                    hash_sig_t sig, _Modifier update)
+        {
+            return update_value_with_hash<share_runtime_geometry>(h, key_value, sig, update);
+        }
+
+        template<typename _KeyValue>
+        void get_value_with_index(_KeyValue *& ret, const rte_hash *h, int32_t index)
+        {
+            get_value_with_index<share_runtime_geometry>(ret, h, index);
+        }
+
+        template<typename _Geometry, typename _KeyValue>
+        int32_t add_key_value_with_hash(const rte_hash *h, const _KeyValue *key_value, hash_sig_t sig)
         {
         	RETURN_IF_TRUE(((h == NULL) || (key_value == NULL)), -EINVAL);
         
-        	hash_sig_t *sig_bucket;
-        	uint8_t *key_bucket;
-        	uint32_t bucket_index, i;
-        	int32_t pos;
-            int32_t ret = -ENOSPC;
+        	uint32_t bucket_index;
+            int32_t ret;
         
         	/* Get the hash signature and bucket index */
-        	sig |= h->sig_msb;
+        	sig |= _Geometry::sig_msb(h);
         	bucket_index = sig & h->bucket_bitmask;
-        	sig_bucket = get_sig_tbl_bucket(h, bucket_index);
-        	key_bucket = get_key_tbl_bucket(h, bucket_index);
+
+            if (is_lock_free(h)) {
+                copy_key_value<_KeyValue> fill = {key_value};
+                return add_key_cas<_Geometry, _KeyValue>(h, key_value->k, sig, bucket_index, fill);
+            }
 
             /* Do lock */
-            rte_rwlock_t * bucket_lock = get_bucket_lock(h, bucket_index);
-            rte_rwlock_write_lock(bucket_lock);
-        
-        	/* Check if key is already present in the hash */
-        	for (i = 0; i < h->bucket_entries; i++) {
-        		if (sig == sig_bucket[i]) {
-                    _KeyValue * tmp = static_cast<_KeyValue*>(get_key_from_bucket(h, key_bucket, i));
-                    if (tmp && (key_value->k == tmp->k)) {
-        			    ret = bucket_index * h->bucket_entries + i;
-                        goto exit;
-                    }
-        		}
-        	}
-        
-        	/* Check if any free slot within the bucket to add the new key */
-        	pos = find_first(k_NULL_SIGNATURE, sig_bucket, h->bucket_entries);
-        
-        	if (pos < 0)
-                goto exit;
-        
-        	/* Add the new key to the bucket */
-        	sig_bucket[pos] = sig;
-        	rte_memcpy(get_key_from_bucket(h, key_bucket, pos), key_value, h->key_len);
-        	ret = bucket_index * h->bucket_entries + pos;
+            bucket_write_lock(h, bucket_index);
 
-exit:
-            rte_rwlock_write_unlock(bucket_lock);
+            ret = add_key_value_nolock<_Geometry>(h, key_value, sig, bucket_index);
+
+            bucket_write_unlock(h, bucket_index);
             return ret;
         }
 
-        template<typename _KeyValue>
+        /*
+         * Add a key whose value is built in its slot by init(value), under
+         * the bucket lock. The value holds the bytes of a former entry
+         * until init sets it. If the key is present already, init isn't
+         * called and its position is returned, like add_key_value_with_hash.
+         */
+        template<typename _Geometry, typename _KeyValue, typename _Key, typename _Initializer>
+        int32_t add_key_in_place_with_hash(const rte_hash *h, const _Key & key, hash_sig_t sig,
+                                           _Initializer & init)
+        {
+            RETURN_IF_TRUE((h == NULL), -EINVAL);
+
+            uint32_t bucket_index;
+            int32_t ret;
+
+            sig |= _Geometry::sig_msb(h);
+            bucket_index = sig & h->bucket_bitmask;
+
+            if (is_lock_free(h)) {
+                build_key_value<_KeyValue, _Key, _Initializer> fill = {key, init};
+                return add_key_cas<_Geometry, _KeyValue>(h, key, sig, bucket_index, fill);
+            }
+
+            bucket_write_lock(h, bucket_index);
+            ret = add_key_in_place_nolock<_Geometry, _KeyValue>(h, key, sig, bucket_index, init);
+            bucket_write_unlock(h, bucket_index);
+            return ret;
+        }
+
+        template<typename _Geometry, typename _KeyValue>
         int32_t del_key_value_with_hash(const rte_hash *h, const _KeyValue *key_value, hash_sig_t sig)
+        {
+            return remove_key_value_with_hash<_Geometry>(h, key_value, sig, k_NULL_SIGNATURE);
+        }
+
+        /*
+         * Like del_key_value_with_hash, but the slot is only marked retired.
+         * The caller hands the returned position to reclaim_slot once no
+         * reader can still be looking at it.
+         */
+        template<typename _Geometry, typename _KeyValue>
+        int32_t retire_key_value_with_hash(const rte_hash *h, const _KeyValue *key_value, hash_sig_t sig)
+        {
+            return remove_key_value_with_hash<_Geometry>(h, key_value, sig, k_RETIRED_SIGNATURE);
+        }
+
+        /* Make a retired slot free again */
+        void reclaim_slot(const rte_hash *h, uint32_t index)
+        {
+            uint32_t bucket_index = index / h->bucket_entries;
+            hash_sig_t *sig_bucket = get_sig_tbl_bucket<share_runtime_geometry>(h, bucket_index);
+
+            bucket_write_lock(h, bucket_index);
+
+            if (sig_bucket[index % h->bucket_entries] == k_RETIRED_SIGNATURE) {
+                volatile uint32_t * version = get_bucket_version(h, bucket_index);
+                bucket_write_begin(h, version);
+                sig_bucket[index % h->bucket_entries] = k_NULL_SIGNATURE;
+                bucket_write_end(h, version);
+            }
+
+            bucket_write_unlock(h, bucket_index);
+        }
+
+        /* Remove a key, its slot gets signature free_sig */
+        template<typename _Geometry, typename _KeyValue>
+        int32_t remove_key_value_with_hash(const rte_hash *h, const _KeyValue *key_value, hash_sig_t sig,
+                                           hash_sig_t free_sig)
         {
         	RETURN_IF_TRUE(((h == NULL) || (key_value == NULL)), -EINVAL);
         
-        	hash_sig_t *sig_bucket;
-        	uint8_t *key_bucket;
-        	uint32_t bucket_index, i;
-            int32_t  ret = -ENOENT;
+        	uint32_t bucket_index;
+            int32_t  ret;
         
         	/* Get the hash signature and bucket index */
-        	sig = sig | h->sig_msb;
+        	sig = sig | _Geometry::sig_msb(h);
         	bucket_index = sig & h->bucket_bitmask;
-        	sig_bucket = get_sig_tbl_bucket(h, bucket_index);
-        	key_bucket = get_key_tbl_bucket(h, bucket_index);
+
+            if (is_lock_free(h))
+                return del_key_cas<_Geometry>(h, key_value, sig, bucket_index, free_sig);
 
             /* Do lock */
-            rte_rwlock_t * bucket_lock = get_bucket_lock(h, bucket_index);
-            rte_rwlock_write_lock(bucket_lock);
-        
-        	/* Check if key is already present in the hash */
-        	for (i = 0; i < h->bucket_entries; i++) {
-        		if (sig == sig_bucket[i]) {
-                    _KeyValue *tmp = static_cast<_KeyValue*>(get_key_from_bucket(h, key_bucket, i));
-                    if (tmp && (key_value->k == tmp->k)) {
-        			    sig_bucket[i] = k_NULL_SIGNATURE;
-        			    ret = bucket_index * h->bucket_entries + i;
-                        goto exit;
-                    }
-        		}
-        	}
-        
-exit:
-            rte_rwlock_write_unlock(bucket_lock);
-        	return ret;
+            bucket_write_lock(h, bucket_index);
+
+            ret = del_key_value_nolock<_Geometry>(h, key_value, sig, bucket_index, free_sig);
+
+            bucket_write_unlock(h, bucket_index);
+            return ret;
         }
 
-        template<typename _KeyValue>
+        template<typename _Geometry, typename _KeyValue>
         int32_t lookup_with_hash(const rte_hash *h, const _KeyValue *key_value, hash_sig_t sig)
         {
         	RETURN_IF_TRUE(((h == NULL) || (key_value == NULL)), -EINVAL);
         
-        	hash_sig_t *sig_bucket;
-        	uint8_t *key_bucket;
-        	uint32_t bucket_index, i;
-            int32_t ret = -ENOENT;
+        	uint32_t bucket_index;
+            int32_t ret;
         
         	/* Get the hash signature and bucket index */
-        	sig |= h->sig_msb;
+        	sig |= _Geometry::sig_msb(h);
         	bucket_index = sig & h->bucket_bitmask;
-        	sig_bucket = get_sig_tbl_bucket(h, bucket_index);
-        	key_bucket = get_key_tbl_bucket(h, bucket_index);
+
+            if (has_filter(h) && !filter_may_contain(h, sig, bucket_index))
+                return -ENOENT;
+
+            /* Without reader locks, retry until the bucket version is stable */
+            if (has_lockless_readers(h))
+                return lookup_versioned<_Geometry>(h, key_value, sig, bucket_index);
 
             /* Do lock */
-            rte_rwlock_t * bucket_lock = get_bucket_lock(h, bucket_index);
-            rte_rwlock_read_lock(bucket_lock);
+            bucket_read_lock(h, bucket_index);
         
-        	/* Check if key is already present in the hash */
-        	for (i = 0; i < h->bucket_entries; i++) {
-        		if (sig == sig_bucket[i]) {
-                    _KeyValue *tmp = static_cast<_KeyValue*>(get_key_from_bucket(h, key_bucket, i));
-                    if (tmp && (key_value->k == tmp->k)) {
-                        ret = bucket_index * h->bucket_entries + i;
-                        goto exit;
-                    }
-        		}
-        	}
-exit:
-            rte_rwlock_read_unlock(bucket_lock);
-        	return ret;
+            ret = lookup_nolock<_Geometry>(h, key_value, sig, bucket_index);
+
+            bucket_read_unlock(h, bucket_index);
+            return ret;
         }
 
-        template<typename _KeyValue>
+        /*
+         * Like lookup_with_hash, but never takes the bucket read lock,
+         * whatever the flags: every writer changes the bucket version, so
+         * the scan is retried until the version is stable. The position
+         * found is only as durable as the caller makes it, e.g. a ShareQsbr
+         * reader whose entries are erased by retiring their slots.
+         */
+        template<typename _Geometry, typename _KeyValue>
+        int32_t lookup_lockless_with_hash(const rte_hash *h, const _KeyValue *key_value, hash_sig_t sig)
+        {
+            RETURN_IF_TRUE(((h == NULL) || (key_value == NULL)), -EINVAL);
+
+            uint32_t bucket_index;
+
+            sig |= _Geometry::sig_msb(h);
+            bucket_index = sig & h->bucket_bitmask;
+
+            if (has_filter(h) && !filter_may_contain(h, sig, bucket_index))
+                return -ENOENT;
+
+            return lookup_versioned<_Geometry>(h, key_value, sig, bucket_index);
+        }
+
+        template<typename _Geometry, typename _KeyValue>
         void get_value_with_index(_KeyValue *& ret, const rte_hash *h, int32_t index)
         {
-            ret = static_cast<_KeyValue*>(get_key_with_index(h, index));
+            ret = static_cast<_KeyValue*>(get_key_with_index<_Geometry>(h, index));
         }
 
-        template<typename _KeyValue, typename _Modifier>
+        template<typename _Geometry, typename _KeyValue, typename _Modifier>
         bool update_value_with_hash(const rte_hash *h, const _KeyValue *key_value,
                                     hash_sig_t sig, _Modifier update)
         {
         	RETURN_IF_TRUE(((h == NULL) || (key_value == NULL)), NULL);
         
-        	hash_sig_t *sig_bucket;
-        	uint8_t *key_bucket;
-        	uint32_t bucket_index, i;
-            bool ret = false;
+        	uint32_t bucket_index;
+            bool ret;
         
         	/* Get the hash signature and bucket index */
-        	sig |= h->sig_msb;
+        	sig |= _Geometry::sig_msb(h);
         	bucket_index = sig & h->bucket_bitmask;
-        	sig_bucket = get_sig_tbl_bucket(h, bucket_index);
-        	key_bucket = get_key_tbl_bucket(h, bucket_index);
         
             /* Do lock */
-            rte_rwlock_t * bucket_lock = get_bucket_lock(h, bucket_index);
-            rte_rwlock_write_lock(bucket_lock);
-
-        	/* Check if key is already present in the hash */
-        	for (i = 0; i < h->bucket_entries; i++) {
-        		if (sig == sig_bucket[i]) {
-                    _KeyValue * tmp = static_cast<_KeyValue*>(get_key_from_bucket(h, key_bucket, i));
-                    if (tmp && (key_value->k == tmp->k)) {
-                        // Find this key
-                        update(tmp->v, key_value->v);
-                        ret = true;
-                        goto exit;
+            bucket_write_lock(h, bucket_index);
+
+            ret = update_value_nolock<_Geometry>(h, key_value, sig, bucket_index, update);
+
+            bucket_write_unlock(h, bucket_index);
+            return ret;
+        }
+
+        /*
+         * Bulk versions of the functions above, for up to k_BULK_MAX keys
+         * with their signatures. The keys are grouped by bucket and each
+         * bucket is locked once for its group; keys of one bucket are
+         * handled in their order. results[i] is what the single key
+         * function returns for key i.
+         */
+        template<typename _Geometry, typename _KeyValue>
+        void add_key_value_bulk(const rte_hash *h, const _KeyValue *key_values, const hash_sig_t *sigs,
+                                uint32_t n, int32_t *results)
+        {
+            hash_sig_t sig[k_BULK_MAX];
+            uint32_t bucket[k_BULK_MAX], order[k_BULK_MAX];
+            uint32_t i, j, k, b;
+            bool lock_free = is_lock_free(h);
+
+            group_bulk<_Geometry>(h, sigs, n, sig, bucket, order);
+            for (i = 0; i < n; i = j) {
+                b = bucket[order[i]];
+                if (!lock_free)
+                    bucket_write_lock(h, b);
+                for (j = i; j < n && bucket[order[j]] == b; j++) {
+                    k = order[j];
+                    if (lock_free) {
+                        copy_key_value<_KeyValue> fill = {&key_values[k]};
+                        results[k] = add_key_cas<_Geometry, _KeyValue>(h, key_values[k].k, sig[k], b, fill);
+                    } else {
+                        results[k] = add_key_value_nolock<_Geometry>(h, &key_values[k], sig[k], b);
                     }
-        		}
-        	}
-        
-exit:
-            rte_rwlock_write_unlock(bucket_lock);
+                }
+                if (!lock_free)
+                    bucket_write_unlock(h, b);
+            }
+        }
+
+        template<typename _Geometry, typename _KeyValue>
+        void del_key_value_bulk(const rte_hash *h, const _KeyValue *key_values, const hash_sig_t *sigs,
+                                uint32_t n, int32_t *results)
+        {
+            hash_sig_t sig[k_BULK_MAX];
+            uint32_t bucket[k_BULK_MAX], order[k_BULK_MAX];
+            uint32_t i, j, k, b;
+            bool lock_free = is_lock_free(h);
+
+            group_bulk<_Geometry>(h, sigs, n, sig, bucket, order);
+            for (i = 0; i < n; i = j) {
+                b = bucket[order[i]];
+                if (!lock_free)
+                    bucket_write_lock(h, b);
+                for (j = i; j < n && bucket[order[j]] == b; j++) {
+                    k = order[j];
+                    if (lock_free)
+                        results[k] = del_key_cas<_Geometry>(h, &key_values[k], sig[k], b, k_NULL_SIGNATURE);
+                    else
+                        results[k] = del_key_value_nolock<_Geometry>(h, &key_values[k], sig[k], b,
+                                                                     k_NULL_SIGNATURE);
+                }
+                if (!lock_free)
+                    bucket_write_unlock(h, b);
+            }
+        }
+
+        template<typename _Geometry, typename _KeyValue, typename _Modifier>
+        void update_value_bulk(const rte_hash *h, const _KeyValue *key_values, const hash_sig_t *sigs,
+                               uint32_t n, _Modifier update, bool *results)
+        {
+            hash_sig_t sig[k_BULK_MAX];
+            uint32_t bucket[k_BULK_MAX], order[k_BULK_MAX];
+            uint32_t i, j, k, b;
+
+            group_bulk<_Geometry>(h, sigs, n, sig, bucket, order);
+            for (i = 0; i < n; i = j) {
+                b = bucket[order[i]];
+                bucket_write_lock(h, b);
+                for (j = i; j < n && bucket[order[j]] == b; j++) {
+                    k = order[j];
+                    results[k] = update_value_nolock<_Geometry>(h, &key_values[k], sig[k], b, update);
+                }
+                bucket_write_unlock(h, b);
+            }
+        }
+
+        /*
+         * Call fold(key_value) for every entry of the buckets [first, last),
+         * for table-wide aggregates. Under the bucket read lock, free slots
+         * are skipped k_SCAN_WIDTH signatures at a time. Without reader
+         * locks each entry is copied out under the bucket version, like
+         * walk_bucket does, so key_value must not be kept after fold returns.
+         */
+        template<typename _Geometry, typename _KeyValue, typename _Fold>
+        void fold_buckets(const rte_hash *h, uint32_t first, uint32_t last, _Fold & fold)
+        {
+            uint32_t entries = _Geometry::bucket_entries(h);
+            uint32_t b, i, mask;
+
+            for (b = first; b < last; b++) {
+                const hash_sig_t *sig_bucket = get_sig_tbl_bucket<_Geometry>(h, b);
+                uint8_t *key_bucket = get_key_tbl_bucket<_Geometry>(h, b);
+
+                if (has_lockless_readers(h)) {
+                    volatile uint32_t * version = get_bucket_version(h, b);
+                    _KeyValue key_value;
+                    hash_sig_t sig;
+                    uint32_t v;
+
+                    for (i = 0; i < entries; i++) {
+                        do {
+                            while ((v = *version) & k_VERSION_WRITERS)
+                                rte_pause();
+                            rte_rmb();
+                            sig = sig_bucket[i];
+                            rte_memcpy(&key_value, get_key_from_bucket<_Geometry>(h, key_bucket, i),
+                                       sizeof(key_value));
+                            rte_rmb();
+                        } while (*version != v);
+
+                        if (sig & _Geometry::sig_msb(h))
+                            fold(&key_value);
+                    }
+                    continue;
+                }
+
+                bucket_read_lock(h, b);
+                for (i = 0; i < entries; i += k_SCAN_WIDTH) {
+                    for (mask = live_signatures(sig_bucket + i, RTE_MIN(k_SCAN_WIDTH, entries - i)); mask;
+                         mask &= mask - 1)
+                        fold(static_cast<const _KeyValue *>(
+                                get_key_from_bucket<_Geometry>(h, key_bucket, i + __builtin_ctz(mask))));
+                }
+                bucket_read_unlock(h, b);
+            }
+        }
+
+        /*
+         * Call visit(key_value, index) for every entry of a bucket.
+         * key_value must not be kept after visit returns.
+         */
+        template<typename _Geometry, typename _KeyValue, typename _Visitor>
+        void walk_bucket(const rte_hash *h, uint32_t bucket_index, _Visitor & visit)
+        {
+            const hash_sig_t *sig_bucket = get_sig_tbl_bucket<_Geometry>(h, bucket_index);
+            uint8_t *key_bucket = get_key_tbl_bucket<_Geometry>(h, bucket_index);
+            uint32_t i;
+
+            /* Without reader locks, copy each entry out under the bucket version */
+            if (has_lockless_readers(h)) {
+                volatile uint32_t * version = get_bucket_version(h, bucket_index);
+                _KeyValue key_value;
+                hash_sig_t sig;
+                uint32_t v;
+
+                for (i = 0; i < _Geometry::bucket_entries(h); i++) {
+                    do {
+                        while ((v = *version) & k_VERSION_WRITERS)
+                            rte_pause();
+                        rte_rmb();
+                        sig = sig_bucket[i];
+                        rte_memcpy(&key_value, get_key_from_bucket<_Geometry>(h, key_bucket, i), sizeof(key_value));
+                        rte_rmb();
+                    } while (*version != v);
+
+                    if (sig & _Geometry::sig_msb(h))
+                        visit(&key_value, bucket_index * _Geometry::bucket_entries(h) + i);
+                }
+                return;
+            }
+
+            bucket_read_lock(h, bucket_index);
+
+            for (i = 0; i < _Geometry::bucket_entries(h); i++) {
+                if (sig_bucket[i] & _Geometry::sig_msb(h))
+                    visit(static_cast<const _KeyValue *>(get_key_from_bucket<_Geometry>(h, key_bucket, i)),
+                          bucket_index * _Geometry::bucket_entries(h) + i);
+            }
+
+            bucket_read_unlock(h, bucket_index);
+        }
+
+        /*
+         * Remove every entry of a bucket for which pred(key_value) is true,
+         * return how many were removed.
+         */
+        template<typename _Geometry, typename _KeyValue, typename _Predicate>
+        uint32_t erase_bucket_if(const rte_hash *h, uint32_t bucket_index, _Predicate & pred)
+        {
+            hash_sig_t *sig_bucket = get_sig_tbl_bucket<_Geometry>(h, bucket_index);
+            uint8_t *key_bucket = get_key_tbl_bucket<_Geometry>(h, bucket_index);
+            volatile uint32_t * version = get_bucket_version(h, bucket_index);
+            bool writing = false;
+            uint32_t i, n = 0;
+
+            bucket_write_lock(h, bucket_index);
+
+            for (i = 0; i < _Geometry::bucket_entries(h); i++) {
+                if (!(sig_bucket[i] & _Geometry::sig_msb(h)))
+                    continue;
+                if (!pred(*static_cast<const _KeyValue *>(get_key_from_bucket<_Geometry>(h, key_bucket, i))))
+                    continue;
+
+                if (!writing) {
+                    bucket_write_begin(h, version);
+                    writing = true;
+                }
+                hash_sig_t sig = sig_bucket[i];
+                if (has_filter(h))
+                    filter_remove(h, sig, bucket_index);
+                log_change(h, k_CHANGE_DEL, sig, bucket_index * _Geometry::bucket_entries(h) + i,
+                           get_key_from_bucket<_Geometry>(h, key_bucket, i));
+                if (release_slot(h, &sig_bucket[i], bucket_index * _Geometry::bucket_entries(h) + i,
+                                 sig, k_NULL_SIGNATURE))
+                    ++n;
+            }
+
+            if (writing) {
+                bucket_write_end(h, version);
+                mark_dirty(h, bucket_index);
+            }
+
+            bucket_write_unlock(h, bucket_index);
+
+            count_entries(h, -(int32_t)n);
+            return n;
+        }
+
+        /* Remove every entry of a bucket, return how many were removed. */
+        template<typename _Geometry>
+        uint32_t clear_bucket(const rte_hash *h, uint32_t bucket_index)
+        {
+            hash_sig_t *sig_bucket = get_sig_tbl_bucket<_Geometry>(h, bucket_index);
+            volatile uint32_t * version = get_bucket_version(h, bucket_index);
+            uint32_t i, n = 0;
+
+            bucket_write_lock(h, bucket_index);
+
+            /* Retired slots are freed too, reclaim_slot ignores them later */
+            bucket_write_begin(h, version);
+            for (i = 0; i < _Geometry::bucket_entries(h); i++) {
+                hash_sig_t sig = sig_bucket[i];
+
+                if (sig & _Geometry::sig_msb(h)) {
+                    log_change(h, k_CHANGE_DEL, sig, bucket_index * _Geometry::bucket_entries(h) + i,
+                               get_key_from_bucket<_Geometry>(h, get_key_tbl_bucket<_Geometry>(h, bucket_index), i));
+                    if (release_slot(h, &sig_bucket[i], bucket_index * _Geometry::bucket_entries(h) + i,
+                                     sig, k_NULL_SIGNATURE))
+                        ++n;
+                } else if (sig == k_RETIRED_SIGNATURE && is_lock_free(h)) {
+                    __sync_bool_compare_and_swap(&sig_bucket[i], sig, k_NULL_SIGNATURE);
+                }
+            }
+            /* A lock-free writer may hold a pending slot */
+            if (!is_lock_free(h))
+                memset(sig_bucket, 0, _Geometry::bucket_entries(h) * sizeof(hash_sig_t));
+            if (has_filter(h))
+                memset(get_filter_bucket(h, bucket_index), 0, filter_bucket_bytes(h));
+            bucket_write_end(h, version);
+            mark_dirty(h, bucket_index);
+
+            bucket_write_unlock(h, bucket_index);
+
+            count_entries(h, -(int32_t)n);
+            return n;
+        }
+
+        /*
+         * Copy the signatures of a bucket to sigs, which has room for
+         * h->bucket_entries values. The bucket is locked only during the
+         * copy. Returns the number of live entries in the bucket.
+         */
+        uint32_t read_bucket_signatures(const rte_hash *h, uint32_t bucket_index, hash_sig_t *sigs)
+        {
+            const hash_sig_t *sig_bucket = get_sig_tbl_bucket<share_runtime_geometry>(h, bucket_index);
+            size_t size = h->bucket_entries * sizeof(hash_sig_t);
+            uint32_t i, n = 0;
+
+            if (has_lockless_readers(h)) {
+                volatile uint32_t * version = get_bucket_version(h, bucket_index);
+                uint32_t v;
+
+                do {
+                    while ((v = *version) & k_VERSION_WRITERS)
+                        rte_pause();
+                    rte_rmb();
+                    memcpy(sigs, sig_bucket, size);
+                    rte_rmb();
+                } while (*version != v);
+            } else {
+                bucket_read_lock(h, bucket_index);
+                memcpy(sigs, sig_bucket, size);
+                bucket_read_unlock(h, bucket_index);
+            }
+
+            for (i = 0; i < h->bucket_entries; i++)
+                if (sigs[i] & h->sig_msb)
+                    ++n;
+            return n;
+        }
+
+        /*
+         * Version of the bucket of sig, once no write is in progress. It
+         * changes whenever the bucket changes, in any process.
+         */
+        uint32_t bucket_version_with_hash(const rte_hash *h, hash_sig_t sig)
+        {
+            volatile uint32_t * version = get_bucket_version(h, (sig | h->sig_msb) & h->bucket_bitmask);
+            uint32_t v;
+
+            while ((v = *version) & k_VERSION_WRITERS)
+                rte_pause();
+            rte_rmb();
+            return v;
+        }
+
+        /*
+         * Like lookup_with_hash, and fill a handle of the entry found, read
+         * along with the key. Returns -ENOTSUP without k_FLAG_GENERATIONS.
+         */
+        template<typename _Geometry, typename _KeyValue>
+        int32_t lookup_handle_with_hash(const rte_hash *h, const _KeyValue *key_value, hash_sig_t sig,
+                                        share_rte_hash_handle *handle)
+        {
+            uint32_t bucket_index;
+            int32_t ret;
+
+            if (!has_generations(h))
+                return -ENOTSUP;
+
+            sig |= _Geometry::sig_msb(h);
+            bucket_index = sig & h->bucket_bitmask;
+
+            if (has_filter(h) && !filter_may_contain(h, sig, bucket_index))
+                return -ENOENT;
+
+            if (has_lockless_readers(h)) {
+                volatile uint32_t * version = get_bucket_version(h, bucket_index);
+                uint32_t v;
+
+                do {
+                    while ((v = *version) & k_VERSION_WRITERS)
+                        rte_pause();
+                    rte_rmb();
+                    ret = lookup_nolock<_Geometry>(h, key_value, sig, bucket_index);
+                    if (ret >= 0)
+                        handle->generation = *get_generation(h, ret);
+                    rte_rmb();
+                } while (*version != v);
+            } else {
+                bucket_read_lock(h, bucket_index);
+                ret = lookup_nolock<_Geometry>(h, key_value, sig, bucket_index);
+                if (ret >= 0)
+                    handle->generation = *get_generation(h, ret);
+                bucket_read_unlock(h, bucket_index);
+            }
+
+            handle->index = ret;
             return ret;
         }
 
+        /*
+         * The handle may name an entry of the table: there are generations,
+         * the index is a slot and the generation one of a held slot. A
+         * default or failed handle, or one of a larger table, is not.
+         */
+        inline bool handle_in_table(const rte_hash *h, const share_rte_hash_handle & handle)
+        {
+            return has_generations(h) && handle.index >= 0 && (uint32_t)handle.index < h->entries &&
+                   (handle.generation & 1) != 0;
+        }
+
+        /* The entry of a handle is still there. One load, no lock. */
+        inline bool handle_valid(const rte_hash *h, const share_rte_hash_handle & handle)
+        {
+            return handle_in_table(h, handle) && *get_generation(h, handle.index) == handle.generation;
+        }
+
+        /*
+         * Copy the entry of a handle, as it is at one moment. Returns false
+         * if the entry was removed or the handle isn't one of the table.
+         */
+        template<typename _Geometry, typename _KeyValue>
+        bool read_with_handle(const rte_hash *h, const share_rte_hash_handle & handle, _KeyValue *key_value)
+        {
+            volatile uint32_t * generation;
+            volatile uint32_t * version;
+            uint32_t v;
+
+            if (!handle_in_table(h, handle))
+                return false;
+
+            generation = get_generation(h, handle.index);
+            version = get_bucket_version(h, (uint32_t)handle.index / _Geometry::bucket_entries(h));
+            do {
+                while ((v = *version) & k_VERSION_WRITERS)
+                    rte_pause();
+                rte_rmb();
+                if (*generation != handle.generation)
+                    return false;
+                rte_memcpy(key_value, get_key_with_index<_Geometry>(h, handle.index), sizeof(_KeyValue));
+                rte_rmb();
+            } while (*version != v);
+
+            return *generation == handle.generation;
+        }
+
+        /*
+         * Recount the filter blocks of a bucket from its signatures, which
+         * frees the saturated counters. Each word is replaced at once and
+         * both the old and the new one count every live entry, so lookups
+         * go on meanwhile.
+         */
+        void rebuild_filter_bucket(const rte_hash *h, uint32_t bucket_index)
+        {
+            const hash_sig_t *sig_bucket = get_sig_tbl_bucket<share_runtime_geometry>(h, bucket_index);
+            uint64_t *blocks = get_filter_bucket(h, bucket_index);
+            uint32_t words = filter_bucket_bytes(h) / sizeof(uint64_t);
+            uint64_t counts[(k_RTE_HASH_BUCKET_ENTRIES_MAX / k_FILTER_ENTRIES_PER_BLOCK) * k_FILTER_BLOCK_WORDS];
+            uint32_t i;
+
+            if (!has_filter(h))
+                return;
+
+            bucket_write_lock(h, bucket_index);
+
+            memset(counts, 0, words * sizeof(uint64_t));
+            for (i = 0; i < h->bucket_entries; i++)
+                if (sig_bucket[i] & h->sig_msb)
+                    filter_count(counts, get_hash_ext(h)->filter_shift, sig_bucket[i], 1);
+            for (i = 0; i < words; i++)
+                blocks[i] = counts[i];
+
+            bucket_write_unlock(h, bucket_index);
+        }
+
+        /* Sequence number of the next change log record, 0 without a log */
+        uint64_t changelog_head(const rte_hash *h)
+        {
+            const share_rte_hash_changelog *log = get_hash_ext(h)->changelog;
+            return log ? log->head : 0;
+        }
+
+        /*
+         * Copy the change log record seq to change, and its h->key_len bytes
+         * of key/value to key_value. Returns 0, -EAGAIN if the record isn't
+         * written yet, or -ERANGE if it was overwritten: the reader is more
+         * than a log behind and must catch up from a snapshot.
+         */
+        int read_change(const rte_hash *h, uint64_t seq, share_rte_hash_change *change, void *key_value)
+        {
+            const share_rte_hash_changelog *log = get_hash_ext(h)->changelog;
+            const share_rte_hash_change *record;
+
+            if (log == NULL)
+                return -ENOENT;
+            if (seq >= log->head)
+                return -EAGAIN;
+            if (log->head - seq > log->capacity)
+                return -ERANGE;
+
+            record = get_change_record(log, seq);
+            if (record->seq != seq)
+                return log->head - seq > log->capacity ? -ERANGE : -EAGAIN;
+
+            rte_rmb();
+            rte_memcpy(change, record, sizeof(*change));
+            rte_memcpy(key_value, record + 1, h->key_len);
+            rte_rmb();
+
+            /* A writer reserves the sequence number before touching the record */
+            if (record->seq != seq || log->head - seq > log->capacity)
+                return -ERANGE;
+            change->seq = seq;
+            return 0;
+        }
+
+        /* Number of live entries, retired ones are not counted */
+        uint32_t entry_count(const rte_hash *h)
+        {
+            const share_rte_hash_ext *ext = get_hash_ext(h);
+            int32_t sum = 0;
+
+            for (uint32_t i = 0; i <= RTE_MAX_LCORE; ++i)
+                sum += ext->counters[i].used;
+            return sum > 0 ? sum : 0;
+        }
+
+        /*
+         * The *_nolock functions do the real work of the functions above.
+         * sig already has sig_msb set and the caller either holds the bucket
+         * lock or is the only writer of the table.
+         */
+        template<typename _Geometry, typename _KeyValue>
+        int32_t add_key_value_nolock(const rte_hash *h, const _KeyValue *key_value,
+                                     hash_sig_t sig, uint32_t bucket_index)
+        {
+            hash_sig_t *sig_bucket = get_sig_tbl_bucket<_Geometry>(h, bucket_index);
+            uint8_t *key_bucket = get_key_tbl_bucket<_Geometry>(h, bucket_index);
+            int32_t pos;
+        
+            /* Check if key is already present in the hash */
+            pos = find_key<_Geometry, _KeyValue>(h, key_value->k, sig, sig_bucket, key_bucket);
+            if (pos >= 0)
+                return bucket_index * _Geometry::bucket_entries(h) + pos;
+        
+            /* Check if any free slot within the bucket to add the new key */
+            pos = find_first(k_NULL_SIGNATURE, sig_bucket, _Geometry::bucket_entries(h));
+        
+            if (pos < 0)
+                return -ENOSPC;
+        
+            /* Add the new key to the bucket, the signature goes last */
+            volatile uint32_t * version = get_bucket_version(h, bucket_index);
+            bucket_write_begin(h, version);
+            rte_memcpy(get_key_from_bucket<_Geometry>(h, key_bucket, pos), key_value, sizeof(_KeyValue));
+            if (has_filter(h))
+                filter_add(h, sig, bucket_index);
+            next_generation(h, bucket_index * _Geometry::bucket_entries(h) + pos);
+            rte_wmb();
+            sig_bucket[pos] = sig;
+            log_change(h, k_CHANGE_ADD, sig, bucket_index * _Geometry::bucket_entries(h) + pos, key_value);
+            bucket_write_end(h, version);
+            mark_dirty(h, bucket_index);
+
+            count_entries(h, 1);
+
+            return bucket_index * _Geometry::bucket_entries(h) + pos;
+        }
+
+        template<typename _Geometry, typename _KeyValue, typename _Key, typename _Initializer>
+        int32_t add_key_in_place_nolock(const rte_hash *h, const _Key & key,
+                                        hash_sig_t sig, uint32_t bucket_index, _Initializer & init)
+        {
+            hash_sig_t *sig_bucket = get_sig_tbl_bucket<_Geometry>(h, bucket_index);
+            uint8_t *key_bucket = get_key_tbl_bucket<_Geometry>(h, bucket_index);
+            int32_t pos;
+
+            pos = find_key<_Geometry, _KeyValue>(h, key, sig, sig_bucket, key_bucket);
+            if (pos >= 0)
+                return bucket_index * _Geometry::bucket_entries(h) + pos;
+
+            pos = find_first(k_NULL_SIGNATURE, sig_bucket, _Geometry::bucket_entries(h));
+            if (pos < 0)
+                return -ENOSPC;
+
+            /* Build the entry in its slot, the signature goes last */
+            _KeyValue *slot = static_cast<_KeyValue *>(get_key_from_bucket<_Geometry>(h, key_bucket, pos));
+            volatile uint32_t * version = get_bucket_version(h, bucket_index);
+            bucket_write_begin(h, version);
+            rte_memcpy(&slot->k, &key, sizeof(_Key));
+            init(slot->v);
+            if (has_filter(h))
+                filter_add(h, sig, bucket_index);
+            next_generation(h, bucket_index * _Geometry::bucket_entries(h) + pos);
+            rte_wmb();
+            sig_bucket[pos] = sig;
+            log_change(h, k_CHANGE_ADD, sig, bucket_index * _Geometry::bucket_entries(h) + pos, slot);
+            bucket_write_end(h, version);
+            mark_dirty(h, bucket_index);
+
+            count_entries(h, 1);
+
+            return bucket_index * _Geometry::bucket_entries(h) + pos;
+        }
+
+        template<typename _Geometry, typename _KeyValue>
+        int32_t del_key_value_nolock(const rte_hash *h, const _KeyValue *key_value,
+                                     hash_sig_t sig, uint32_t bucket_index, hash_sig_t free_sig)
+        {
+            hash_sig_t *sig_bucket = get_sig_tbl_bucket<_Geometry>(h, bucket_index);
+            uint8_t *key_bucket = get_key_tbl_bucket<_Geometry>(h, bucket_index);
+            int32_t pos;
+        
+            /* Check if key is already present in the hash */
+            pos = find_key<_Geometry, _KeyValue>(h, key_value->k, sig, sig_bucket, key_bucket);
+            if (pos < 0)
+                return -ENOENT;
+
+            volatile uint32_t * version = get_bucket_version(h, bucket_index);
+            bucket_write_begin(h, version);
+            release_slot(h, &sig_bucket[pos], bucket_index * _Geometry::bucket_entries(h) + pos, sig, free_sig);
+            if (has_filter(h))
+                filter_remove(h, sig, bucket_index);
+            log_change(h, k_CHANGE_DEL, sig, bucket_index * _Geometry::bucket_entries(h) + pos,
+                       get_key_from_bucket<_Geometry>(h, key_bucket, pos));
+            bucket_write_end(h, version);
+            mark_dirty(h, bucket_index);
+
+            count_entries(h, -1);
+
+            return bucket_index * _Geometry::bucket_entries(h) + pos;
+        }
+
+        template<typename _Geometry, typename _KeyValue>
+        int32_t lookup_nolock(const rte_hash *h, const _KeyValue *key_value,
+                              hash_sig_t sig, uint32_t bucket_index)
+        {
+            const hash_sig_t *sig_bucket = get_sig_tbl_bucket<_Geometry>(h, bucket_index);
+            uint8_t *key_bucket = get_key_tbl_bucket<_Geometry>(h, bucket_index);
+            int32_t pos;
+        
+            /* Check if key is already present in the hash */
+            pos = find_key<_Geometry, _KeyValue>(h, key_value->k, sig, sig_bucket, key_bucket);
+            if (pos < 0)
+                return -ENOENT;
+
+            return bucket_index * _Geometry::bucket_entries(h) + pos;
+        }
+
+        template<typename _Geometry, typename _KeyValue, typename _Modifier>
+        bool update_value_nolock(const rte_hash *h, const _KeyValue *key_value,
+                                 hash_sig_t sig, uint32_t bucket_index, _Modifier update)
+        {
+            hash_sig_t *sig_bucket = get_sig_tbl_bucket<_Geometry>(h, bucket_index);
+            uint8_t *key_bucket = get_key_tbl_bucket<_Geometry>(h, bucket_index);
+            int32_t pos;
+
+            /* Check if key is already present in the hash */
+            pos = find_key<_Geometry, _KeyValue>(h, key_value->k, sig, sig_bucket, key_bucket);
+            if (pos < 0)
+                return false;
+
+            // Find this key
+            _KeyValue * tmp = static_cast<_KeyValue*>(get_key_from_bucket<_Geometry>(h, key_bucket, pos));
+            volatile uint32_t * version = get_bucket_version(h, bucket_index);
+            bucket_write_begin(h, version);
+            update(tmp->v, key_value->v);
+            log_change(h, k_CHANGE_UPDATE, sig, bucket_index * _Geometry::bucket_entries(h) + pos, tmp);
+            bucket_write_end(h, version);
+            mark_dirty(h, bucket_index);
+            return true;
+        }
+
+        /*
+         * Write lock several buckets for the *_nolock functions. They are
+         * sorted and locked in increasing index order, so that two callers
+         * can't deadlock, and a bucket given twice is locked once. Returns
+         * the number of distinct buckets, which unlock_buckets takes.
+         */
+        uint32_t lock_buckets(const rte_hash *h, uint32_t *buckets, uint32_t n)
+        {
+            uint32_t i, j, b, m = 0;
+
+            for (i = 1; i < n; i++) {
+                b = buckets[i];
+                for (j = i; j > 0 && buckets[j - 1] > b; j--)
+                    buckets[j] = buckets[j - 1];
+                buckets[j] = b;
+            }
+
+            for (i = 0; i < n; i++)
+                if (m == 0 || buckets[m - 1] != buckets[i])
+                    buckets[m++] = buckets[i];
+
+            for (i = 0; i < m; i++)
+                bucket_write_lock(h, buckets[i]);
+            return m;
+        }
+
+        void unlock_buckets(const rte_hash *h, const uint32_t *buckets, uint32_t n)
+        {
+            while (n > 0)
+                bucket_write_unlock(h, buckets[--n]);
+        }
+
+        inline bool is_single_writer(const rte_hash *h)
+        {
+            return (get_hash_ext(h)->flags & k_FLAG_SINGLE_WRITER) != 0;
+        }
+
+        inline bool has_filter(const rte_hash *h)
+        {
+            return (get_hash_ext(h)->flags & k_FLAG_FILTER) != 0;
+        }
+
+        inline bool is_lock_free(const rte_hash *h)
+        {
+            return (get_hash_ext(h)->flags & k_FLAG_LOCK_FREE) != 0;
+        }
+
+        inline bool has_generations(const rte_hash *h)
+        {
+            return (get_hash_ext(h)->flags & k_FLAG_GENERATIONS) != 0;
+        }
+
+        /* A segmented table has no single key/value table */
+        inline bool is_segmented(const rte_hash *h)
+        {
+            return h->key_tbl == NULL;
+        }
+
+        /* Readers check the bucket versions instead of taking the bucket locks */
+        inline bool has_lockless_readers(const rte_hash *h)
+        {
+            return (get_hash_ext(h)->flags & (k_FLAG_SINGLE_WRITER | k_FLAG_LOCK_FREE)) != 0;
+        }
+
     public:
         ~ShareRteHash() {}
 
@@ -225,40 +1255,160 @@ exit:
             return share_rte_hash;
         }
 
-        rte_hash * create_hash_table(const rte_hash_parameters *params);
-        rte_hash * attach_hash_table(const char * name);
+        /*
+         * Names may have up to k_CATALOG_NAMESIZE - 1 characters, a longer
+         * one than the rte_hash name is shortened there with a hash suffix.
+         * A non-zero fingerprint of the key/value types is kept in the
+         * catalog, and attach_hash_table refuses a table whose fingerprint
+         * differs from the one it is given. A table missing from the catalog
+         * is searched in the tailq. A table of the same name is returned
+         * if it exists; *created, if given, tells whether this call made it.
+         */
+        rte_hash * create_hash_table(const rte_hash_parameters *params, uint32_t flags = 0,
+                                     uint64_t fingerprint = 0, bool *created = NULL);
+        rte_hash * attach_hash_table(const char * name, uint64_t fingerprint = 0);
+
+        /*
+         * Attach n tables at once, fingerprints may be NULL. tables[i] is
+         * NULL for a table not found or of other types. Returns the number
+         * of tables attached.
+         */
+        uint32_t   attach_hash_tables(const char * const *names, const uint64_t *fingerprints,
+                                      uint32_t n, rte_hash **tables);
         void       free_hash_table(rte_hash *& hash_tbl); 
 
+        /*
+         * Read every page of a table, so that a process takes its page
+         * faults and TLB misses here rather than on the first lookups,
+         * e.g. right after attach_hash_table. Returns the bytes read.
+         */
+        uint64_t   prefault_hash_table(const rte_hash *h);
+
+        void       get_footprint(const rte_hash *h, share_rte_hash_footprint *fp);
+
+        /*
+         * Checkpoints, see share_rte_hash.cpp for the file format. Every
+         * call appends a segment to the file at path: all the buckets if
+         * full, else those modified since the last call, which needs
+         * k_FLAG_DIRTY_TRACKING. Each bucket is copied as it is at one
+         * moment, writers go on meanwhile. Returns the number of buckets
+         * written or a negative errno.
+         */
+        int        checkpoint_table(const rte_hash *h, const char *path, bool full);
+
+        /*
+         * Replay the segments of a checkpoint file into a table of the same
+         * geometry, normally just created. A segment cut short by a crash
+         * is ignored. Returns the number of segments or a negative errno.
+         */
+        int        restore_table(const rte_hash *h, const char *path);
+
+        /* Write the latest image of every bucket of a checkpoint file as one segment */
+        static int compact_checkpoint(const char *in_path, const char *out_path);
+
+        /*
+         * Log every change of the table to a ring of records, a power of 2,
+         * allocated with rte_zmalloc_socket under the name CL_<name>. Call
+         * it once, before the table is written.
+         */
+        int        enable_changelog(const rte_hash *h, uint32_t records);
+
     private:
-        ShareRteHash(void) {}
+        ShareRteHash(void) : m_catalog(NULL) {}
+
+        /* The catalog zone of this process, reserved by the primary if __create */
+        share_rte_hash_catalog * catalog(bool __create);
+
+        /* Catalog functions, the writers hold the tailq write lock */
+        int  catalog_lookup(const char *name, share_rte_hash_catalog_entry *entry);
+        void catalog_add(const char *name, rte_hash *h, uint64_t fingerprint);
+        void catalog_remove(const rte_hash *h);
+
+        void compute_footprint(uint32_t num_buckets, uint32_t bucket_entries,
+                               uint32_t sig_bucket_size, uint32_t key_value_size,
+                               uint32_t flags, share_rte_hash_footprint *fp);
+
+        /* log2 of the filter blocks of a bucket */
+        uint32_t filter_shift(uint32_t bucket_entries);
+
+        /* log2 of the buckets of a segment, see k_FLAG_SEGMENTED */
+        uint32_t segment_shift(uint32_t num_buckets, uint32_t bucket_bytes);
 
         /* Returns a pointer to the first signature in specified bucket. */
+        template<typename _Geometry>
         inline hash_sig_t *
         get_sig_tbl_bucket(const rte_hash *h, uint32_t bucket_index)
         {
-        	return (hash_sig_t *)
-        			&(h->sig_tbl[bucket_index * h->sig_tbl_bucket_size]);
+            if (is_segmented(h)) {
+                const share_rte_hash_ext *ext = get_hash_ext(h);
+                uint32_t offset = bucket_index & ((1U << ext->segment_shift) - 1);
+
+                return (hash_sig_t *)(void *)(ext->segments[bucket_index >> ext->segment_shift] +
+                        (size_t)offset * _Geometry::sig_bucket_size(h));
+            }
+            return (hash_sig_t *)(void *)
+        		    &(h->sig_tbl[(size_t)bucket_index * _Geometry::sig_bucket_size(h)]);
         }
         
         /* Returns a pointer to the first key in specified bucket. */
+        template<typename _Geometry>
         inline uint8_t *
         get_key_tbl_bucket(const rte_hash *h, uint32_t bucket_index)
         {
-        	return (uint8_t *) &(h->key_tbl[bucket_index * h->bucket_entries *
-        				     h->key_tbl_key_size]);
+            if (is_segmented(h)) {
+                const share_rte_hash_ext *ext = get_hash_ext(h);
+                uint32_t offset = bucket_index & ((1U << ext->segment_shift) - 1);
+
+                return ext->segments[bucket_index >> ext->segment_shift] + ext->segment_kv_offset +
+                        (size_t)offset * _Geometry::bucket_entries(h) * _Geometry::key_size(h);
+            }
+            return (uint8_t *) &(h->key_tbl[(size_t)bucket_index * _Geometry::bucket_entries(h) *
+        			         _Geometry::key_size(h)]);
         }
         
         /* Returns a pointer to a key at a specific position in a specified bucket. */
+        template<typename _Geometry>
         inline void *
         get_key_from_bucket(const rte_hash *h, uint8_t *bkt, uint32_t pos)
         {
-        	return (void *) &bkt[pos * h->key_tbl_key_size];
+            return (void *) &bkt[pos * _Geometry::key_size(h)];
         }
 
+        template<typename _Geometry>
         inline void *
         get_key_with_index(const rte_hash *h, uint32_t index)
         {
-            return (void *) &(h->key_tbl[index * h->key_tbl_key_size]);
+            if (is_segmented(h)) {
+                const share_rte_hash_ext *ext = get_hash_ext(h);
+                uint32_t offset = index & ((1U << ext->segment_entry_shift) - 1);
+
+                return (void *)(ext->segments[index >> ext->segment_entry_shift] + ext->segment_kv_offset +
+                        (size_t)offset * _Geometry::key_size(h));
+            }
+            return (void *) &(h->key_tbl[(size_t)index * _Geometry::key_size(h)]);
+        }
+
+        /* Returns the generation of a slot, see k_FLAG_GENERATIONS. */
+        inline volatile uint32_t *
+        get_generation(const rte_hash *h, uint32_t index)
+        {
+            const share_rte_hash_ext *ext = get_hash_ext(h);
+
+            if (is_segmented(h)) {
+                uint32_t offset = index & ((1U << ext->segment_entry_shift) - 1);
+
+                return (volatile uint32_t *)(void *)(ext->segments[index >> ext->segment_entry_shift] +
+                        ext->segment_gen_offset) + offset;
+            }
+            return ext->generations + index;
+        }
+
+        /* A slot gets or loses its entry, the writer owns the slot */
+        inline void
+        next_generation(const rte_hash *h, uint32_t index)
+        {
+            if (has_generations(h))
+                ++*get_generation(h, index);
         }
         
         /* Does integer division with rounding-up of result. */
@@ -274,28 +1424,700 @@ exit:
         {
         	return alignment * div_roundup(val, alignment);
         }
+
+        /*
+         * Returns a bit mask of the live entries among the k_SCAN_WIDTH
+         * signatures from sigs, the ones of the first num_sigs with the
+         * high bit set.
+         */
+        inline uint32_t
+        live_signatures(const uint32_t *sigs, uint32_t num_sigs)
+        {
+#ifdef __SSE2__
+            uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_load_si128((const __m128i *)(const void *)sigs)));
+#else
+            uint32_t i, mask = 0;
+            for (i = 0; i < k_SCAN_WIDTH; i++)
+                mask |= (sigs[i] >> 31) << i;
+#endif
+            if (num_sigs < k_SCAN_WIDTH)
+                mask &= (1U << num_sigs) - 1;
+            return mask;
+        }
+
+        /*
+         * Returns a bit mask of the signatures equal to sig among the
+         * k_SCAN_WIDTH signatures from sigs. Signature buckets are padded to
+         * k_SIG_BUCKET_ALIGNMENT, so reading past the last entry is safe.
+         */
+        inline uint32_t
+        match_signatures(uint32_t sig, const uint32_t *sigs)
+        {
+#ifdef __SSE2__
+            __m128i cmp = _mm_cmpeq_epi32(_mm_load_si128((const __m128i *)(const void *)sigs),
+                                          _mm_set1_epi32(sig));
+            return _mm_movemask_ps(_mm_castsi128_ps(cmp));
+#else
+            uint32_t i, mask = 0;
+            for (i = 0; i < k_SCAN_WIDTH; i++)
+                mask |= (uint32_t)(sigs[i] == sig) << i;
+            return mask;
+#endif
+        }
+
+        /* Returns the position of a key in a bucket, or -1. */
+        template<typename _Geometry, typename _KeyValue, typename _Key>
+        inline int32_t
+        find_key(const rte_hash *h, const _Key & key, hash_sig_t sig,
+                 const hash_sig_t *sig_bucket, uint8_t *key_bucket)
+        {
+            uint32_t i, j, mask;
+
+            for (i = 0; i < _Geometry::bucket_entries(h); i += k_SCAN_WIDTH) {
+                mask = match_signatures(sig, sig_bucket + i);
+                while (mask) {
+                    j = i + __builtin_ctz(mask);
+                    mask &= mask - 1;
+
+                    const _KeyValue *tmp = static_cast<const _KeyValue*>(get_key_from_bucket<_Geometry>(h, key_bucket, j));
+                    if (sharehash::key_equal(key, tmp->k))
+                        return j;
+                }
+            }
+            return -1;
+        }
         
         /* Returns the index into the bucket of the first occurrence of a signature. */
         inline int
         find_first(uint32_t sig, const uint32_t *sig_bucket, uint32_t num_sigs)
         {
-        	uint32_t i;
-        	for (i = 0; i < num_sigs; i++) {
-        		if (sig == sig_bucket[i])
-        			return i;
-        	}
-        	return -1;
+            uint32_t i, mask;
+            for (i = 0; i < num_sigs; i += k_SCAN_WIDTH) {
+                mask = match_signatures(sig, sig_bucket + i);
+                /* Padding after the last entry looks like free slots */
+                if (num_sigs - i < k_SCAN_WIDTH)
+                    mask &= (1U << (num_sigs - i)) - 1;
+                if (mask)
+                    return i + __builtin_ctz(mask);
+            }
+            return -1;
         }
 
-        /* Get rte_rwlock for a bucket */
-        inline rte_rwlock_t *
-        get_bucket_lock(const rte_hash *h, uint32_t bucket_index)
+        /*
+         * Compute the signatures and buckets of a burst, prefetch their
+         * signature buckets and locks, and sort the burst by bucket into
+         * order. The sort is stable, n is small.
+         */
+        template<typename _Geometry>
+        void group_bulk(const rte_hash *h, const hash_sig_t *sigs, uint32_t n,
+                        hash_sig_t *sig, uint32_t *bucket, uint32_t *order)
         {
-            uint32_t sig_tbl_size = align_size(h->num_buckets * h->sig_tbl_bucket_size,
-                                               CACHE_LINE_SIZE);
-            rte_rwlock_t * bucket_lock_array = static_cast<rte_rwlock_t *>((void *)(h->sig_tbl + sig_tbl_size));
-            return (bucket_lock_array + bucket_index);
+            const share_rte_hash_ext *ext = get_hash_ext(h);
+            uint32_t lock_size = bucket_lock_size(ext->flags);
+            uint32_t i, j, k;
+
+            for (i = 0; i < n; i++) {
+                sig[i] = sigs[i] | _Geometry::sig_msb(h);
+                bucket[i] = sig[i] & h->bucket_bitmask;
+                rte_prefetch0(get_sig_tbl_bucket<_Geometry>(h, bucket[i]));
+                rte_prefetch0((const uint8_t *)ext->bucket_locks + bucket[i] * lock_size);
+            }
+
+            for (i = 0; i < n; i++) {
+                k = i;
+                for (j = i; j > 0 && bucket[order[j - 1]] > bucket[k]; j--)
+                    order[j] = order[j - 1];
+                order[j] = k;
+            }
         }
+
+        /* lookup_nolock retried until the bucket version is stable */
+        template<typename _Geometry, typename _KeyValue>
+        int32_t lookup_versioned(const rte_hash *h, const _KeyValue *key_value, hash_sig_t sig,
+                                 uint32_t bucket_index)
+        {
+            volatile uint32_t * version = get_bucket_version(h, bucket_index);
+            uint32_t v;
+            int32_t ret;
+
+            do {
+                while ((v = *version) & k_VERSION_WRITERS)
+                    rte_pause();
+                rte_rmb();
+                ret = lookup_nolock<_Geometry>(h, key_value, sig, bucket_index);
+                rte_rmb();
+            } while (*version != v);
+            return ret;
+        }
+
+        /* find_key for lock-free writers, retried until the bucket version is stable */
+        template<typename _Geometry, typename _KeyValue, typename _Key>
+        int32_t find_key_stable(const rte_hash *h, const _Key & key, hash_sig_t sig, uint32_t bucket_index)
+        {
+            volatile uint32_t * version = get_bucket_version(h, bucket_index);
+            uint32_t v;
+            int32_t pos;
+
+            do {
+                while ((v = *version) & k_VERSION_WRITERS)
+                    rte_pause();
+                rte_rmb();
+                pos = find_key<_Geometry, _KeyValue>(h, key, sig, get_sig_tbl_bucket<_Geometry>(h, bucket_index),
+                                                     get_key_tbl_bucket<_Geometry>(h, bucket_index));
+                rte_rmb();
+            } while (*version != v);
+            return pos;
+        }
+
+        /* The two lowest slots holding a key, -1 when there are fewer */
+        template<typename _Geometry, typename _KeyValue, typename _Key>
+        void find_key_copies(const rte_hash *h, const _Key & key, hash_sig_t sig, uint32_t bucket_index,
+                             int32_t & first, int32_t & second)
+        {
+            const hash_sig_t *sig_bucket = get_sig_tbl_bucket<_Geometry>(h, bucket_index);
+            uint8_t *key_bucket = get_key_tbl_bucket<_Geometry>(h, bucket_index);
+            volatile uint32_t * version = get_bucket_version(h, bucket_index);
+            uint32_t i, j, v, mask;
+
+            do {
+                while ((v = *version) & k_VERSION_WRITERS)
+                    rte_pause();
+                rte_rmb();
+                first = second = -1;
+                for (i = 0; i < _Geometry::bucket_entries(h) && second < 0; i += k_SCAN_WIDTH) {
+                    mask = match_signatures(sig, sig_bucket + i);
+                    while (mask && second < 0) {
+                        j = i + __builtin_ctz(mask);
+                        mask &= mask - 1;
+
+                        if (!sharehash::key_equal(key, static_cast<const _KeyValue *>(
+                                    get_key_from_bucket<_Geometry>(h, key_bucket, j))->k))
+                            continue;
+                        if (first < 0)
+                            first = j;
+                        else
+                            second = j;
+                    }
+                }
+                rte_rmb();
+            } while (*version != v);
+        }
+
+        /* Fill a claimed slot for add_key_cas */
+        template<typename _KeyValue>
+        struct copy_key_value {
+            const _KeyValue *key_value;
+            void operator()(_KeyValue *slot) { rte_memcpy(slot, key_value, sizeof(_KeyValue)); }
+        };
+
+        template<typename _KeyValue, typename _Key, typename _Initializer>
+        struct build_key_value {
+            const _Key   & key;
+            _Initializer & init;
+            void operator()(_KeyValue *slot) {
+                rte_memcpy(&slot->k, &key, sizeof(_Key));
+                init(slot->v);
+            }
+        };
+
+        /*
+         * Lock-free insert, see k_FLAG_LOCK_FREE. sig has sig_msb set.
+         * fill(slot) writes the entry into the claimed slot.
+         */
+        template<typename _Geometry, typename _KeyValue, typename _Key, typename _Fill>
+        int32_t add_key_cas(const rte_hash *h, const _Key & key, hash_sig_t sig, uint32_t bucket_index,
+                            _Fill & fill)
+        {
+            hash_sig_t *sig_bucket = get_sig_tbl_bucket<_Geometry>(h, bucket_index);
+            uint8_t *key_bucket = get_key_tbl_bucket<_Geometry>(h, bucket_index);
+            volatile uint32_t * version = get_bucket_version(h, bucket_index);
+            uint32_t base = bucket_index * _Geometry::bucket_entries(h);
+            hash_sig_t pending = pending_signature(h, sig);
+            int32_t pos, first, second;
+            bool released;
+
+            /* Claim a free slot, unless the key is there already */
+            for (;;) {
+                pos = find_key_stable<_Geometry, _KeyValue>(h, key, sig, bucket_index);
+                if (pos >= 0)
+                    return base + pos;
+
+                /* A pending slot may be a delete of the key which isn't logged yet */
+                if (find_first(pending, sig_bucket, _Geometry::bucket_entries(h)) >= 0) {
+                    rte_pause();
+                    continue;
+                }
+
+                pos = find_first(k_NULL_SIGNATURE, sig_bucket, _Geometry::bucket_entries(h));
+                if (pos < 0)
+                    return -ENOSPC;
+
+                if (__sync_bool_compare_and_swap(&sig_bucket[pos], k_NULL_SIGNATURE, pending))
+                    break;
+            }
+
+            /*
+             * The version counts this writer while the slot is filled, so
+             * readers wait, and those still comparing the former entry of
+             * the slot retry.
+             */
+            _KeyValue *slot = static_cast<_KeyValue *>(get_key_from_bucket<_Geometry>(h, key_bucket, pos));
+            bucket_write_begin(h, version);
+            fill(slot);
+            log_change(h, k_CHANGE_ADD, sig, base + pos, slot);
+            next_generation(h, base + pos);
+
+            /* Publish, then look for racing inserts of the key */
+            rte_wmb();
+            sig_bucket[pos] = sig;
+            bucket_write_end(h, version);
+            mark_dirty(h, bucket_index);
+            count_entries(h, 1);
+
+            /*
+             * The last insert to publish sees all the copies; the lowest
+             * one stays. A copy freed here isn't logged as deleted, the
+             * value of the one kept is logged again instead.
+             */
+            for (;;) {
+                find_key_copies<_Geometry, _KeyValue>(h, key, sig, bucket_index, first, second);
+                if (second < 0)
+                    break;
+
+                bucket_write_begin(h, version);
+                released = release_slot(h, &sig_bucket[second], base + second, sig, k_NULL_SIGNATURE);
+                bucket_write_end(h, version);
+                if (released) {
+                    mark_dirty(h, bucket_index);
+                    count_entries(h, -1);
+                    log_change(h, k_CHANGE_UPDATE, sig, base + first,
+                               get_key_from_bucket<_Geometry>(h, key_bucket, first));
+                }
+            }
+
+            /* first is -1 if the key was erased meanwhile */
+            return base + (first >= 0 ? first : pos);
+        }
+
+        /* Lock-free delete, see k_FLAG_LOCK_FREE. sig has sig_msb set. */
+        template<typename _Geometry, typename _KeyValue>
+        int32_t del_key_cas(const rte_hash *h, const _KeyValue *key_value, hash_sig_t sig,
+                            uint32_t bucket_index, hash_sig_t free_sig)
+        {
+            hash_sig_t *sig_bucket = get_sig_tbl_bucket<_Geometry>(h, bucket_index);
+            uint8_t *key_bucket = get_key_tbl_bucket<_Geometry>(h, bucket_index);
+            volatile uint32_t * version = get_bucket_version(h, bucket_index);
+            uint32_t base = bucket_index * _Geometry::bucket_entries(h);
+            const _KeyValue *slot;
+            int32_t pos;
+            bool taken;
+
+            /*
+             * The writer which takes the slot holds it pending while it
+             * logs the entry, so nothing reuses the slot meanwhile, and
+             * inserts of the key, which wait for pending slots of its
+             * signature, log after it.
+             */
+            for (;;) {
+                pos = find_key_stable<_Geometry, _KeyValue>(h, key_value->k, sig, bucket_index);
+                if (pos < 0)
+                    return -ENOENT;
+
+                slot = static_cast<const _KeyValue *>(get_key_from_bucket<_Geometry>(h, key_bucket, pos));
+                bucket_write_begin(h, version);
+                taken = __sync_bool_compare_and_swap(&sig_bucket[pos], sig, pending_signature(h, sig));
+                if (taken && sharehash::key_equal(slot->k, key_value->k)) {
+                    log_change(h, k_CHANGE_DEL, sig, base + pos, slot);
+                    next_generation(h, base + pos);
+                    rte_wmb();
+                    sig_bucket[pos] = free_sig;
+                    bucket_write_end(h, version);
+                    break;
+                }
+
+                /* The slot was reused by another key of the same signature */
+                if (taken)
+                    sig_bucket[pos] = sig;
+                bucket_write_end(h, version);
+            }
+
+            mark_dirty(h, bucket_index);
+            count_entries(h, -1);
+            return base + pos;
+        }
+
+        /* Returns the extra table state stored after struct rte_hash. */
+        inline share_rte_hash_ext *
+        get_hash_ext(const rte_hash *h)
+        {
+            return (share_rte_hash_ext *)((uintptr_t)h + align_size(sizeof(rte_hash), CACHE_LINE_SIZE));
+        }
+
+        /*
+         * Returns the version of a bucket. It has writers counted while the
+         * bucket is being modified and changes on every modification, see
+         * k_VERSION_WRITERS.
+         */
+        inline volatile uint32_t *
+        get_bucket_version(const rte_hash *h, uint32_t bucket_index)
+        {
+            return get_hash_ext(h)->bucket_versions + bucket_index;
+        }
+
+        /*
+         * Account n entries added (or removed if negative) by this lcore.
+         * Threads which aren't lcores share the last counter.
+         */
+        inline void
+        count_entries(const rte_hash *h, int32_t n)
+        {
+            unsigned lcore = rte_lcore_id();
+
+            if (lcore < RTE_MAX_LCORE)
+                get_hash_ext(h)->counters[lcore].used += n;
+            else
+                __sync_fetch_and_add(&get_hash_ext(h)->counters[RTE_MAX_LCORE].used, n);
+        }
+
+        /* Lock-free writers add to the version concurrently, see k_FLAG_LOCK_FREE */
+        inline void
+        bucket_write_begin(const rte_hash *h, volatile uint32_t *version)
+        {
+            if (is_lock_free(h))
+                __sync_fetch_and_add(version, 1);
+            else
+                ++*version;
+            rte_wmb();
+        }
+
+        /* One writer less, one write more, see k_VERSION_WRITERS */
+        inline void
+        bucket_write_end(const rte_hash *h, volatile uint32_t *version)
+        {
+            rte_wmb();
+            if (is_lock_free(h))
+                __sync_fetch_and_add(version, k_VERSION_WRITE_DONE - 1);
+            else
+                *version += k_VERSION_WRITE_DONE - 1;
+        }
+
+        /*
+         * What a lock-free writer keeps in a slot it changes for a key of
+         * signature sig: sig without sig_msb, which no lookup matches and
+         * only inserts of the same signature wait on. The few signatures
+         * whose low bits are a reserved value share k_BUSY_SIGNATURE.
+         */
+        inline hash_sig_t
+        pending_signature(const rte_hash *h, hash_sig_t sig)
+        {
+            hash_sig_t pending = sig & ~h->sig_msb;
+
+            return pending > k_BUSY_SIGNATURE ? pending : k_BUSY_SIGNATURE;
+        }
+
+        /*
+         * Free a live slot. Lock-free writers may have freed it meanwhile,
+         * then it is left alone and false is returned. With generations a
+         * lock-free writer keeps the slot pending until its generation
+         * changed, so that no insert reuses it before.
+         */
+        inline bool
+        release_slot(const rte_hash *h, hash_sig_t *slot_sig, uint32_t index, hash_sig_t sig,
+                     hash_sig_t free_sig)
+        {
+            if (is_lock_free(h)) {
+                if (!has_generations(h))
+                    return __sync_bool_compare_and_swap(slot_sig, sig, free_sig);
+                if (!__sync_bool_compare_and_swap(slot_sig, sig, pending_signature(h, sig)))
+                    return false;
+                next_generation(h, index);
+                rte_wmb();
+                *slot_sig = free_sig;
+                return true;
+            }
+            *slot_sig = free_sig;
+            next_generation(h, index);
+            return true;
+        }
+
+        /*
+         * Called once a write of the bucket is complete. checkpoint_table
+         * takes the bit before it copies the bucket, so either it copies
+         * the bucket as written, or the bit is set again for the next
+         * checkpoint. Setting it before the write could let a checkpoint
+         * take it and copy the bucket as it was. The barrier keeps the
+         * check of the bit after the write; the check keeps the bitmap
+         * line shared while the bit is set.
+         */
+        inline void
+        mark_dirty(const rte_hash *h, uint32_t bucket_index)
+        {
+            volatile uint64_t *dirty = get_hash_ext(h)->dirty;
+            uint64_t bit = 1ULL << (bucket_index & 63);
+
+            if (dirty == NULL)
+                return;
+            rte_mb();
+            if (!(dirty[bucket_index >> 6] & bit))
+                __sync_fetch_and_or(&dirty[bucket_index >> 6], bit);
+        }
+
+        void copy_bucket(const rte_hash *h, uint32_t bucket_index, uint8_t *buf);
+        void apply_bucket(const rte_hash *h, uint32_t bucket_index, const uint8_t *buf);
+
+        inline share_rte_hash_change *
+        get_change_record(const share_rte_hash_changelog *log, uint64_t seq)
+        {
+            return (share_rte_hash_change *)((uintptr_t)(log + 1) +
+                    (uintptr_t)(seq & (log->capacity - 1)) * log->record_size);
+        }
+
+        /*
+         * Append a record to the change log. It is called under the bucket
+         * lock, so the records of a key are in the order of its changes.
+         */
+        inline void
+        log_change(const rte_hash *h, uint32_t op, hash_sig_t sig, uint32_t index, const void *key_value)
+        {
+            share_rte_hash_changelog *log = get_hash_ext(h)->changelog;
+            share_rte_hash_change *record;
+            uint64_t seq;
+
+            if (log == NULL)
+                return;
+
+            seq = __sync_fetch_and_add(&log->head, 1);
+            record = get_change_record(log, seq);
+            record->seq = 0;
+            rte_wmb();
+            record->op = op;
+            record->signature = sig;
+            record->index = index;
+            rte_memcpy(record + 1, key_value, h->key_len);
+            rte_wmb();
+            record->seq = seq;
+        }
+
+        /* The high bits of the mixed signature pick the filter block and counters */
+        static inline uint64_t
+        filter_mix(hash_sig_t sig)
+        {
+            return (uint64_t)sig * 0x9e3779b97f4a7c15ULL;
+        }
+
+        static inline uint32_t
+        filter_counter(uint64_t mix, uint32_t i)
+        {
+            return (mix >> (64 - 7 * (i + 1))) & 127;
+        }
+
+        static inline uint64_t *
+        get_filter_block(uint64_t *bucket_blocks, uint32_t filter_shift, uint64_t mix)
+        {
+            return bucket_blocks + ((mix >> 28) & ((1U << filter_shift) - 1)) * k_FILTER_BLOCK_WORDS;
+        }
+
+        /* Returns the first filter block of a bucket */
+        inline uint64_t *
+        get_filter_bucket(const rte_hash *h, uint32_t bucket_index)
+        {
+            const share_rte_hash_ext *ext = get_hash_ext(h);
+            return ext->filter + ((uint64_t)bucket_index << ext->filter_shift) * k_FILTER_BLOCK_WORDS;
+        }
+
+        inline uint32_t
+        filter_bucket_bytes(const rte_hash *h)
+        {
+            return (k_FILTER_BLOCK_WORDS * sizeof(uint64_t)) << get_hash_ext(h)->filter_shift;
+        }
+
+        /* False if no entry of the bucket has this signature */
+        inline bool
+        filter_may_contain(const rte_hash *h, hash_sig_t sig, uint32_t bucket_index)
+        {
+            uint64_t mix = filter_mix(sig);
+            const volatile uint64_t *block =
+                get_filter_block(get_filter_bucket(h, bucket_index), get_hash_ext(h)->filter_shift, mix);
+            uint32_t i, c;
+
+            for (i = 0; i < k_FILTER_HASHES; i++) {
+                c = filter_counter(mix, i);
+                if (((block[c >> 4] >> ((c & 15) * 4)) & k_FILTER_COUNTER_MAX) == 0)
+                    return false;
+            }
+            return true;
+        }
+
+        /* Add delta, 1 or -1, to the counters of sig. A full counter stays full. */
+        static inline void
+        filter_count(uint64_t *bucket_blocks, uint32_t filter_shift, hash_sig_t sig, int delta)
+        {
+            uint64_t mix = filter_mix(sig);
+            volatile uint64_t *block = get_filter_block(bucket_blocks, filter_shift, mix);
+            uint32_t i, c, shift, n;
+
+            for (i = 0; i < k_FILTER_HASHES; i++) {
+                c = filter_counter(mix, i);
+                shift = (c & 15) * 4;
+                n = (block[c >> 4] >> shift) & k_FILTER_COUNTER_MAX;
+                if (n == k_FILTER_COUNTER_MAX)
+                    continue;
+                if (delta > 0)
+                    block[c >> 4] += 1ULL << shift;
+                else if (n > 0)
+                    block[c >> 4] -= 1ULL << shift;
+            }
+        }
+
+        inline void
+        filter_add(const rte_hash *h, hash_sig_t sig, uint32_t bucket_index)
+        {
+            filter_count(get_filter_bucket(h, bucket_index), get_hash_ext(h)->filter_shift, sig, 1);
+        }
+
+        inline void
+        filter_remove(const rte_hash *h, hash_sig_t sig, uint32_t bucket_index)
+        {
+            filter_count(get_filter_bucket(h, bucket_index), get_hash_ext(h)->filter_shift, sig, -1);
+        }
+
+        /*
+         * Bucket locks. The write lock is a no-op for a single writer table,
+         * whose readers use the bucket versions and never lock.
+         */
+        inline void
+        bucket_read_lock(const rte_hash *h, uint32_t bucket_index)
+        {
+            const share_rte_hash_ext *ext = get_hash_ext(h);
+
+            switch (ext->flags & k_FLAG_LOCK_MASK) {
+                case k_FLAG_LOCK_PHASE_FAIR:
+                    share_pf_rwlock_read_lock((share_pf_rwlock_t *)ext->bucket_locks + bucket_index);
+                    break;
+                case k_FLAG_LOCK_WRITER_PREF:
+                    share_wp_rwlock_read_lock((share_wp_rwlock_t *)ext->bucket_locks + bucket_index);
+                    break;
+                default:
+                    rte_rwlock_read_lock((rte_rwlock_t *)ext->bucket_locks + bucket_index);
+                    break;
+            }
+        }
+
+        inline void
+        bucket_read_unlock(const rte_hash *h, uint32_t bucket_index)
+        {
+            const share_rte_hash_ext *ext = get_hash_ext(h);
+
+            switch (ext->flags & k_FLAG_LOCK_MASK) {
+                case k_FLAG_LOCK_PHASE_FAIR:
+                    share_pf_rwlock_read_unlock((share_pf_rwlock_t *)ext->bucket_locks + bucket_index);
+                    break;
+                case k_FLAG_LOCK_WRITER_PREF:
+                    share_wp_rwlock_read_unlock((share_wp_rwlock_t *)ext->bucket_locks + bucket_index);
+                    break;
+                default:
+                    rte_rwlock_read_unlock((rte_rwlock_t *)ext->bucket_locks + bucket_index);
+                    break;
+            }
+        }
+
+        inline void
+        bucket_write_lock(const rte_hash *h, uint32_t bucket_index)
+        {
+            const share_rte_hash_ext *ext = get_hash_ext(h);
+
+            if (ext->flags & k_FLAG_SINGLE_WRITER)
+                return;
+
+            switch (ext->flags & k_FLAG_LOCK_MASK) {
+                case k_FLAG_LOCK_PHASE_FAIR:
+                    share_pf_rwlock_write_lock((share_pf_rwlock_t *)ext->bucket_locks + bucket_index);
+                    break;
+                case k_FLAG_LOCK_WRITER_PREF:
+                    share_wp_rwlock_write_lock((share_wp_rwlock_t *)ext->bucket_locks + bucket_index);
+                    break;
+                default:
+                    rte_rwlock_write_lock((rte_rwlock_t *)ext->bucket_locks + bucket_index);
+                    break;
+            }
+        }
+
+        inline void
+        bucket_write_unlock(const rte_hash *h, uint32_t bucket_index)
+        {
+            const share_rte_hash_ext *ext = get_hash_ext(h);
+
+            if (ext->flags & k_FLAG_SINGLE_WRITER)
+                return;
+
+            switch (ext->flags & k_FLAG_LOCK_MASK) {
+                case k_FLAG_LOCK_PHASE_FAIR:
+                    share_pf_rwlock_write_unlock((share_pf_rwlock_t *)ext->bucket_locks + bucket_index);
+                    break;
+                case k_FLAG_LOCK_WRITER_PREF:
+                    share_wp_rwlock_write_unlock((share_wp_rwlock_t *)ext->bucket_locks + bucket_index);
+                    break;
+                default:
+                    rte_rwlock_write_unlock((rte_rwlock_t *)ext->bucket_locks + bucket_index);
+                    break;
+            }
+        }
+
+        /* Bytes of one bucket lock of a table created with these flags */
+        static inline uint32_t
+        bucket_lock_size(uint32_t flags)
+        {
+            switch (flags & k_FLAG_LOCK_MASK) {
+                case k_FLAG_LOCK_PHASE_FAIR:  return sizeof(share_pf_rwlock_t);
+                case k_FLAG_LOCK_WRITER_PREF: return sizeof(share_wp_rwlock_t);
+                default:                      return sizeof(rte_rwlock_t);
+            }
+        }
+
+    private:
+        share_rte_hash_catalog *m_catalog;
+};
+
+/*
+ * Bucket geometry read from the rte_hash header at run time, it works for
+ * any table.
+ */
+struct share_runtime_geometry {
+    static inline uint32_t bucket_entries(const rte_hash *h) { return h->bucket_entries; }
+    static inline uint32_t key_size(const rte_hash *h) { return h->key_tbl_key_size; }
+    static inline uint32_t sig_bucket_size(const rte_hash *h) { return h->sig_tbl_bucket_size; }
+    static inline uint32_t sig_msb(const rte_hash *h) { return h->sig_msb; }
+    static inline bool matches(const rte_hash *) { return true; }
+};
+
+/*
+ * Bucket geometry known at compile time. The offsets become constants
+ * and the bucket scans have a constant trip count, so the compiler can
+ * unroll them. It only works for tables whose layout matches, which
+ * matches() checks.
+ */
+template <uint32_t _BucketEntries, uint32_t _KeyValueLength, bool _Packed = false>
+struct share_fixed_geometry {
+    static const uint32_t k_BUCKET_ENTRIES = _BucketEntries;
+    static const uint32_t k_KEY_SIZE = _Packed ? _KeyValueLength :
+        (_KeyValueLength + ShareRteHash::k_KEY_ALIGNMENT - 1) /
+        ShareRteHash::k_KEY_ALIGNMENT * ShareRteHash::k_KEY_ALIGNMENT;
+    static const uint32_t k_SIG_BUCKET_SIZE =
+        (_BucketEntries * sizeof(uint32_t) + ShareRteHash::k_SIG_BUCKET_ALIGNMENT - 1) /
+        ShareRteHash::k_SIG_BUCKET_ALIGNMENT * ShareRteHash::k_SIG_BUCKET_ALIGNMENT;
+    static const uint32_t k_SIG_MSB = 1U << 31;
+
+    static inline uint32_t bucket_entries(const rte_hash *) { return k_BUCKET_ENTRIES; }
+    static inline uint32_t key_size(const rte_hash *) { return k_KEY_SIZE; }
+    static inline uint32_t sig_bucket_size(const rte_hash *) { return k_SIG_BUCKET_SIZE; }
+    static inline uint32_t sig_msb(const rte_hash *) { return k_SIG_MSB; }
+
+    static inline bool matches(const rte_hash *h) {
+        return h->bucket_entries == k_BUCKET_ENTRIES &&
+               h->key_tbl_key_size == k_KEY_SIZE &&
+               h->sig_tbl_bucket_size == k_SIG_BUCKET_SIZE &&
+               h->sig_msb == k_SIG_MSB;
+    }
 };
 
 #endif
@@ -0,0 +1,180 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * @ file
+ * @ Reader/writer locks for the hash table buckets, besides rte_rwlock.
+ * @
+ * @ rte_rwlock lets a reader in whenever no writer holds the lock, so a
+ * @ steady flow of readers keeps the count above zero and a writer may
+ * @ spin for as long as the flow lasts.
+ * @
+ * @ share_pf_rwlock is the phase-fair ticket lock of Brandenburg and
+ * @ Anderson. Readers and writers alternate: a reader arriving while a
+ * @ writer waits enters after that writer, and a writer waits for the
+ * @ readers already in plus at most one other writer. Writers are served
+ * @ in FIFO order.
+ * @
+ * @ share_wp_rwlock prefers writers: once a writer waits, only 'budget'
+ * @ more readers are let in before it, then readers wait until it leaves.
+ * @ The budget is renewed by every writer, so readers don't starve either.
+ * @
+ * @ Both are plain words in shared memory, like rte_rwlock, and can be
+ * @ used from any process.
+ */
+
+#ifndef _SHARE_RWLOCK_H_
+#define _SHARE_RWLOCK_H_
+
+#include <stdint.h>
+
+#include <rte_atomic.h>
+
+/* Phase-fair ticket reader/writer lock */
+typedef struct {
+    volatile uint32_t rin;      /* readers in << 8 | writer present and phase */
+    volatile uint32_t rout;     /* readers out << 8 */
+    volatile uint32_t win;      /* writer tickets taken */
+    volatile uint32_t wout;     /* writer tickets served */
+} share_pf_rwlock_t;
+
+#define SHARE_PF_RINC   0x100   /* reader increment */
+#define SHARE_PF_WBITS  0x3     /* writer bits in rin */
+#define SHARE_PF_PRES   0x2     /* writer present */
+#define SHARE_PF_PHID   0x1     /* phase id */
+
+static inline void
+share_pf_rwlock_init(share_pf_rwlock_t *l)
+{
+    l->rin = 0;
+    l->rout = 0;
+    l->win = 0;
+    l->wout = 0;
+}
+
+static inline void
+share_pf_rwlock_read_lock(share_pf_rwlock_t *l)
+{
+    uint32_t w = __sync_fetch_and_add(&l->rin, SHARE_PF_RINC) & SHARE_PF_WBITS;
+
+    /* Wait for the writer present when we came to leave */
+    if (w != 0)
+        while ((l->rin & SHARE_PF_WBITS) == w)
+            rte_pause();
+}
+
+static inline void
+share_pf_rwlock_read_unlock(share_pf_rwlock_t *l)
+{
+    __sync_fetch_and_add(&l->rout, SHARE_PF_RINC);
+}
+
+static inline void
+share_pf_rwlock_write_lock(share_pf_rwlock_t *l)
+{
+    uint32_t ticket, w, readers;
+
+    /* Wait for the writers before us */
+    ticket = __sync_fetch_and_add(&l->win, 1);
+    while (ticket != l->wout)
+        rte_pause();
+
+    /* Stop new readers, then wait for the ones already in */
+    w = SHARE_PF_PRES | (ticket & SHARE_PF_PHID);
+    readers = __sync_fetch_and_add(&l->rin, w);
+    while (readers != l->rout)
+        rte_pause();
+}
+
+static inline void
+share_pf_rwlock_write_unlock(share_pf_rwlock_t *l)
+{
+    __sync_fetch_and_and(&l->rin, ~(uint32_t)SHARE_PF_WBITS);
+    __sync_fetch_and_add(&l->wout, 1);
+}
+
+/* Writer-preferring reader/writer lock with bounded reader admission */
+typedef struct {
+    volatile int32_t  cnt;      /* -1 when write locked, else the readers */
+    volatile uint32_t waiting;  /* writers waiting */
+    volatile uint32_t admitted; /* readers let in since a writer waits */
+    uint32_t          budget;   /* readers let in before a waiting writer */
+} share_wp_rwlock_t;
+
+static inline void
+share_wp_rwlock_init(share_wp_rwlock_t *l, uint32_t budget)
+{
+    l->cnt = 0;
+    l->waiting = 0;
+    l->admitted = 0;
+    l->budget = budget;
+}
+
+/*
+ * The budget is checked before the reader enters, so concurrent readers
+ * may overrun it by their number, but not more.
+ */
+static inline void
+share_wp_rwlock_read_lock(share_wp_rwlock_t *l)
+{
+    int32_t x;
+
+    for (;;) {
+        if (l->waiting && l->admitted >= l->budget) {
+            rte_pause();
+            continue;
+        }
+
+        x = l->cnt;
+        if (x < 0) {
+            rte_pause();
+            continue;
+        }
+
+        if (__sync_bool_compare_and_swap(&l->cnt, x, x + 1))
+            break;
+    }
+
+    if (l->waiting)
+        __sync_fetch_and_add(&l->admitted, 1);
+}
+
+static inline void
+share_wp_rwlock_read_unlock(share_wp_rwlock_t *l)
+{
+    __sync_fetch_and_sub(&l->cnt, 1);
+}
+
+static inline void
+share_wp_rwlock_write_lock(share_wp_rwlock_t *l)
+{
+    __sync_fetch_and_add(&l->waiting, 1);
+    while (l->cnt != 0 || !__sync_bool_compare_and_swap(&l->cnt, 0, -1))
+        rte_pause();
+    __sync_fetch_and_sub(&l->waiting, 1);
+}
+
+static inline void
+share_wp_rwlock_write_unlock(share_wp_rwlock_t *l)
+{
+    /* A new budget for the readers before the next writer */
+    l->admitted = 0;
+    rte_wmb();
+    __sync_fetch_and_add(&l->cnt, 1);
+}
+
+#endif
@@ -0,0 +1,322 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * Description:
+ *
+ * A hash map split into N independent ShareHashMap shards, N a power of 2.
+ * The shard of a key is given by the high bits of its mixed signature,
+ * the bucket inside the shard by the low bits as usual. Every shard has
+ * its own HT_/SIG_/KV_ memory zones, named <name>_<i>, and may live on
+ * its own NUMA socket.
+ *
+ * In ownership mode every shard is a k_FLAG_SINGLE_WRITER table written
+ * by one owner lcore. A mutation from the owner is applied directly, a
+ * mutation from any other lcore is forwarded to the owner through the
+ * shard's ShareMutationQueue, and the owner applies it in poll().
+ *
+ * update_value applies _Modifier, a type of the map, so a forwarded update
+ * means the same as a direct one. The owner applies it with its own
+ * instance, keep it stateless.
+ *
+ * The number of shards and the owners are kept in the SH_<name> memzone,
+ * so secondary processes find them when they attach.
+ */
+
+#ifndef _SHARE_SHARDED_HASHMAP_H_
+#define _SHARE_SHARDED_HASHMAP_H_
+
+#include <stdint.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_lcore.h>
+#include <rte_log.h>
+#include <rte_memzone.h>
+#include <rte_string_fns.h>
+
+#include "share_hashmap.h"
+#include "share_mutation_queue.h"
+#include "modifier.h"
+
+#define SHARE_SHARDS_MAX 64
+
+/* Layout of the SH_<name> memzone */
+struct share_sharded_header {
+    uint32_t num_shards;
+    uint32_t owned;
+    uint32_t owners[SHARE_SHARDS_MAX];
+};
+
+template <class _Key, class _Value, class _HashFunc = sharehash::hash<_Key>,
+          class _Geometry = share_runtime_geometry, class _Modifier = assign<_Value> >
+class ShareShardedHashMap {
+    public:
+        typedef ShareHashMap<_Key, _Value, _HashFunc, _Geometry> shard_type;
+        typedef ShareMutationQueue<shard_type> queue_type;
+
+        typedef _Key key_type;
+        typedef _Value value_type;
+        typedef _HashFunc hasher;
+        typedef _Modifier modifier_type;
+        typedef typename shard_type::key_value_pair_type key_value_pair_type;
+        typedef typename queue_type::ticket_type ticket_type;
+
+    public:
+        ShareShardedHashMap(const char * __name, uint32_t __num_shards,
+                            uint32_t __entries_per_shard = shard_type::DEFAULT_TOTAL_ENTRIES,
+                            uint32_t __bucket_entries = shard_type::DEFAULT_BUCKET_ENTRIES)
+            : m_name(__name), m_num_shards(__num_shards), m_shard_shift(32),
+              m_entries(__entries_per_shard), m_bucket_entries(__bucket_entries),
+              m_header(NULL) {
+            for (uint32_t i = 0; i < SHARE_SHARDS_MAX; ++i) {
+                m_shards[i] = NULL;
+                m_queues[i] = NULL;
+            }
+        }
+
+        ~ShareShardedHashMap(void) {
+            for (uint32_t i = 0; i < SHARE_SHARDS_MAX; ++i) {
+                delete m_queues[i];
+                delete m_shards[i];
+            }
+        }
+
+        /*
+         * Create the shards, used by primary process.
+         * __sockets[i] is the socket of shard i, all on socket 0 if NULL.
+         * With __owners, shard i is written only by lcore __owners[i].
+         */
+        bool create(const unsigned * __owners = NULL, const int * __sockets = NULL) {
+            char mz_name[RTE_MEMZONE_NAMESIZE];
+            const struct rte_memzone *mz;
+
+            if (m_num_shards == 0 || m_num_shards > SHARE_SHARDS_MAX ||
+                !rte_is_power_of_2(m_num_shards)) {
+                RTE_LOG(ERR, HASH, "ShareShardedHashMap %s has an invalid number of shards\n", m_name);
+                rte_errno = EINVAL;
+                return false;
+            }
+
+            rte_snprintf(mz_name, sizeof(mz_name), "SH_%s", m_name);
+            mz = rte_memzone_reserve(mz_name, sizeof(share_sharded_header), SOCKET_ID_ANY, 0);
+            if (mz == NULL) {
+                RTE_LOG(ERR, HASH, "ShareShardedHashMap::create memzone %s reserve failed\n", mz_name);
+                return false;
+            }
+
+            m_header = static_cast<share_sharded_header *>(mz->addr);
+            m_header->num_shards = m_num_shards;
+            m_header->owned = (__owners != NULL);
+            for (uint32_t i = 0; i < m_num_shards; ++i)
+                m_header->owners[i] = __owners ? __owners[i] : 0;
+            setup();
+
+            for (uint32_t i = 0; i < m_num_shards; ++i) {
+                int socket_id = __sockets ? __sockets[i] : 0;
+
+                m_shards[i] = new shard_type(m_shard_names[i], m_entries, m_bucket_entries, socket_id);
+                if (!m_shards[i]->create(m_header->owned ? ShareRteHash::k_FLAG_SINGLE_WRITER : 0))
+                    return false;
+
+                if (m_header->owned) {
+                    m_queues[i] = new queue_type(m_shard_names[i], *m_shards[i]);
+                    if (!m_queues[i]->create(queue_type::DEFAULT_QUEUE_SIZE, socket_id))
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        // attach to existing shards, used by secondary process
+        bool attach(void) {
+            char mz_name[RTE_MEMZONE_NAMESIZE];
+            const struct rte_memzone *mz;
+
+            rte_snprintf(mz_name, sizeof(mz_name), "SH_%s", m_name);
+            mz = rte_memzone_lookup(mz_name);
+            if (mz == NULL) {
+                rte_errno = ENOENT;
+                return false;
+            }
+
+            m_header = static_cast<share_sharded_header *>(mz->addr);
+            m_num_shards = m_header->num_shards;
+            setup();
+
+            for (uint32_t i = 0; i < m_num_shards; ++i) {
+                m_shards[i] = new shard_type(m_shard_names[i], m_entries, m_bucket_entries);
+                if (!m_shards[i]->attach())
+                    return false;
+
+                if (m_header->owned) {
+                    m_queues[i] = new queue_type(m_shard_names[i], *m_shards[i]);
+                    if (!m_queues[i]->attach())
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        uint32_t num_shards(void) { return m_num_shards; }
+
+        // the shard which holds a key
+        uint32_t shard_of(const key_type & __key) {
+            return shard_of_hash(m_hash_func(__key));
+        }
+
+        // per-shard access, e.g. for statistics
+        shard_type & shard(uint32_t __index) { return *m_shards[__index]; }
+
+        bool is_owned(void) { return m_header->owned != 0; }
+
+        unsigned owner(uint32_t __index) { return m_header->owners[__index]; }
+
+        /*
+         * Mutations. Applied directly they return what ShareHashMap returns.
+         * Forwarded to the owner they return what ShareMutationQueue returns,
+         * 0 once queued or -ENOBUFS, and __ticket gives the real result.
+         */
+        int32_t insert(const key_type & __key, const value_type & __value, ticket_type * __ticket = NULL) {
+            hash_sig_t signature = m_hash_func(__key);
+            uint32_t i = shard_of_hash(signature);
+
+            if (forward(i))
+                return m_queues[i]->insert(__key, __value, __ticket);
+            return m_shards[i]->insert_with_hash(__key, __value, signature);
+        }
+
+        int32_t erase(const key_type & __key, ticket_type * __ticket = NULL) {
+            hash_sig_t signature = m_hash_func(__key);
+            uint32_t i = shard_of_hash(signature);
+
+            if (forward(i))
+                return m_queues[i]->erase(__key, __ticket);
+            return m_shards[i]->erase_with_hash(__key, signature);
+        }
+
+        // __new_value is applied with modifier_type, here or by the owner
+        int32_t update_value(const key_type & __key, const value_type & __new_value, ticket_type * __ticket = NULL) {
+            hash_sig_t signature = m_hash_func(__key);
+            uint32_t i = shard_of_hash(signature);
+
+            if (forward(i))
+                return m_queues[i]->update_value(__key, __new_value, __ticket);
+            return m_shards[i]->update_value_with_hash(__key, __new_value, signature, m_update);
+        }
+
+        // collect the result of a forwarded mutation of a key
+        int32_t wait(const key_type & __key, ticket_type __ticket) {
+            return m_queues[shard_of(__key)]->wait(__ticket);
+        }
+
+        // get the position of a key in its shard, return a negative number if fail
+        int32_t find(const key_type & __key, uint32_t * __shard = NULL) {
+            hash_sig_t signature = m_hash_func(__key);
+            uint32_t i = shard_of_hash(signature);
+
+            if (__shard)
+                *__shard = i;
+            return m_shards[i]->find_with_hash(__key, signature);
+        }
+
+        void get_entry_with_index(key_value_pair_type *& ret, uint32_t __shard, uint32_t __index) {
+            m_shards[__shard]->get_entry_with_index(ret, __index);
+        }
+
+        /*
+         * Called in the loop of an owner lcore: apply the mutations
+         * forwarded to the shards it owns. Returns how many were applied.
+         */
+        uint32_t poll(uint32_t __burst = queue_type::DEFAULT_BURST_SIZE) {
+            unsigned lcore = rte_lcore_id();
+            uint32_t n = 0;
+
+            if (!m_header->owned)
+                return 0;
+
+            for (uint32_t i = 0; i < m_num_shards; ++i)
+                if (m_header->owners[i] == lcore)
+                    n += m_queues[i]->drain(m_update, __burst);
+            return n;
+        }
+
+        // see ShareHashMap::clear, the parts are taken in every shard
+        uint32_t clear(uint32_t __part = 0, uint32_t __parts = 1) {
+            uint32_t n = 0;
+            for (uint32_t i = 0; i < m_num_shards; ++i)
+                n += m_shards[i]->clear(__part, __parts);
+            return n;
+        }
+
+        template<typename _Predicate>
+        uint32_t erase_if(_Predicate & __pred, uint32_t __part = 0, uint32_t __parts = 1) {
+            uint32_t n = 0;
+            for (uint32_t i = 0; i < m_num_shards; ++i)
+                n += m_shards[i]->erase_if(__pred, __part, __parts);
+            return n;
+        }
+
+        int32_t used_entry_count(void) {
+            int32_t count = 0;
+            for (uint32_t i = 0; i < m_num_shards; ++i)
+                count += m_shards[i]->used_entry_count();
+            return count;
+        }
+
+    private:
+        void setup(void) {
+            m_shard_shift = 32;
+            for (uint32_t n = m_num_shards; n > 1; n >>= 1)
+                --m_shard_shift;
+
+            for (uint32_t i = 0; i < m_num_shards; ++i)
+                rte_snprintf(m_shard_names[i], sizeof(m_shard_names[i]), "%s_%u", m_name, i);
+        }
+
+        /*
+         * Take the high bits of the signature multiplied by a 32 bits golden
+         * ratio, so that every bit of the signature counts. The shards stay
+         * balanced even with an identity hash, which only varies in its low
+         * bits, and they don't depend on the bucket index only.
+         */
+        inline uint32_t shard_of_hash(hash_sig_t __signature) {
+            if (m_shard_shift >= 32)
+                return 0;
+            return (uint32_t)(__signature * 0x9e3779b1U) >> m_shard_shift;
+        }
+
+        inline bool forward(uint32_t __shard) {
+            return m_header->owned && m_header->owners[__shard] != rte_lcore_id();
+        }
+
+    private:
+        const char             * m_name;
+        uint32_t                 m_num_shards;
+        uint32_t                 m_shard_shift;
+        uint32_t                 m_entries;
+        uint32_t                 m_bucket_entries;
+        share_sharded_header   * m_header;
+        shard_type             * m_shards[SHARE_SHARDS_MAX];
+        queue_type             * m_queues[SHARE_SHARDS_MAX];
+        char                     m_shard_names[SHARE_SHARDS_MAX][ShareRteHash::k_RTE_HASH_NAMESIZE];
+        hasher                   m_hash_func;
+        modifier_type            m_update;
+};
+
+#endif
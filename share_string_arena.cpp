@@ -0,0 +1,182 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_log.h>
+#include <rte_atomic.h>
+#include <rte_memzone.h>
+#include <rte_errno.h>
+#include <rte_string_fns.h>
+
+#include "share_string_arena.h"
+
+const char *ShareStringArena::s_bases[SHARE_STRING_ARENAS_MAX];
+uint32_t    ShareStringArena::s_next_id = 0;
+
+/* One index entry for every k_BYTES_PER_SLOT bytes of the arena, at least k_MIN_SLOTS */
+static const uint32_t k_BYTES_PER_SLOT = 64;
+static const uint32_t k_MIN_SLOTS = 64;
+
+/* Bytes before a string, its length */
+static const uint32_t k_LENGTH_SIZE = sizeof(uint32_t);
+
+/*
+ * The arena id is given by the primary process, which creates every arena,
+ * and kept in the header so that secondary processes use the same one.
+ */
+bool
+ShareStringArena::create(uint32_t capacity, int socket_id)
+{
+	char mz_name[RTE_MEMZONE_NAMESIZE];
+	const struct rte_memzone *mz;
+	uint32_t slots = k_MIN_SLOTS;
+
+	if (s_next_id >= SHARE_STRING_ARENAS_MAX) {
+		RTE_LOG(ERR, HASH, "ShareStringArena::create too many arenas\n");
+		rte_errno = ENOSPC;
+		return false;
+	}
+
+	while (slots < capacity / k_BYTES_PER_SLOT)
+		slots <<= 1;
+
+	rte_snprintf(mz_name, sizeof(mz_name), "SA_%s", m_name);
+	mz = rte_memzone_reserve(mz_name, sizeof(share_string_arena_header) +
+				 (size_t)slots * sizeof(uint64_t) + capacity, socket_id, 0);
+	if (mz == NULL) {
+		RTE_LOG(ERR, HASH, "ShareStringArena::create memzone %s reserve failed\n", mz_name);
+		return false;
+	}
+
+	share_string_arena_header *header = (share_string_arena_header *)mz->addr;
+	header->id = s_next_id++;
+	header->capacity = capacity;
+	header->index_slots = slots;
+	rte_atomic32_init(&header->used);
+	memset(header + 1, 0, (size_t)slots * sizeof(uint64_t));
+
+	setup(mz->addr);
+	return true;
+}
+
+bool
+ShareStringArena::attach(void)
+{
+	char mz_name[RTE_MEMZONE_NAMESIZE];
+	const struct rte_memzone *mz;
+
+	rte_snprintf(mz_name, sizeof(mz_name), "SA_%s", m_name);
+	mz = rte_memzone_lookup(mz_name);
+	if (mz == NULL) {
+		rte_errno = ENOENT;
+		return false;
+	}
+
+	setup(mz->addr);
+	return true;
+}
+
+void
+ShareStringArena::setup(void *addr)
+{
+	m_header = (share_string_arena_header *)addr;
+	s_bases[m_header->id] = (const char *)addr + sizeof(share_string_arena_header) +
+		(size_t)m_header->index_slots * sizeof(uint64_t);
+}
+
+/* An index entry holds the string s of the given hash */
+bool
+ShareStringArena::same_string(uint64_t entry, const ShareStringRef & s, uint32_t hash) const
+{
+	const char *bytes = s_bases[m_header->id] + (uint32_t)entry - 1;
+	uint32_t len;
+
+	if ((uint32_t)(entry >> 32) != hash)
+		return false;
+	memcpy(&len, bytes - k_LENGTH_SIZE, sizeof(len));
+	return len == s.len && share_memeq(bytes, s.data, s.len);
+}
+
+/*
+ * A string already in the index is returned as it is. Otherwise its length
+ * and bytes are appended, then it is added to the index. A store of the
+ * same string racing this one may append it too; the first one indexed is
+ * kept and the other copy is lost.
+ */
+int
+ShareStringArena::store(const ShareStringRef & s, uint32_t hash, share_string_key & key)
+{
+	volatile uint64_t *slots = index();
+	uint32_t mask = m_header->index_slots - 1;
+	uint32_t i, offset, need;
+	uint64_t entry, mine;
+
+	if (s.len >= share_string_key::k_PROBE)
+		return -EINVAL;
+
+	for (i = 0; i <= mask; i++) {
+		entry = slots[(hash + i) & mask];
+		if (entry == 0)
+			break;
+		if (same_string(entry, s, hash)) {
+			offset = (uint32_t)entry - 1;
+			goto found;
+		}
+	}
+
+	/* Reserve the bytes, used never goes past the capacity */
+	need = k_LENGTH_SIZE + s.len;
+	do {
+		offset = (uint32_t)rte_atomic32_read(&m_header->used);
+		if ((uint64_t)offset + need > m_header->capacity)
+			return -ENOSPC;
+	} while (!rte_atomic32_cmpset((volatile uint32_t *)&m_header->used.cnt, offset, offset + need));
+
+	memcpy((char *)(uintptr_t)s_bases[m_header->id] + offset, &s.len, k_LENGTH_SIZE);
+	offset += k_LENGTH_SIZE;
+	memcpy((char *)(uintptr_t)s_bases[m_header->id] + offset, s.data, s.len);
+	rte_wmb();
+
+	/* A full index leaves the string out of it */
+	mine = ((uint64_t)hash << 32) | (offset + 1);
+	for (i = 0; i <= mask; i++) {
+		volatile uint64_t *slot = &slots[(hash + i) & mask];
+
+		if (*slot == 0 && rte_atomic64_cmpset(slot, 0, mine))
+			break;
+		if (same_string(*slot, s, hash)) {
+			offset = (uint32_t)*slot - 1;
+			break;
+		}
+	}
+
+found:
+	key.hash = hash;
+	key.length = s.len;
+	key.ref = ((uint64_t)m_header->id << 32) | offset;
+	return 0;
+}
+
+uint32_t
+ShareStringArena::used(void) const
+{
+	return rte_atomic32_read(&m_header->used);
+}
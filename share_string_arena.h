@@ -0,0 +1,180 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * @ file
+ * @ Shared memory arena for variable-length string keys.
+ * @
+ * @ The bytes of a string are appended once to the SA_<name> memzone and
+ * @ the hash table slot only keeps a share_string_key: the full hash, the
+ * @ length and a reference to the bytes made of the arena id and the
+ * @ offset in the arena. It has the same meaning in every process.
+ * @
+ * @ A lookup builds a probe key which points to the caller's bytes, so it
+ * @ allocates nothing. Keys are compared on the hash and the length first,
+ * @ the bytes only when both match.
+ * @
+ * @ The arena interns the strings: a string is appended once, after its
+ * @ length, and an index of hashes and offsets, between the header and the
+ * @ bytes, finds it again. A key erased and inserted again reuses its bytes.
+ * @ Bytes are never freed, so an arena only fills up with new strings; a
+ * @ string stored once the index is full isn't interned.
+ */
+
+#ifndef _SHARE_STRING_ARENA_H_
+#define _SHARE_STRING_ARENA_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <rte_common.h>
+#include <rte_atomic.h>
+#include <rte_memory.h>
+#include <rte_memzone.h>
+
+#include "hash_func.h"
+#include "key_traits.h"
+
+#define SHARE_STRING_ARENAS_MAX 64
+
+/* A string given by the caller, it isn't copied */
+struct ShareStringRef {
+    const char *data;
+    uint32_t    len;
+
+    ShareStringRef(void) : data(NULL), len(0) {}
+    ShareStringRef(const char *__s) : data(__s), len(strlen(__s)) {}
+    ShareStringRef(const char *__s, uint32_t __len) : data(__s), len(__len) {}
+    ShareStringRef(const std::string & __s) : data(__s.data()), len(__s.size()) {}
+};
+
+struct share_string_key {
+    /* Set in length for a probe key, whose ref is a pointer */
+    static const uint32_t k_PROBE = 0x80000000;
+
+    uint32_t hash;
+    uint32_t length;
+    uint64_t ref;       /* arena id << 32 | offset, or the probe pointer */
+};
+
+/* Layout of the head of the SA_<name> memzone, the index then the bytes follow it */
+struct share_string_arena_header {
+    uint32_t id;
+    uint32_t capacity;
+    rte_atomic32_t used;        /* never more than capacity */
+    uint32_t index_slots;       /* a power of 2 */
+} __rte_cache_aligned;
+
+class ShareStringArena {
+    public:
+        ShareStringArena(const char * __name) : m_name(__name), m_header(NULL) {}
+        ~ShareStringArena(void) {}
+
+        // create the arena, used by primary process
+        bool create(uint32_t capacity, int socket_id = SOCKET_ID_ANY);
+
+        // attach to an existing arena, used by secondary process
+        bool attach(void);
+
+        // intern a string, returns a key for the table or a negative errno
+        int store(const ShareStringRef & s, uint32_t hash, share_string_key & key);
+
+        uint32_t used(void) const;
+        uint32_t capacity(void) const { return m_header->capacity; }
+
+        static inline share_string_key probe(const ShareStringRef & s, uint32_t hash) {
+            share_string_key key;
+            key.hash = hash;
+            key.length = s.len | share_string_key::k_PROBE;
+            key.ref = (uintptr_t)s.data;
+            return key;
+        }
+
+        static inline uint32_t length(const share_string_key & key) {
+            return key.length & ~share_string_key::k_PROBE;
+        }
+
+        static inline const char * data(const share_string_key & key) {
+            if (key.length & share_string_key::k_PROBE)
+                return (const char *)(uintptr_t)key.ref;
+            return s_bases[key.ref >> 32] + (uint32_t)key.ref;
+        }
+
+        static inline ShareStringRef str(const share_string_key & key) {
+            return ShareStringRef(data(key), length(key));
+        }
+
+    private:
+        void setup(void *addr);
+
+        /* Index entries are hash << 32 | (offset + 1), 0 when free */
+        volatile uint64_t * index(void) const {
+            return (volatile uint64_t *)(void *)(m_header + 1);
+        }
+
+        bool same_string(uint64_t entry, const ShareStringRef & s, uint32_t hash) const;
+
+    private:
+        const char                *m_name;
+        share_string_arena_header *m_header;
+
+        /* Arena bytes by id, filled by create and attach in every process */
+        static const char *s_bases[SHARE_STRING_ARENAS_MAX];
+        static uint32_t    s_next_id;
+};
+
+/* Compare n bytes, 16 at a time */
+static inline bool
+share_memeq(const char *a, const char *b, uint32_t n)
+{
+#ifdef __SSE2__
+    while (n >= 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(const void *)a);
+        __m128i y = _mm_loadu_si128((const __m128i *)(const void *)b);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff)
+            return false;
+        a += 16;
+        b += 16;
+        n -= 16;
+    }
+#endif
+    return memcmp(a, b, n) == 0;
+}
+
+namespace sharehash {
+
+template<> struct hash<share_string_key> {
+    size_t operator()(const share_string_key & __key) const { return __key.hash; }
+};
+
+template<> struct key_compare<share_string_key, false> {
+    static inline bool equal(const share_string_key & __a, const share_string_key & __b) {
+        if (__a.hash != __b.hash ||
+            ShareStringArena::length(__a) != ShareStringArena::length(__b))
+            return false;
+        return share_memeq(ShareStringArena::data(__a), ShareStringArena::data(__b),
+                           ShareStringArena::length(__a));
+    }
+};
+
+}
+
+#endif
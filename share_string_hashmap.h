@@ -0,0 +1,128 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * Description:
+ *
+ * A ShareHashMap with variable-length string keys, which works across
+ * processes unlike a char* key. The key bytes live in a ShareStringArena
+ * and every slot holds a 16 bytes share_string_key, whatever the length
+ * of the string.
+ */
+
+#ifndef _SHARE_STRING_HASHMAP_H_
+#define _SHARE_STRING_HASHMAP_H_
+
+#include <errno.h>
+
+#include "share_hashmap.h"
+#include "share_string_arena.h"
+
+template <class _Value>
+class ShareStringHashMap {
+    public:
+        static const uint32_t DEFAULT_ARENA_SIZE = 1 << 20;
+
+    public:
+        typedef ShareHashMap<share_string_key, _Value> map_type;
+        typedef ShareStringRef key_type;
+        typedef _Value value_type;
+        typedef typename map_type::key_value_pair_type key_value_pair_type;
+
+    public:
+        ShareStringHashMap(const char * __name,
+                           uint32_t __entries = map_type::DEFAULT_TOTAL_ENTRIES,
+                           uint32_t __bucket_entries = map_type::DEFAULT_BUCKET_ENTRIES,
+                           uint32_t __arena_size = DEFAULT_ARENA_SIZE)
+            : m_map(__name, __entries, __bucket_entries), m_arena(__name),
+              m_arena_size(__arena_size) {}
+
+        // create a hashmap, used by primary process
+        bool create(uint32_t __flags = 0) {
+            return m_arena.create(m_arena_size) && m_map.create(__flags);
+        }
+
+        // attach to an existing hashmap, used by secondary process
+        bool attach(void) {
+            return m_arena.attach() && m_map.attach();
+        }
+
+        /*
+         * Insert a <key, value> pair. The key is interned in the arena if it
+         * isn't in the table yet. Returns the position, or -ENOSPC if the
+         * table or the arena is full.
+         */
+        int32_t insert(const key_type & __key, const value_type & __value) {
+            hash_sig_t signature = hash(__key);
+            share_string_key key;
+            int32_t position;
+
+            position = m_map.find_with_hash(ShareStringArena::probe(__key, signature), signature);
+            if (position >= 0)
+                return position;
+
+            int ret = m_arena.store(__key, signature, key);
+            if (ret < 0)
+                return ret;
+            return m_map.insert_with_hash(key, __value, signature);
+        }
+
+        // get the index of a key, return a negative number if fail
+        int32_t find(const key_type & __key) {
+            hash_sig_t signature = hash(__key);
+            return m_map.find_with_hash(ShareStringArena::probe(__key, signature), signature);
+        }
+
+        // the bytes of the key stay in the arena, inserting it again reuses them
+        int32_t erase(const key_type & __key) {
+            hash_sig_t signature = hash(__key);
+            return m_map.erase_with_hash(ShareStringArena::probe(__key, signature), signature);
+        }
+
+        template<typename _Modifier>
+        bool update_value(const key_type & __key, const value_type & __new_value, const _Modifier & update) {
+            hash_sig_t signature = hash(__key);
+            return m_map.update_value_with_hash(ShareStringArena::probe(__key, signature),
+                                                __new_value, signature, update);
+        }
+
+        void get_entry_with_index(key_value_pair_type *& ret, uint32_t index) {
+            m_map.get_entry_with_index(ret, index);
+        }
+
+        // the string of a stored key
+        static key_type key_of(const key_value_pair_type * __entry) {
+            return ShareStringArena::str(__entry->k);
+        }
+
+        map_type & map(void) { return m_map; }
+
+        uint32_t arena_used(void) { return m_arena.used(); }
+        uint32_t arena_capacity(void) { return m_arena.capacity(); }
+
+    private:
+        hash_sig_t hash(const key_type & __key) {
+            return DEFAULT_HASH_FUNC(__key.data, __key.len, 0);
+        }
+
+    private:
+        map_type         m_map;
+        ShareStringArena m_arena;
+        uint32_t         m_arena_size;
+};
+
+#endif
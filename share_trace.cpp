@@ -0,0 +1,150 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_log.h>
+#include <rte_cycles.h>
+#include <rte_memzone.h>
+#include <rte_errno.h>
+
+#include "share_trace.h"
+
+#define SHARE_TRACE_MZ_NAME "TR_TRACE"
+
+bool
+ShareTrace::create(uint32_t events_per_lcore, int socket_id)
+{
+	const struct rte_memzone *mz;
+	size_t events_offset = RTE_ALIGN(sizeof(struct share_trace), CACHE_LINE_SIZE);
+
+	if (!rte_is_power_of_2(events_per_lcore)) {
+		rte_errno = EINVAL;
+		return false;
+	}
+
+	mz = rte_memzone_reserve(SHARE_TRACE_MZ_NAME,
+			events_offset + (size_t)RTE_MAX_LCORE * events_per_lcore *
+			sizeof(struct share_trace_event), socket_id, 0);
+	if (mz == NULL) {
+		RTE_LOG(ERR, HASH, "ShareTrace::create memzone %s reserve failed\n",
+			SHARE_TRACE_MZ_NAME);
+		return false;
+	}
+
+	struct share_trace *trace = (struct share_trace *)mz->addr;
+	memset(trace, 0, sizeof(*trace));
+	trace->size = events_per_lcore;
+	trace->tsc_hz = rte_get_tsc_hz();
+
+	setup(mz->addr);
+	return true;
+}
+
+bool
+ShareTrace::attach(void)
+{
+	const struct rte_memzone *mz;
+
+	mz = rte_memzone_lookup(SHARE_TRACE_MZ_NAME);
+	if (mz == NULL) {
+		rte_errno = ENOENT;
+		return false;
+	}
+
+	setup(mz->addr);
+	return true;
+}
+
+void
+ShareTrace::setup(void *addr)
+{
+	m_events = (struct share_trace_event *)(void *)((uint8_t *)addr +
+			RTE_ALIGN(sizeof(struct share_trace), CACHE_LINE_SIZE));
+	rte_compiler_barrier();
+	m_trace = (struct share_trace *)addr;
+}
+
+/*
+ * The rings are copied while other lcores may still write to them, so the
+ * oldest events of a busy lcore can be newer than expected. That is fine
+ * for a debugging aid.
+ */
+int
+ShareTrace::dump(const char *path)
+{
+	struct share_trace_file_header header;
+	FILE *fp;
+	int ret = 0;
+
+	if (m_trace == NULL)
+		return -ENOENT;
+
+	fp = fopen(path, "wb");
+	if (fp == NULL)
+		return -errno;
+
+	header.magic = SHARE_TRACE_MAGIC;
+	header.version = SHARE_TRACE_VERSION;
+	header.num_lcores = 0;
+	header.event_size = sizeof(struct share_trace_event);
+	header.tsc_hz = m_trace->tsc_hz;
+	for (uint32_t i = 0; i < RTE_MAX_LCORE; ++i)
+		if (m_trace->rings[i].head)
+			++header.num_lcores;
+
+	if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+		ret = -EIO;
+		goto exit;
+	}
+
+	for (uint32_t i = 0; i < RTE_MAX_LCORE; ++i) {
+		struct share_trace_file_lcore lcore;
+		uint64_t head = m_trace->rings[i].head;
+		uint64_t first;
+
+		if (head == 0)
+			continue;
+
+		first = (head > m_trace->size) ? head - m_trace->size : 0;
+		lcore.lcore = i;
+		lcore.num_events = head - first;
+		lcore.total = head;
+		if (fwrite(&lcore, sizeof(lcore), 1, fp) != 1) {
+			ret = -EIO;
+			goto exit;
+		}
+
+		for (uint64_t seq = first; seq < head; ++seq) {
+			const struct share_trace_event *ev =
+				&m_events[(uint64_t)i * m_trace->size + (seq & (m_trace->size - 1))];
+			if (fwrite(ev, sizeof(*ev), 1, fp) != 1) {
+				ret = -EIO;
+				goto exit;
+			}
+		}
+	}
+
+exit:
+	if (fclose(fp) != 0 && ret == 0)
+		ret = -EIO;
+	return ret;
+}
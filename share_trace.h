@@ -0,0 +1,131 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * @ file
+ * @ Compile-time leveled tracing of the hash table operations.
+ * @
+ * @ SHARE_TRACE_LEVEL selects what is recorded:
+ * @   0 : nothing, the trace points compile to nothing (default)
+ * @   1 : insert, erase and update_value
+ * @   2 : find as well
+ * @
+ * @ Events are binary records written into a ring per lcore, in the
+ * @ TR_TRACE memzone, so every process of the application writes into
+ * @ the same place. An lcore only writes its own ring, which needs no
+ * @ lock or atomic operation; old events are overwritten. dump() saves
+ * @ the rings into a file that tools/trace_decode prints.
+ */
+
+#ifndef _SHARE_TRACE_H_
+#define _SHARE_TRACE_H_
+
+#include <stdint.h>
+
+#include <rte_common.h>
+#include <rte_atomic.h>
+#include <rte_cycles.h>
+#include <rte_lcore.h>
+#include <rte_memzone.h>
+
+#include "share_trace_event.h"
+
+#ifndef SHARE_TRACE_LEVEL
+#define SHARE_TRACE_LEVEL 0
+#endif
+
+#if SHARE_TRACE_LEVEL >= 1
+#define SHARE_TRACE_MUTATION(op, table, sig, pos) \
+    ShareTrace::instance().record((op), (table), (sig), (pos))
+#else
+#define SHARE_TRACE_MUTATION(op, table, sig, pos) do {} while (0)
+#endif
+
+#if SHARE_TRACE_LEVEL >= 2
+#define SHARE_TRACE_LOOKUP(op, table, sig, pos) \
+    ShareTrace::instance().record((op), (table), (sig), (pos))
+#else
+#define SHARE_TRACE_LOOKUP(op, table, sig, pos) do {} while (0)
+#endif
+
+struct share_trace_ring {
+    volatile uint64_t head;     /* events recorded so far */
+} __rte_cache_aligned;
+
+/* Layout of the TR_TRACE memzone, the events follow the rings */
+struct share_trace {
+    uint32_t size;              /* events per lcore, a power of 2 */
+    uint64_t tsc_hz;
+    struct share_trace_ring rings[RTE_MAX_LCORE];
+};
+
+class ShareTrace {
+    public:
+        static const uint32_t DEFAULT_EVENTS_PER_LCORE = 4096;
+
+    public:
+        ~ShareTrace() {}
+
+        static ShareTrace & instance(void) {
+            static ShareTrace share_trace;
+            return share_trace;
+        }
+
+        // create the rings, used by primary process
+        bool create(uint32_t events_per_lcore = DEFAULT_EVENTS_PER_LCORE,
+                    int socket_id = SOCKET_ID_ANY);
+
+        // attach to the rings, used by secondary process
+        bool attach(void);
+
+        // save the rings to a file, returns 0 or a negative errno
+        int dump(const char *path);
+
+        // events are dropped until create or attach succeeded
+        inline void record(uint16_t op, uint32_t table, uint32_t sig, int32_t pos) {
+            unsigned lcore = rte_lcore_id();
+
+            if (m_trace == NULL || lcore >= RTE_MAX_LCORE)
+                return;
+
+            struct share_trace_ring *ring = &m_trace->rings[lcore];
+            uint64_t head = ring->head;
+            struct share_trace_event *ev =
+                &m_events[(uint64_t)lcore * m_trace->size + (head & (m_trace->size - 1))];
+
+            ev->tsc = rte_rdtsc();
+            ev->table = table;
+            ev->signature = sig;
+            ev->position = pos;
+            ev->op = op;
+            ev->lcore = lcore;
+
+            rte_compiler_barrier();
+            ring->head = head + 1;
+        }
+
+    private:
+        ShareTrace(void) : m_trace(NULL), m_events(NULL) {}
+
+        void setup(void *addr);
+
+    private:
+        struct share_trace       *m_trace;
+        struct share_trace_event *m_events;
+};
+
+#endif
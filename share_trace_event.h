@@ -0,0 +1,68 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * @file : share_trace_event.h
+ * @description : binary format of the trace events and of a trace dump
+ *
+ * This header doesn't depend on dpdk, so that tools/trace_decode can be
+ * built without it.
+ *
+ * A dump file is a share_trace_file_header, then for every lcore a
+ * share_trace_file_lcore followed by its events, oldest first.
+ */
+
+#ifndef _SHARE_TRACE_EVENT_H_
+#define _SHARE_TRACE_EVENT_H_
+
+#include <stdint.h>
+
+#define SHARE_TRACE_MAGIC   0x53485452  /* "SHTR" */
+#define SHARE_TRACE_VERSION 1
+
+enum share_trace_op {
+    SHARE_TRACE_INSERT = 1,
+    SHARE_TRACE_ERASE,
+    SHARE_TRACE_RETIRE,
+    SHARE_TRACE_UPDATE,
+    SHARE_TRACE_FIND,
+};
+
+struct share_trace_event {
+    uint64_t tsc;
+    uint32_t table;         /* hash of the table name */
+    uint32_t signature;
+    int32_t  position;      /* negative errno on failure */
+    uint16_t op;            /* share_trace_op */
+    uint16_t lcore;
+};
+
+struct share_trace_file_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_lcores;    /* number of share_trace_file_lcore records */
+    uint32_t event_size;
+    uint64_t tsc_hz;
+};
+
+struct share_trace_file_lcore {
+    uint32_t lcore;
+    uint32_t num_events;
+    uint64_t total;         /* events recorded, including overwritten ones */
+};
+
+#endif
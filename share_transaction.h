@@ -0,0 +1,271 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * Description:
+ *
+ * Change a few keys of a ShareHashMap at once, e.g. the forward and the
+ * reverse tuple of a flow. The keys are declared first, then lock() write
+ * locks their buckets in increasing index order, so transactions never
+ * deadlock and the rest of the table stays available.
+ *
+ * The operations are applied at once, under the locks, and what they
+ * replaced is kept. commit() releases the locks, rollback() puts back the
+ * old entries first. A transaction still locked when it is destroyed is
+ * rolled back.
+ *
+ *   ShareHashTransaction<map_type> tx(map);
+ *   tx.add_key(forward);
+ *   tx.add_key(reverse);
+ *   tx.lock();
+ *   if (tx.insert(forward, a) >= 0 && tx.insert(reverse, b) >= 0)
+ *       tx.commit();
+ *   else
+ *       tx.rollback();
+ *
+ * Readers of a k_FLAG_SINGLE_WRITER or k_FLAG_LOCK_FREE table don't take
+ * the bucket locks and would see half a transaction, so such tables are
+ * refused.
+ */
+
+#ifndef _SHARE_TRANSACTION_H_
+#define _SHARE_TRANSACTION_H_
+
+#include <stdint.h>
+#include <errno.h>
+
+#include <rte_log.h>
+
+#include "share_hashmap.h"
+
+template <class _Map, uint32_t _MaxKeys = 4>
+class ShareHashTransaction {
+    public:
+        typedef typename _Map::key_type key_type;
+        typedef typename _Map::value_type value_type;
+        typedef typename _Map::key_value_pair_type key_value_pair_type;
+        typedef typename _Map::geometry_type geometry_type;
+        typedef ShareRteHash::hash_sig_t hash_sig_t;
+
+        /* Operations a transaction can undo */
+        static const uint32_t k_MAX_UNDO = _MaxKeys * 4;
+
+    public:
+        ShareHashTransaction(_Map & __map)
+            : m_map(__map), m_num_keys(0), m_num_buckets(0), m_num_undo(0), m_locked(false) {}
+
+        ~ShareHashTransaction(void) {
+            if (m_locked)
+                rollback();
+        }
+
+        // declare a key before lock(), returns 0 or a negative errno
+        int add_key(const key_type & __key) {
+            if (m_locked)
+                return -EBUSY;
+            if (m_num_keys == _MaxKeys)
+                return -ENOSPC;
+
+            hash_sig_t sig = m_map.hash(__key) | geometry_type::sig_msb(m_map.m_rte_hash);
+            m_keys[m_num_keys].key = __key;
+            m_keys[m_num_keys].sig = sig;
+            m_keys[m_num_keys].bucket = sig & m_map.m_rte_hash->bucket_bitmask;
+            ++m_num_keys;
+            return 0;
+        }
+
+        // lock the buckets of the declared keys
+        int lock(void) {
+            if (m_locked)
+                return -EBUSY;
+            if (ShareRteHash::instance().has_lockless_readers(m_map.m_rte_hash)) {
+                RTE_LOG(ERR, HASH, "ShareHashTransaction needs a table with bucket locks\n");
+                return -EINVAL;
+            }
+
+            for (uint32_t i = 0; i < m_num_keys; ++i)
+                m_buckets[i] = m_keys[i].bucket;
+            m_num_buckets = ShareRteHash::instance().lock_buckets(m_map.m_rte_hash, m_buckets, m_num_keys);
+            m_locked = true;
+            return 0;
+        }
+
+        // like ShareHashMap::find
+        int32_t find(const key_type & __key) {
+            const key_slot *k = declared(__key);
+            key_value_pair_type kv;
+
+            if (k == NULL)
+                return -EINVAL;
+            kv.k = __key;
+            return engine().template lookup_nolock<geometry_type>(m_map.m_rte_hash, &kv, k->sig, k->bucket);
+        }
+
+        // like ShareHashMap::insert, an existing key is left as it is
+        int32_t insert(const key_type & __key, const value_type & __value) {
+            const key_slot *k = declared(__key);
+            key_value_pair_type kv = {__key, __value};
+            int32_t position;
+
+            if (k == NULL)
+                return -EINVAL;
+
+            position = engine().template lookup_nolock<geometry_type>(m_map.m_rte_hash, &kv, k->sig, k->bucket);
+            if (position >= 0)
+                return position;
+            if (m_num_undo == k_MAX_UNDO)
+                return -ENOSPC;
+
+            position = engine().template add_key_value_nolock<geometry_type>(m_map.m_rte_hash, &kv, k->sig, k->bucket);
+            if (position >= 0)
+                push_undo(k_UNDO_ERASE, kv);
+            return position;
+        }
+
+        // like ShareHashMap::update_value
+        template<typename _Modifier>
+        bool update_value(const key_type & __key, const value_type & __new_value, const _Modifier & __update) {
+            const key_slot *k = declared(__key);
+            key_value_pair_type kv = {__key, __new_value};
+
+            if (k == NULL || m_num_undo == k_MAX_UNDO || !save(k, k_UNDO_RESTORE))
+                return false;
+
+            return engine().template update_value_nolock<geometry_type>(m_map.m_rte_hash, &kv, k->sig,
+                                                                        k->bucket, __update);
+        }
+
+        // like ShareHashMap::erase
+        int32_t erase(const key_type & __key) {
+            const key_slot *k = declared(__key);
+            key_value_pair_type kv;
+
+            if (k == NULL)
+                return -EINVAL;
+            if (m_num_undo == k_MAX_UNDO)
+                return -ENOSPC;
+            if (!save(k, k_UNDO_INSERT))
+                return -ENOENT;
+
+            kv.k = __key;
+            return engine().template del_key_value_nolock<geometry_type>(m_map.m_rte_hash, &kv, k->sig, k->bucket,
+                                                                         ShareRteHash::k_NULL_SIGNATURE);
+        }
+
+        // keep the changes and unlock
+        void commit(void) {
+            finish();
+        }
+
+        // undo the changes, the latest first, and unlock
+        void rollback(void) {
+            while (m_num_undo > 0) {
+                undo_entry & u = m_undo[--m_num_undo];
+                const key_slot *k = declared(u.kv.k);
+
+                switch (u.op) {
+                    case k_UNDO_ERASE:
+                        engine().template del_key_value_nolock<geometry_type>(m_map.m_rte_hash, &u.kv, k->sig,
+                                k->bucket, ShareRteHash::k_NULL_SIGNATURE);
+                        break;
+                    case k_UNDO_INSERT:
+                        engine().template add_key_value_nolock<geometry_type>(m_map.m_rte_hash, &u.kv, k->sig,
+                                k->bucket);
+                        break;
+                    case k_UNDO_RESTORE:
+                        engine().template update_value_nolock<geometry_type>(m_map.m_rte_hash, &u.kv, k->sig,
+                                k->bucket, assign());
+                        break;
+                }
+            }
+            finish();
+        }
+
+    private:
+        static const uint32_t k_UNDO_ERASE = 1;     /* the key was added */
+        static const uint32_t k_UNDO_INSERT = 2;    /* the key was erased */
+        static const uint32_t k_UNDO_RESTORE = 3;   /* the value was updated */
+
+        struct key_slot {
+            key_type   key;
+            hash_sig_t sig;
+            uint32_t   bucket;
+        };
+
+        struct undo_entry {
+            uint32_t            op;
+            key_value_pair_type kv;
+        };
+
+        struct assign {
+            void operator()(value_type & __left, const value_type & __right) const { __left = __right; }
+        };
+
+        static ShareRteHash & engine(void) { return ShareRteHash::instance(); }
+
+        // the slot of a declared key, NULL if it wasn't declared or not locked
+        const key_slot * declared(const key_type & __key) {
+            if (!m_locked)
+                return NULL;
+            for (uint32_t i = 0; i < m_num_keys; ++i)
+                if (sharehash::key_equal(m_keys[i].key, __key))
+                    return &m_keys[i];
+            return NULL;
+        }
+
+        void push_undo(uint32_t __op, const key_value_pair_type & __kv) {
+            m_undo[m_num_undo].op = __op;
+            m_undo[m_num_undo].kv = __kv;
+            ++m_num_undo;
+        }
+
+        // keep the entry of a key for the undo log, false if it isn't there
+        bool save(const key_slot * __k, uint32_t __op) {
+            key_value_pair_type kv, *entry;
+            int32_t position;
+
+            kv.k = __k->key;
+            position = engine().template lookup_nolock<geometry_type>(m_map.m_rte_hash, &kv, __k->sig, __k->bucket);
+            if (position < 0)
+                return false;
+
+            m_map.get_entry_with_index(entry, position);
+            push_undo(__op, *entry);
+            return true;
+        }
+
+        void finish(void) {
+            if (m_locked)
+                ShareRteHash::instance().unlock_buckets(m_map.m_rte_hash, m_buckets, m_num_buckets);
+            m_locked = false;
+            m_num_keys = 0;
+            m_num_buckets = 0;
+            m_num_undo = 0;
+        }
+
+    private:
+        _Map      & m_map;
+        key_slot    m_keys[_MaxKeys];
+        uint32_t    m_buckets[_MaxKeys];
+        undo_entry  m_undo[k_MAX_UNDO];
+        uint32_t    m_num_keys;
+        uint32_t    m_num_buckets;
+        uint32_t    m_num_undo;
+        bool        m_locked;
+};
+
+#endif
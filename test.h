@@ -148,6 +148,8 @@ void test_share_hashmap(void)
                         shm.get_entry_with_index(key_value, index);
                         if (key_value)
                             cout << "Key : " << key_value->k << " Value : " << key_value->v << endl;
+                    } else {
+                        cout << " ... ... Can't find this key!" << endl;
                     }
                     break;
                 case 'm':
@@ -0,0 +1,240 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * Description:
+ *
+ * Table health analyzer. It attaches to a running table as a secondary
+ * process and reports how well the entries are spread over the buckets:
+ *
+ *   $ sudo ./build/hash_analyzer -c 1 -n 4 --proc-type=secondary -- \
+ *          <table name> [-i seconds] [-t top]
+ *
+ * Only the signature table is read, one bucket at a time under its read
+ * lock, so writers are never held for more than one bucket copy. The
+ * signatures were computed by the sharehash::hash of the table, so the
+ * distribution reflects that hash function.
+ *
+ * With -i, the live entries are counted again after that many seconds to
+ * project when a bucket will first overflow (-ENOSPC) at that growth.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <math.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <vector>
+#include <algorithm>
+
+#include <rte_eal.h>
+#include <rte_debug.h>
+#include <rte_errno.h>
+
+#include "share_rte_hash.h"
+
+typedef ShareRteHash::hash_sig_t hash_sig_t;
+
+struct bucket_stat {
+    uint32_t index;
+    uint32_t used;
+};
+
+static bool
+more_used(const bucket_stat & a, const bucket_stat & b)
+{
+    return a.used > b.used || (a.used == b.used && a.index < b.index);
+}
+
+/* log of the Poisson probability of k with mean lambda */
+static double
+log_poisson(double lambda, uint32_t k)
+{
+    return -lambda + k * log(lambda) - lgamma(k + 1.0);
+}
+
+/* Probability that a Poisson variable with mean lambda is at least k */
+static double
+poisson_tail(double lambda, uint32_t k)
+{
+    uint32_t last = k + 50 + (uint32_t)(10 * sqrt(lambda));
+    double sum = 0;
+
+    if (lambda <= 0)
+        return 0;
+    for (uint32_t i = k; i <= last; ++i)
+        sum += exp(log_poisson(lambda, i));
+    return sum > 1 ? 1 : sum;
+}
+
+/*
+ * Entries at which one bucket is expected to be full, assuming the hash
+ * spreads the keys uniformly.
+ */
+static uint64_t
+first_full_bucket(uint32_t num_buckets, uint32_t bucket_entries)
+{
+    uint64_t lo = 0, hi = (uint64_t)num_buckets * bucket_entries;
+
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        double full = num_buckets * poisson_tail((double)mid / num_buckets, bucket_entries);
+        if (full >= 1.0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+static uint32_t
+count_entries(const rte_hash *h)
+{
+    std::vector<hash_sig_t> sigs(h->bucket_entries);
+    uint32_t n = 0;
+
+    for (uint32_t b = 0; b < h->num_buckets; ++b)
+        n += ShareRteHash::instance().read_bucket_signatures(h, b, &sigs[0]);
+    return n;
+}
+
+static void
+usage(const char *prog)
+{
+    printf("usage: %s [EAL options] -- <table name> [-i seconds] [-t top]\n", prog);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *name;
+    unsigned interval = 0, top = 10;
+    int ret, opt;
+
+    ret = rte_eal_init(argc, argv);
+    if (ret < 0)
+        rte_panic("Cannot init EAL\n");
+    argc -= ret;
+    argv += ret;
+
+    while ((opt = getopt(argc, argv, "i:t:")) != -1) {
+        switch (opt) {
+            case 'i': interval = atoi(optarg); break;
+            case 't': top = atoi(optarg); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    name = argv[optind];
+
+    rte_hash *h = ShareRteHash::instance().attach_hash_table(name);
+    if (h == NULL) {
+        printf("can't attach to %s: %s\n", name, rte_strerror(rte_errno));
+        return 1;
+    }
+
+    /* Read every bucket once */
+    std::vector<hash_sig_t> sigs(h->bucket_entries), all;
+    std::vector<uint64_t> histogram(h->bucket_entries + 1, 0);
+    std::vector<bucket_stat> buckets(h->num_buckets);
+    uint32_t live = 0, retired = 0;
+
+    for (uint32_t b = 0; b < h->num_buckets; ++b) {
+        uint32_t used = ShareRteHash::instance().read_bucket_signatures(h, b, &sigs[0]);
+
+        for (uint32_t i = 0; i < h->bucket_entries; ++i) {
+            if (sigs[i] & h->sig_msb)
+                all.push_back(sigs[i]);
+            else if (sigs[i] == ShareRteHash::k_RETIRED_SIGNATURE)
+                ++retired;
+        }
+
+        buckets[b].index = b;
+        buckets[b].used = used;
+        histogram[used]++;
+        live += used;
+    }
+
+    printf("table %s : %u buckets x %u entries, %u live (load %.1f%%), %u retired\n",
+           name, h->num_buckets, h->bucket_entries, live,
+           100.0 * live / ((double)h->num_buckets * h->bucket_entries), retired);
+
+    printf("\nbucket occupancy histogram (entries : buckets)\n");
+    for (uint32_t i = 0; i <= h->bucket_entries; ++i)
+        if (histogram[i])
+            printf("  %4u : %" PRIu64 "\n", i, histogram[i]);
+
+    top = std::min<unsigned>(top, h->num_buckets);
+    std::partial_sort(buckets.begin(), buckets.begin() + top, buckets.end(), more_used);
+    printf("\nfullest buckets\n");
+    for (uint32_t i = 0; i < top; ++i)
+        printf("  bucket %6u : %u/%u\n", buckets[i].index, buckets[i].used, h->bucket_entries);
+
+    /* Chi-square of the bucket counts against a uniform spread */
+    double expected = (double)live / h->num_buckets;
+    double chi2 = 0;
+    if (live) {
+        for (uint32_t i = 0; i <= h->bucket_entries; ++i)
+            chi2 += histogram[i] * (i - expected) * (i - expected) / expected;
+    }
+    double df = h->num_buckets - 1;
+    double z = df > 0 ? (chi2 - df) / sqrt(2 * df) : 0;
+    printf("\nhash quality\n");
+    printf("  chi-square      : %.1f with %.0f degrees of freedom (z = %.2f, %s)\n",
+           chi2, df, z, z > 3 ? "SKEWED" : (z < -3 ? "more regular than random" : "like random"));
+
+    /* Entries sharing their full signature with another entry */
+    std::sort(all.begin(), all.end());
+    uint32_t dup = 0;
+    for (size_t i = 1; i < all.size(); ++i)
+        if (all[i] == all[i - 1])
+            ++dup;
+    double expected_dup = live ? (double)live * (live - 1) / 2 / 2147483648.0 : 0;
+    printf("  dup signatures  : %u (%.4f%%), about %.1f expected from a random 31 bits hash\n",
+           dup, live ? 100.0 * dup / live : 0, expected_dup);
+
+    /* Overflow risk */
+    uint64_t full_now = histogram[h->bucket_entries];
+    uint64_t limit = first_full_bucket(h->num_buckets, h->bucket_entries);
+    printf("\ncapacity\n");
+    printf("  full buckets    : %" PRIu64 "%s\n", full_now,
+           full_now ? " (inserts hashing there fail with -ENOSPC now)" : "");
+    printf("  first overflow  : expected near %" PRIu64 " entries (%.1f%% load) with a uniform hash\n",
+           limit, 100.0 * limit / ((double)h->num_buckets * h->bucket_entries));
+
+    if (interval) {
+        sleep(interval);
+        uint32_t later = count_entries(h);
+        double rate = ((double)later - live) / interval;
+
+        printf("  growth          : %.1f entries/s over %u s\n", rate, interval);
+        if (rate > 0 && later < limit)
+            printf("  projected       : first -ENOSPC in about %.0f s\n", (limit - later) / rate);
+        else if (rate > 0)
+            printf("  projected       : past the expected overflow point already\n");
+        else
+            printf("  projected       : not growing\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Bruce.Li <jiangwlee@163.com>, 2014
+ */
+
+/*
+ * Description:
+ *
+ * Print a trace dump written by ShareTrace::dump, with the events of all
+ * lcores merged in time order. It doesn't need dpdk:
+ *
+ *   $ ./trace_decode hashmap.trace
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <vector>
+#include <algorithm>
+
+#include "share_trace_event.h"
+
+static const char *
+op_name(uint16_t op)
+{
+    switch (op) {
+        case SHARE_TRACE_INSERT: return "insert";
+        case SHARE_TRACE_ERASE:  return "erase";
+        case SHARE_TRACE_RETIRE: return "retire";
+        case SHARE_TRACE_UPDATE: return "update";
+        case SHARE_TRACE_FIND:   return "find";
+        default:                 return "?";
+    }
+}
+
+static const char *
+result_name(uint16_t op, int32_t position)
+{
+    if (op == SHARE_TRACE_UPDATE)
+        return position ? "ok" : "miss";
+    if (position >= 0)
+        return "ok";
+
+    switch (-position) {
+        case ENOENT: return "ENOENT";
+        case ENOSPC: return "ENOSPC";
+        case EINVAL: return "EINVAL";
+        default:     return "error";
+    }
+}
+
+static bool
+tsc_less(const share_trace_event & a, const share_trace_event & b)
+{
+    return a.tsc < b.tsc;
+}
+
+int main(int argc, char **argv)
+{
+    share_trace_file_header header;
+    std::vector<share_trace_event> events;
+    FILE *fp;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <trace dump>\n", argv[0]);
+        return 1;
+    }
+
+    fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        header.magic != SHARE_TRACE_MAGIC ||
+        header.version != SHARE_TRACE_VERSION ||
+        header.event_size != sizeof(share_trace_event)) {
+        fprintf(stderr, "%s: not a trace dump of this version\n", argv[1]);
+        fclose(fp);
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < header.num_lcores; ++i) {
+        share_trace_file_lcore lcore;
+
+        if (fread(&lcore, sizeof(lcore), 1, fp) != 1)
+            break;
+
+        size_t first = events.size();
+        events.resize(first + lcore.num_events);
+        if (lcore.num_events &&
+            fread(&events[first], sizeof(share_trace_event), lcore.num_events, fp) != lcore.num_events) {
+            fprintf(stderr, "%s: truncated\n", argv[1]);
+            events.resize(first);
+            break;
+        }
+
+        printf("# lcore %u : %" PRIu64 " events, %" PRIu64 " overwritten\n",
+               lcore.lcore, lcore.total, lcore.total - lcore.num_events);
+    }
+    fclose(fp);
+
+    if (events.empty())
+        return 0;
+
+    std::stable_sort(events.begin(), events.end(), tsc_less);
+
+    uint64_t start = events[0].tsc;
+    double us_per_tsc = header.tsc_hz ? 1e6 / header.tsc_hz : 0;
+
+    printf("# %14s %5s %8s %-6s %10s %10s %s\n",
+           "usec", "lcore", "table", "op", "signature", "position", "result");
+    for (size_t i = 0; i < events.size(); ++i) {
+        const share_trace_event & ev = events[i];
+        printf("%16.3f %5u %08x %-6s %10u %10d %s\n",
+               (ev.tsc - start) * us_per_tsc, ev.lcore, ev.table, op_name(ev.op),
+               ev.signature, ev.position, result_name(ev.op, ev.position));
+    }
+    return 0;
+}